@@ -0,0 +1,367 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+/**
+* Micro benchmarks of the driver hot path: appending SET commands, reading the result table, parsing the replies and the
+* whole update() tick. The drivers talk to simulated devices over the loopback transport, with the subscriptions set up by
+* HapticAvatar_DriverPort and HapticAvatar_DriverIbox, so the numbers are the ones of a real haptic loop minus the serial link.
+*
+* Each benchmark runs with the ASCII and binary framings, with the link read by the haptic thread then by the I/O thread.
+* Usage: SofaHapticAvatar_DriverBenchmark [nbTicks]
+*/
+
+#include <SofaHapticAvatar/HapticAvatar_DriverPort.h>
+#include <SofaHapticAvatar/HapticAvatar_DriverIbox.h>
+#include <SofaHapticAvatar/HapticAvatar_BinaryProtocol.h>
+#include <SofaHapticAvatar/HapticAvatar_RingBuffer.h>
+#include <SofaHapticAvatar/HapticAvatar_SimulatedDevice.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace sofa::HapticAvatar;
+
+#define BENCH_DEFAULT_TICKS 20000
+#define BENCH_REPETITIONS 7 // each micro benchmark is run several times, the median is reported
+#define BENCH_OPS 100000 // calls per run of a micro benchmark
+#define BENCH_WARMUP_TICKS 1000
+#define BENCH_TICK_RATE 1000.0f // Hz, the rate of the haptic thread, used to schedule the subscriptions
+
+namespace
+{
+    volatile float g_sink = 0.0f; // keeps the compiler from removing the reads
+
+    /// Expose the protected hot path of a driver to the benchmarks
+    template<class TDriver>
+    class BenchDriver : public TDriver
+    {
+    public:
+        using TDriver::TDriver;
+        using TDriver::appendFloat;
+        using TDriver::appendIntFloat;
+        using TDriver::getFloat;
+        using TDriver::getFloat4;
+        using TDriver::getInt;
+
+        /// Batch with every subscribed command returning values: the largest frame the scheduler builds, when all rates are due at once.
+        void fillSubscribedBatch(HapticAvatar_SentBatch& batch) const
+        {
+            batch.cmd_send_list_size = 0;
+            batch.expected_num_return_vals = 0;
+            for (int cmd = 0; cmd < this->getNumCommands(); cmd++)
+            {
+                if (this->subscription_scheduler.isSubscribed(cmd) && this->getNumReturnValues(cmd) > 0)
+                {
+                    batch.cmd_send_list[batch.cmd_send_list_size++] = cmd;
+                    batch.expected_num_return_vals += this->getNumReturnValues(cmd);
+                }
+            }
+        }
+
+        /// Parse the reply of a batch from the ring with the driver parser, then sort its values into the result table.
+        bool parseReply(HapticAvatar_RingBuffer& ring, const HapticAvatar_SentBatch& batch)
+        {
+            this->response_parser.beginFrame(batch.expected_num_return_vals);
+            if (this->response_parser.parse(ring) != HapticAvatar_ResponseParser::Status::FrameComplete)
+                return false;
+
+            this->parseMessage(batch, TDriver::hostTimeNs());
+            return true;
+        }
+
+        /// Forget the replies in flight, the parser is then only fed by @sa parseReply
+        void resetParser() { this->response_parser.reset(); }
+    };
+
+    /// The Port also encodes the collision primitives
+    class BenchDriverPort : public BenchDriver<HapticAvatar_DriverPort>
+    {
+    public:
+        using BenchDriver<HapticAvatar_DriverPort>::BenchDriver;
+        using HapticAvatar_DriverPort::appendPrimitive;
+    };
+
+
+    /// CPU time used by the calling thread, which excludes the time spent waiting for the device
+    int64_t threadCpuTimeNs()
+    {
+#ifdef WIN32
+        FILETIME creation, exit, kernel, user;
+        GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+        const int64_t k = (int64_t(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+        const int64_t u = (int64_t(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+        return (k + u) * 100;
+#else
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+    }
+
+
+    /// Median over BENCH_REPETITIONS runs of the time of one call to op, in ns
+    template<class TOp>
+    double measureNsPerOp(TOp op)
+    {
+        std::vector<double> runs;
+        for (int r = 0; r < BENCH_REPETITIONS; r++)
+        {
+            const int64_t start = HapticAvatar_DriverBase::hostTimeNs();
+            for (int i = 0; i < BENCH_OPS; i++)
+                op(i);
+            runs.push_back(double(HapticAvatar_DriverBase::hostTimeNs() - start) / BENCH_OPS);
+        }
+        std::sort(runs.begin(), runs.end());
+        return runs[runs.size() / 2];
+    }
+
+
+    void printNsPerOp(const std::string& name, double ns)
+    {
+        printf("  %-46s %10.1f ns/op\n", name.c_str(), ns);
+    }
+
+
+    /** Run update() ticks and print the wall time distribution of a tick and the host CPU time per tick.
+    * The wall time includes the round trip to the device thread, the CPU time is what the driver itself costs.
+    */
+    template<class TDriver, class TTick>
+    void benchTicks(TDriver& driver, int nbTicks, TTick tick)
+    {
+        for (int i = 0; i < BENCH_WARMUP_TICKS; i++)
+            tick(i);
+
+        std::vector<int64_t> durations(nbTicks);
+        const unsigned int timeouts = driver.getReceiveTimeoutCounter();
+        const int64_t cpuStart = threadCpuTimeNs();
+        for (int i = 0; i < nbTicks; i++)
+        {
+            const int64_t start = HapticAvatar_DriverBase::hostTimeNs();
+            tick(i);
+            durations[i] = HapticAvatar_DriverBase::hostTimeNs() - start;
+        }
+        const double cpuPerTick = double(threadCpuTimeNs() - cpuStart) / nbTicks;
+
+        std::sort(durations.begin(), durations.end());
+        printf("  %-46s p50 %8lld  p99 %8lld  max %8lld ns, cpu %8.0f ns/tick, %u timeouts\n", "tick (appends + update + reads)",
+            (long long)durations[nbTicks / 2], (long long)durations[nbTicks * 99 / 100], (long long)durations.back(),
+            cpuPerTick, driver.getReceiveTimeoutCounter() - timeouts);
+    }
+
+
+    /// Reply of the device to a batch, as sent on the link: scaled integer values, ASCII line or binary frame.
+    std::string buildReply(const HapticAvatar_DriverBase& driver, const HapticAvatar_SentBatch& batch, bool binary)
+    {
+        std::vector<int32_t> values;
+        for (int k = 0; k < batch.cmd_send_list_size; k++)
+        {
+            const int cmd = batch.cmd_send_list[k];
+            for (int i = 0; i < driver.getNumReturnValues(cmd); i++)
+                values.push_back(int32_t((0.125f * float(i + 1) - 0.3f) * driver.getScaleFactor(cmd)));
+        }
+
+        std::string reply;
+        if (!binary)
+        {
+            for (int32_t v : values)
+                reply += std::to_string(v) + " ";
+            reply += "\n";
+            return reply;
+        }
+
+        const uint16_t payloadLen = uint16_t(values.size() * 4);
+        reply.push_back(char(BINARY_SYNC_BYTE));
+        reply.push_back(char(payloadLen & 0xFF));
+        reply.push_back(char(payloadLen >> 8));
+        for (int32_t v : values)
+            for (int b = 0; b < 4; b++)
+                reply.push_back(char((uint32_t(v) >> (8 * b)) & 0xFF));
+        const uint16_t crc = crc16Ccitt(reply.data() + 1, (unsigned int)reply.size() - 1);
+        reply.push_back(char(crc & 0xFF));
+        reply.push_back(char(crc >> 8));
+        return reply;
+    }
+
+
+    /// Parse the reply to the largest subscription frame of the driver. Run last: the parser of the driver is taken over.
+    template<class TDriver>
+    void benchParse(TDriver& driver, bool binary)
+    {
+        HapticAvatar_SentBatch* batch = new HapticAvatar_SentBatch();
+        driver.fillSubscribedBatch(*batch);
+        const std::string reply = buildReply(driver, *batch, binary);
+
+        HapticAvatar_RingBuffer* ring = new HapticAvatar_RingBuffer();
+        driver.resetParser();
+        bool ok = true;
+        const double ns = measureNsPerOp([&](int) {
+            ring->write(reply.data(), (unsigned int)reply.size());
+            ok = driver.parseReply(*ring, *batch) && ok;
+        });
+
+        if (ok)
+            printNsPerOp("parse + parseMessage (" + std::to_string(batch->cmd_send_list_size) + " cmds, " + std::to_string(reply.size()) + " bytes)", ns);
+        else
+            printf("  parse failed, the reply doesn't match the driver framing\n");
+
+        delete ring;
+        delete batch;
+    }
+
+
+    void benchPort(bool binary, bool ioThread, int nbTicks)
+    {
+        using CmdPort = HapticAvatar_DriverPort::CmdPort;
+
+        HapticAvatar_SimulatorSettings settings;
+        settings.transport = "loopback";
+        settings.portName = std::string("bench_port_") + (binary ? "binary" : "ascii") + (ioThread ? "_io" : "");
+        HapticAvatar_SimulatedDevice* device = HapticAvatar_SimulatedDevice::create("port", settings);
+        device->start();
+
+        {
+            HapticAvatar_LinkSettings linkSettings;
+            linkSettings.binaryProtocol = binary;
+            linkSettings.ioThread = ioThread;
+            BenchDriverPort driver(settings.portName, "loopback", linkSettings);
+            printf("Port, %s framing%s\n", binary ? "binary" : "ASCII", ioThread ? ", I/O thread" : "");
+            if (!driver.connect())
+            {
+                printf("  simulated device not connected\n");
+                delete device;
+                return;
+            }
+            driver.setTickRate(BENCH_TICK_RATE);
+
+            const sofa::type::fixed_array<float, 3> center = { 0.0f, 0.0f, 3.0f };
+            const int sphere = driver.addSphere(center, 3.0f, 50.0f, 0.5f, 0.0f);
+            const sofa::type::fixed_array<float, 3> v0 = { 1.0f, 0.0f, 0.0f };
+            const sofa::type::fixed_array<float, 3> n = { 0.0f, 0.0f, 1.0f };
+
+            printNsPerOp("appendFloat x4 (setMotorForceAndTorques)", measureNsPerOp([&](int i) {
+                driver.setMotorForceAndTorques(float(i & 0xFF), 0.0f, 0.5f, 0.0f);
+            }));
+            printNsPerOp("appendIntFloat x3 (updatePosition)", measureNsPerOp([&](int i) {
+                const sofa::type::fixed_array<float, 3> pos = { 0.0f, 0.0f, 3.0f + 1.0e-3f * float(i & 0xFF) };
+                driver.updatePosition(sphere, pos);
+            }));
+            printNsPerOp("appendPrimitive (sphere)", measureNsPerOp([&](int i) {
+                const sofa::type::fixed_array<float, 3> pos = { 0.0f, 0.0f, 3.0f + 1.0e-3f * float(i & 0xFF) };
+                driver.appendPrimitive(sphere, (int)HapticAvatar_DriverPort::CoType::CO_SPHERE, 1, pos, v0, n, 0.0f, 3.0f, 0.0f, 0.0f, 50.0f, 0.0f, 0.5f);
+            }));
+            printNsPerOp("getFloat4 (GET_ANGLES_AND_LENGTH)", measureNsPerOp([&](int) {
+                g_sink = g_sink + driver.getFloat4((int)CmdPort::GET_ANGLES_AND_LENGTH)[2];
+            }));
+            printNsPerOp("getInt (GET_TOOL_ID)", measureNsPerOp([&](int) {
+                g_sink = g_sink + float(driver.getInt((int)CmdPort::GET_TOOL_ID));
+            }));
+
+            benchTicks(driver, nbTicks, [&](int i) {
+                const sofa::type::fixed_array<float, 3> pos = { 0.0f, 0.0f, 3.0f + 1.0e-3f * float(i & 0xFF) };
+                driver.setMotorForceAndTorques(0.0f, 0.0f, 0.5f, 0.0f);
+                driver.updatePosition(sphere, pos);
+                driver.update();
+                g_sink = g_sink + driver.getAnglesAndLength()[2];
+            });
+
+            benchParse(driver, binary);
+        }
+
+        delete device;
+    }
+
+
+    void benchIbox(bool binary, bool ioThread, int nbTicks)
+    {
+        using CmdIBox = HapticAvatar_DriverIbox::CmdIBox;
+
+        HapticAvatar_SimulatorSettings settings;
+        settings.transport = "loopback";
+        settings.portName = std::string("bench_ibox_") + (binary ? "binary" : "ascii") + (ioThread ? "_io" : "");
+        HapticAvatar_SimulatedDevice* device = HapticAvatar_SimulatedDevice::create("ibox", settings);
+        device->start();
+
+        {
+            HapticAvatar_LinkSettings linkSettings;
+            linkSettings.binaryProtocol = binary;
+            linkSettings.ioThread = ioThread;
+            BenchDriver<HapticAvatar_DriverIbox> driver(settings.portName, "loopback", linkSettings);
+            printf("IBox, %s framing%s\n", binary ? "binary" : "ASCII", ioThread ? ", I/O thread" : "");
+            if (!driver.connect())
+            {
+                printf("  simulated device not connected\n");
+                delete device;
+                return;
+            }
+            driver.setTickRate(BENCH_TICK_RATE);
+
+            // the tools of the IBox are numbered from 3, see HapticAvatar_DriverIbox::convertToolIdToChannel
+            printNsPerOp("appendIntFloat (setForce)", measureNsPerOp([&](int i) {
+                driver.setForce(3 + (i & 1), 1.0e-3f * float(i & 0xFF));
+            }));
+            printNsPerOp("getFloat (GET_OPENING_VALUES channel)", measureNsPerOp([&](int i) {
+                g_sink = g_sink + driver.getFloat((int)CmdIBox::GET_OPENING_VALUES, i & 1);
+            }));
+            printNsPerOp("getInt (GET_STATUS)", measureNsPerOp([&](int) {
+                g_sink = g_sink + float(driver.getInt((int)CmdIBox::GET_STATUS));
+            }));
+
+            benchTicks(driver, nbTicks, [&](int i) {
+                driver.setForce(3, 1.0e-3f * float(i & 0xFF));
+                driver.setForce(4, 1.0e-3f * float(i & 0xFF));
+                driver.update();
+                g_sink = g_sink + driver.getOpeningValue(3) + driver.getOpeningValue(4);
+            });
+
+            benchParse(driver, binary);
+        }
+
+        delete device;
+    }
+
+} // anonymous namespace
+
+
+int main(int argc, char** argv)
+{
+    const int nbTicks = argc > 1 ? std::max(std::atoi(argv[1]), 100) : BENCH_DEFAULT_TICKS;
+
+    for (int ioThread = 0; ioThread < 2; ioThread++)
+    {
+        for (int binary = 0; binary < 2; binary++)
+        {
+            benchPort(binary != 0, ioThread != 0, nbTicks);
+            benchIbox(binary != 0, ioThread != 0, nbTicks);
+        }
+    }
+
+    return 0;
+}
@@ -35,15 +35,7 @@ HapticAvatar_ArticulatedDeviceController::~HapticAvatar_ArticulatedDeviceControl
 void HapticAvatar_ArticulatedDeviceController::initDevice()
 {
     msg_info() << "HapticAvatar_ArticulatedDeviceController::initDevice()";
-    m_HA_driver = new HapticAvatar_DriverPort(d_portName.getValue());
-
-    if (!m_HA_driver->IsConnected())
-        return;
-
-    // get identity
-    std::string identity = m_HA_driver->getDeviceType();
-    d_hapticIdentity.setValue(identity);
-    msg_info() << "HapticAvatar_BaseDeviceController identity: '" << identity << "'";
+    m_HA_driver = new HapticAvatar_DriverPort(d_portName.getValue(), d_transport.getValue(), getLinkSettings());
 
     // get access to portalMgr
     if (l_portalMgr.empty())
@@ -59,10 +51,6 @@ void HapticAvatar_ArticulatedDeviceController::initDevice()
         return;
     }
 
-    // release force
-    m_HA_driver->releaseForce();
-
-
     // Retrieve ForceFeedback component pointer
     if (l_forceFeedback.empty())
     {
@@ -74,7 +62,6 @@ void HapticAvatar_ArticulatedDeviceController::initDevice()
         m_forceFeedback = l_forceFeedback.get();
     }
 
-    m_HA_driver->setDeadBandPWMWidth(100, 0, 0, 0);
     if (m_forceFeedback == nullptr)
     {
         msg_warning() << "ForceFeedback not found";
@@ -82,10 +69,21 @@ void HapticAvatar_ArticulatedDeviceController::initDevice()
 }
 
 
+void HapticAvatar_ArticulatedDeviceController::setupDevice()
+{
+    // release force
+    m_HA_driver->releaseForce();
+
+    m_HA_driver->setDeadBandPWMWidth(100, 0, 0, 0);
+}
+
+
 void HapticAvatar_ArticulatedDeviceController::bwdInit()
 {
     msg_info() << "HapticAvatar_ArticulatedDeviceController::bwdInit()";
-    if (!m_portalMgr)
+    HapticAvatar_BaseDeviceController::bwdInit();
+
+    if (!m_portalMgr || !m_HA_driver->IsConnected())
         return;
 
     m_portId = m_portalMgr->getPortalId(d_portName.getValue());
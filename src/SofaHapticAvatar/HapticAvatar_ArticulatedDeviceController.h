@@ -50,6 +50,7 @@ protected:
     /// HapticAvatar_BaseDeviceController api override
     ///{
     void initDevice() override;
+    void setupDevice() override;
     void clearDevice() override;
     void simulation_updateData() override;
     ///}
@@ -12,7 +12,9 @@
 #include <sofa/simulation/AnimateEndEvent.h>
 
 #include <sofa/core/visual/VisualParams.h>
+#include <algorithm>
 #include <iomanip> 
+#include <sstream>
 
 namespace sofa::HapticAvatar
 {
@@ -20,20 +22,181 @@ namespace sofa::HapticAvatar
 //constructeur
 HapticAvatar_BaseDeviceController::HapticAvatar_BaseDeviceController()
     : d_portName(initData(&d_portName, std::string("//./COM3"), "portName", "Name of the port used by this device"))
+    , d_transport(initData(&d_transport, std::string("serial"), "transport", "Link used to reach the device: serial, pty, loopback, unix, replay or replay-max. For loopback and unix, portName is the channel name or the socket path. For replay (original pace) and replay-max (as fast as possible), portName is a file written with captureFile"))
+    , d_baudRate(initData(&d_baudRate, 9600, "baudRate", "Baud rate of the serial link. Used as fallback if autoBaud is on"))
+    , d_flowControl(initData(&d_flowControl, std::string("none"), "flowControl", "Flow control of the serial link: none, hardware (RTS/CTS) or software (XON/XOFF)"))
+    , d_dtrReset(initData(&d_dtrReset, true, "dtrReset", "Reset the board by raising DTR when opening the serial port. The connection waits until the board has booted and answers"))
+    , d_binaryProtocol(initData(&d_binaryProtocol, false, "binaryProtocol", "Negotiate the compact binary framing with the device at connection. The ASCII lines are kept if the device doesn't support it"))
+    , d_captureFile(initData(&d_captureFile, std::string(""), "captureFile", "If not empty, record all the bytes exchanged with the device in this file. Play it back with the replay transport and the same link settings"))
+    , d_ioThread(initData(&d_ioThread, false, "ioThread", "Drain the link continuously in a dedicated thread into a lock-free ring, the haptic thread then only parses the complete replies. Not used with the replay transports"))
+    , d_autoReconnect(initData(&d_autoReconnect, true, "autoReconnect", "Reopen the link in the background when the device is unplugged or stops answering. The force is held at zero meanwhile, and the collision objects and settings are sent again once the device answers"))
+    , d_autoBaud(initData(&d_autoBaud, false, "autoBaud", "Probe the highest baud rate at which the device answers GET_DEVICE_TYPE reliably"))
+    , d_linkSelfTest(initData(&d_linkSelfTest, false, "linkSelfTest", "Measure round trip time and throughput of the link at init, see linkReport"))
+    , d_receiveMode(initData(&d_receiveMode, std::string("blocking"), "receiveMode", "How the driver waits for the device replies: blocking (sleep until data or timeout) or polling (legacy spin loop)"))
+    , d_receiveTimeout(initData(&d_receiveTimeout, 0, "receiveTimeout", "Max time in microseconds to wait for the device reply at each haptic loop, in blocking mode. 0 to size it from the baud rate, the frame length and the measured round trip"))
+    , d_pipelineDepth(initData(&d_pipelineDepth, 1, "pipelineDepth", "Number of command batches sent to the device before waiting for the reply to the first one (1 to 8). Above 1, the loop rate is no longer bound by the round trip but the data read is up to pipelineDepth-1 loops old"))
+    , d_frameByteBudget(initData(&d_frameByteBudget, 0u, "frameByteBudget", "Max number of bytes of the low rate subscribed commands sent in a single haptic loop. 0 to send one of them per loop"))
+    , d_hapticPeriod(initData(&d_hapticPeriod, 1u, "hapticPeriod", "Number of haptic thread ticks between two updates of this device: it runs at the baseRate of HapticAvatar_HapticThreadSettings divided by hapticPeriod. The subscribed commands keep their rate in Hz"))
     , d_hapticIdentity(initData(&d_hapticIdentity, "hapticIdentity", "Data to store Information received by HW device"))
+    , d_roundTripLatency(initData(&d_roundTripLatency, sofa::type::Vec3f(0, 0, 0), "roundTripLatency", "Time in microseconds between sending a command batch and parsing its reply: median, 99th percentile and max since the start"))
+    , d_commandLatency(initData(&d_commandLatency, "commandLatency", "Round trip of each command sent since the start: median, 99th percentile and max in microseconds, one line per command id"))
+    , d_bytesSentPerTick(initData(&d_bytesSentPerTick, sofa::type::Vec3f(0, 0, 0), "bytesSentPerTick", "Bytes written to the link at each haptic loop: median, 99th percentile and max since the start"))
+    , d_bytesReceivedPerTick(initData(&d_bytesReceivedPerTick, sofa::type::Vec3f(0, 0, 0), "bytesReceivedPerTick", "Bytes received from the link at each haptic loop: median, 99th percentile and max since the start"))
+    , d_receiveTimeoutCount(initData(&d_receiveTimeoutCount, 0u, "receiveTimeoutCount", "Number of device replies not received in time"))
+    , d_linkReport(initData(&d_linkReport, "linkReport", "Round trip time and throughput of the link for each baud rate tested at init"))
+    , d_linkLatency(initData(&d_linkLatency, 0.0f, "linkLatency", "Estimated time in microseconds between the device sampling its sensors and the host receiving the values"))
+    , d_linkJitter(initData(&d_linkJitter, 0.0f, "linkJitter", "Mean deviation in microseconds of the round trips from the fastest one"))
+    , d_linkState(initData(&d_linkState, std::string("disconnected"), "linkState", "State of the link: connected, reconnecting, restoring (the device answers again, its state is being sent again) or disconnected"))
+    , d_reconnectCount(initData(&d_reconnectCount, 0u, "reconnectCount", "Number of times the link was lost and reopened"))
     , d_drawDebug(initData(&d_drawDebug, false, "drawDebugForce", "Parameter to draw debug information"))
 {
     this->f_listening.setValue(true);
     
     d_hapticIdentity.setReadOnly(true);
+    d_roundTripLatency.setReadOnly(true);
+    d_commandLatency.setReadOnly(true);
+    d_bytesSentPerTick.setReadOnly(true);
+    d_bytesReceivedPerTick.setReadOnly(true);
+    d_receiveTimeoutCount.setReadOnly(true);
+    d_linkReport.setReadOnly(true);
+    d_linkLatency.setReadOnly(true);
+    d_linkJitter.setReadOnly(true);
+    d_linkState.setReadOnly(true);
+    d_reconnectCount.setReadOnly(true);
 }
 
 
-//executed once at the start of Sofa, initialization of all variables excepts haptics-related ones
+//executed once at the start of Sofa, initialization of all variables excepts haptics-related ones. The device connection is started here and finished in bwdInit, so that all the devices of the scene boot in parallel.
 void HapticAvatar_BaseDeviceController::init()
 {
     msg_info() << "HapticAvatar_BaseDeviceController::init()";
     initDevice();
+
+    HapticAvatar_DriverBase* driver = getBaseDriver();
+    if (driver == nullptr)
+        return;
+
+    if (d_receiveMode.getValue() == "polling")
+        driver->setReceiveMode(HapticAvatar_DriverBase::ReceiveMode::Polling);
+    else if (d_receiveMode.getValue() == "blocking")
+        driver->setReceiveMode(HapticAvatar_DriverBase::ReceiveMode::Blocking);
+    else
+        msg_warning() << "Unknown receiveMode: '" << d_receiveMode.getValue() << "'. Valid modes are: blocking, polling. Using blocking.";
+
+    driver->setReceiveTimeout(d_receiveTimeout.getValue());
+    driver->setPipelineDepth(d_pipelineDepth.getValue());
+    driver->setFrameByteBudget(d_frameByteBudget.getValue());
+
+    driver->connectAsync();
+}
+
+
+void HapticAvatar_BaseDeviceController::bwdInit()
+{
+    msg_info() << "HapticAvatar_BaseDeviceController::bwdInit()";
+    HapticAvatar_DriverBase* driver = getBaseDriver();
+    if (driver == nullptr || !driver->waitConnected())
+        return;
+
+    // get identity
+    std::string identity = driver->getDeviceType();
+    d_hapticIdentity.setValue(identity);
+    msg_info() << "HapticAvatar_BaseDeviceController identity: '" << identity << "'";
+
+    configureLink(driver);
+
+    // the subscriptions are scheduled at the rate this device is updated
+    m_hapticPeriod = std::max(d_hapticPeriod.getValue(), 1u);
+    const float baseRate = HapticAvatar_HapticThreadManager::getInstance()->getBaseRate();
+    driver->setTickRate(baseRate / float(m_hapticPeriod));
+    msg_info() << "Updated every " << m_hapticPeriod << " haptic tick(s): " << baseRate / float(m_hapticPeriod) << " Hz";
+
+    setupDevice();
+}
+
+
+HapticAvatar_LinkSettings HapticAvatar_BaseDeviceController::getLinkSettings()
+{
+    HapticAvatar_LinkSettings settings;
+    settings.baudRate = d_baudRate.getValue();
+    settings.dtrReset = d_dtrReset.getValue();
+    settings.binaryProtocol = d_binaryProtocol.getValue();
+    settings.captureFile = d_captureFile.getValue();
+    settings.ioThread = d_ioThread.getValue();
+    settings.autoReconnect = d_autoReconnect.getValue();
+
+    const std::string& flowControl = d_flowControl.getValue();
+    if (flowControl == "none" || flowControl == "hardware" || flowControl == "software")
+        settings.flowControl = flowControl;
+    else
+        msg_warning() << "Unknown flowControl: '" << flowControl << "'. Valid values are: none, hardware, software. Using none.";
+
+    return settings;
+}
+
+
+void HapticAvatar_BaseDeviceController::configureLink(HapticAvatar_DriverBase* driver)
+{
+    if (!d_autoBaud.getValue() && !d_linkSelfTest.getValue())
+        return;
+
+    // Rates tried by the negotiation, highest first
+    static const std::vector<int> baudRates = { 2000000, 1000000, 921600, 500000, 460800, 230400, 115200, 57600, 38400, 19200, 9600 };
+    const int nbProbes = 20;
+
+    std::vector<HapticAvatar_LinkStats> report;
+    if (d_autoBaud.getValue())
+    {
+        if (driver->getBaudRate() == 0)
+        {
+            msg_info() << "autoBaud ignored: transport '" << d_transport.getValue() << "' has no baud rate.";
+        }
+        else
+        {
+            // the device type read at the configured rate is the reference the replies must match
+            int baudRate = driver->negotiateBaudRate(baudRates, nbProbes, d_hapticIdentity.getValue(), &report);
+            if (baudRate > 0)
+                msg_info() << "Baud rate negotiated: " << baudRate;
+            else
+                msg_warning() << "Baud rate negotiation failed, keeping " << driver->getBaudRate();
+        }
+    }
+
+    if (d_linkSelfTest.getValue() && report.empty())
+        report.push_back(driver->runLinkSelfTest(nbProbes, d_hapticIdentity.getValue()));
+
+    std::stringstream ss;
+    for (const HapticAvatar_LinkStats& stats : report)
+    {
+        ss << "baud " << stats.baudRate << ": round trip mean " << stats.meanRoundTripUs << " us, max " << stats.maxRoundTripUs
+            << " us, " << int(stats.bytesPerSecond) << " B/s, " << stats.nbFailures << "/" << stats.nbRoundTrips << " failed\n";
+    }
+    d_linkReport.setValue(ss.str());
+    msg_info() << "Link report:\n" << ss.str();
+}
+
+
+void HapticAvatar_BaseDeviceController::updateLinkStats(HapticAvatar_DriverBase* driver)
+{
+    auto summary = [](const HapticAvatar_LatencyHistogram& histogram) {
+        return sofa::type::Vec3f(float(histogram.getPercentile(50.0f)), float(histogram.getPercentile(99.0f)), float(histogram.getMax()));
+    };
+
+    d_roundTripLatency.setValue(summary(driver->getBatchLatency()));
+    d_bytesSentPerTick.setValue(summary(driver->getBytesSentPerTick()));
+    d_bytesReceivedPerTick.setValue(summary(driver->getBytesReceivedPerTick()));
+
+    std::stringstream ss;
+    for (int cmd = 0; cmd < driver->getNumCommands(); cmd++)
+    {
+        const HapticAvatar_LatencyHistogram& histogram = driver->getCommandLatency(cmd);
+        if (histogram.getCount() == 0)
+            continue;
+
+        ss << "cmd " << cmd << ": p50 " << histogram.getPercentile(50.0f) << " us, p99 " << histogram.getPercentile(99.0f)
+            << " us, max " << histogram.getMax() << " us, " << histogram.getCount() << " round trips\n";
+    }
+    d_commandLatency.setValue(ss.str());
 }
 
 
@@ -112,6 +275,20 @@ void HapticAvatar_BaseDeviceController::handleEvent(core::objectmodel::Event *ev
     {
         HapticAvatar_HapticThreadManager::getInstance()->setSimulationStarted();
         simulation_updateData();
+
+        HapticAvatar_DriverBase* driver = getBaseDriver();
+        d_receiveTimeoutCount.setValue(driver->getReceiveTimeoutCounter());
+        d_linkLatency.setValue(driver->getLinkClock().getLatencyUs());
+        d_linkJitter.setValue(driver->getLinkClock().getJitterUs());
+        updateLinkStats(driver);
+        d_reconnectCount.setValue(driver->getReconnectCounter());
+        switch (driver->getLinkState())
+        {
+        case HapticAvatar_DriverBase::LinkState::Connected: d_linkState.setValue("connected"); break;
+        case HapticAvatar_DriverBase::LinkState::Reconnecting: d_linkState.setValue("reconnecting"); break;
+        case HapticAvatar_DriverBase::LinkState::Restoring: d_linkState.setValue("restoring"); break;
+        default: d_linkState.setValue("disconnected"); break;
+        }
     }
 }
 
@@ -35,23 +35,39 @@ public:
     /// Component API 
     ///{
     void init() override;
+    void bwdInit() override;
     void handleEvent(core::objectmodel::Event *) override;
     void draw(const sofa::core::visual::VisualParams* vparams) override;
     ///}
 
     virtual HapticAvatar_DriverBase* getBaseDriver() = 0;
+
+    /// Number of haptic thread ticks between two updates of this device, at least 1
+    unsigned int getHapticPeriod() const { return m_hapticPeriod; }
     
 protected:
-    /// Internal method to init specific info. Called by init
+    /// Internal method to init specific info and create the driver, without waiting for the device. Called by init
     virtual void initDevice() = 0;
+
+    /// Internal method to init the device once it is connected. Called by bwdInit
+    virtual void setupDevice() {}
     
     /// Main method to clear the device
     virtual void clearDevice() {};
 
+    /// Serial parameters given by the Data, to be used when creating the driver in @sa initDevice
+    HapticAvatar_LinkSettings getLinkSettings();
+
+    /// Internal method to run the baud negotiation and link self-test if asked. Called by bwdInit once the device is connected.
+    void configureLink(HapticAvatar_DriverBase* driver);
+
     /// Main method from the SOFA simulation call at each simulation step begin.
     virtual void simulation_updateData() = 0;
 
     
+    /// Internal method to publish the latency histograms and the traffic of the driver in the read-only Data. Called at each simulation step
+    void updateLinkStats(HapticAvatar_DriverBase* driver);
+
     /// Internal method to bo overriden by child class to draw specific information. Called by @sa draw
     virtual void drawImpl(const sofa::core::visual::VisualParams* vparams) { SOFA_UNUSED(vparams); }
 
@@ -61,8 +77,58 @@ protected:
 public:
     /// Name of the port for this device
     Data<std::string> d_portName; 
+    /// Type of link used to reach the device: serial, pty, loopback, unix, replay or replay-max
+    Data<std::string> d_transport;
+    /// Baud rate of the serial link
+    Data<int> d_baudRate;
+    /// Flow control of the serial link: none, hardware or software
+    Data<std::string> d_flowControl;
+    /// Reset the board by raising DTR when opening the serial port
+    Data<bool> d_dtrReset;
+    /// Use the compact binary framing if the device supports it, ASCII otherwise
+    Data<bool> d_binaryProtocol;
+    /// File recording the bytes exchanged with the device, none if empty
+    Data<std::string> d_captureFile;
+    /// Read the link in a dedicated thread, the haptic thread only parses the received replies
+    Data<bool> d_ioThread;
+    /// Reopen the link in the background when the device is unplugged or stops answering
+    Data<bool> d_autoReconnect;
+    /// Probe the highest baud rate at which the device answers reliably
+    Data<bool> d_autoBaud;
+    /// Measure round trip time and throughput of the link at init
+    Data<bool> d_linkSelfTest;
+    /// How the driver waits for the device replies: blocking (sleep until data or timeout) or polling (legacy spin loop)
+    Data<std::string> d_receiveMode;
+    /// Max time in microseconds to wait for the device reply at each haptic loop, in blocking mode. 0 for automatic, see @sa HapticAvatar_DriverBase::setReceiveTimeout
+    Data<int> d_receiveTimeout;
+    /// Number of command batches sent to the device before waiting for the reply to the first one
+    Data<int> d_pipelineDepth;
+    /// Max number of bytes of the low rate subscribed commands sent in a single haptic loop
+    Data<unsigned int> d_frameByteBudget;
+    /// Number of haptic thread ticks between two updates of this device
+    Data<unsigned int> d_hapticPeriod;
     /// Data to store Information received by HW device
     Data<std::string> d_hapticIdentity;
+    /// Round trip of the command batches in microseconds: median, 99th percentile and max
+    Data<sofa::type::Vec3f> d_roundTripLatency;
+    /// Round trip of each command sent: median, 99th percentile and max in microseconds, one line per command id
+    Data<std::string> d_commandLatency;
+    /// Bytes written to the link at each haptic loop: median, 99th percentile and max
+    Data<sofa::type::Vec3f> d_bytesSentPerTick;
+    /// Bytes received from the link at each haptic loop: median, 99th percentile and max
+    Data<sofa::type::Vec3f> d_bytesReceivedPerTick;
+    /// Number of device replies not received in time
+    Data<unsigned int> d_receiveTimeoutCount;
+    /// Result of the baud negotiation and link self-test
+    Data<std::string> d_linkReport;
+    /// Estimated time between the device sampling its sensors and the host receiving the values, in microseconds
+    Data<float> d_linkLatency;
+    /// Mean deviation of the round trips from the fastest one, in microseconds
+    Data<float> d_linkJitter;
+    /// State of the link: connected, reconnecting, restoring or disconnected
+    Data<std::string> d_linkState;
+    /// Number of times the link was lost and reopened
+    Data<unsigned int> d_reconnectCount;
 
     /// Data parameter to draw debug information
     Data<bool> d_drawDebug;    
@@ -70,6 +136,9 @@ public:
 protected:
     /// Internal parameter to know if device is ready or not.
     bool m_deviceReady = false;
+
+    /// Copy of @sa d_hapticPeriod read by the haptic thread, set in bwdInit before the device is registered
+    unsigned int m_hapticPeriod = 1;
 };
 
 } // namespace sofa::HapticAvatar
@@ -0,0 +1,310 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_CaptureLog.h>
+#include <sofa/helper/logging/Messaging.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace sofa::HapticAvatar
+{
+
+    static int64_t captureClockNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    HapticAvatar_CaptureWriter::~HapticAvatar_CaptureWriter()
+    {
+        close();
+    }
+
+
+    bool HapticAvatar_CaptureWriter::open(const std::string& fileName)
+    {
+        close();
+        m_fileName = fileName;
+
+#ifdef WIN32
+        m_file = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            msg_error("HapticAvatar_CaptureWriter") << "Can't create capture file: '" << fileName << "'. Error: " << GetLastError();
+            return false;
+        }
+#else
+        m_fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (m_fd < 0)
+        {
+            msg_error("HapticAvatar_CaptureWriter") << "Can't create capture file: '" << fileName << "'. Error: " << strerror(errno);
+            return false;
+        }
+#endif
+
+        if (!map(CAPTURE_LOG_INITIAL_SIZE))
+        {
+            close();
+            return false;
+        }
+
+        memset(m_data, 0, CAPTURE_LOG_HEADER_LEN);
+        memcpy(m_data, CAPTURE_LOG_MAGIC, strlen(CAPTURE_LOG_MAGIC));
+        m_size = CAPTURE_LOG_HEADER_LEN;
+        m_startNs = captureClockNs();
+        return true;
+    }
+
+
+    void HapticAvatar_CaptureWriter::close()
+    {
+        unmap();
+
+        // drop the unused part of the last mapping
+#ifdef WIN32
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            LARGE_INTEGER size;
+            size.QuadPart = LONGLONG(m_size);
+            SetFilePointerEx(m_file, size, NULL, FILE_BEGIN);
+            SetEndOfFile(m_file);
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (m_fd >= 0)
+        {
+            if (ftruncate(m_fd, off_t(m_size)) != 0)
+                msg_warning("HapticAvatar_CaptureWriter") << "Can't truncate capture file: '" << m_fileName << "'";
+            ::close(m_fd);
+            m_fd = -1;
+        }
+#endif
+        m_size = 0;
+        m_capacity = 0;
+    }
+
+
+    bool HapticAvatar_CaptureWriter::map(size_t capacity)
+    {
+#ifdef WIN32
+        LARGE_INTEGER size;
+        size.QuadPart = LONGLONG(capacity);
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READWRITE, size.HighPart, size.LowPart, NULL);
+        if (m_mapping == nullptr)
+        {
+            msg_error("HapticAvatar_CaptureWriter") << "Can't map capture file: '" << m_fileName << "'. Error: " << GetLastError();
+            return false;
+        }
+
+        m_data = (char*)MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, capacity);
+        if (m_data == nullptr)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+            msg_error("HapticAvatar_CaptureWriter") << "Can't map capture file: '" << m_fileName << "'. Error: " << GetLastError();
+            return false;
+        }
+#else
+        if (ftruncate(m_fd, off_t(capacity)) != 0)
+        {
+            msg_error("HapticAvatar_CaptureWriter") << "Can't grow capture file: '" << m_fileName << "'. Error: " << strerror(errno);
+            return false;
+        }
+
+        void* data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (data == MAP_FAILED)
+        {
+            msg_error("HapticAvatar_CaptureWriter") << "Can't map capture file: '" << m_fileName << "'. Error: " << strerror(errno);
+            return false;
+        }
+        m_data = (char*)data;
+#endif
+        m_capacity = capacity;
+        return true;
+    }
+
+
+    void HapticAvatar_CaptureWriter::unmap()
+    {
+        if (m_data == nullptr)
+            return;
+
+#ifdef WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+#else
+        munmap(m_data, m_capacity);
+#endif
+        m_data = nullptr;
+    }
+
+
+    bool HapticAvatar_CaptureWriter::append(HapticAvatar_CaptureDirection direction, const char* data, unsigned int size)
+    {
+        if (m_data == nullptr || size == 0)
+            return false;
+
+        const size_t recordLen = CAPTURE_RECORD_HEADER_LEN + size;
+        if (m_size + recordLen > m_capacity)
+        {
+            size_t capacity = m_capacity;
+            while (m_size + recordLen > capacity)
+                capacity *= 2;
+
+            unmap();
+            if (!map(capacity))
+            {
+                close();
+                return false;
+            }
+        }
+
+        const int64_t timeNs = captureClockNs() - m_startNs;
+        const uint8_t dir = uint8_t(direction);
+        char* record = m_data + m_size;
+        memset(record, 0, CAPTURE_RECORD_HEADER_LEN);
+        memcpy(record, &timeNs, sizeof(timeNs));
+        memcpy(record + 8, &size, sizeof(size));
+        memcpy(record + 12, &dir, sizeof(dir));
+        memcpy(record + CAPTURE_RECORD_HEADER_LEN, data, size);
+        m_size += recordLen;
+        return true;
+    }
+
+
+    HapticAvatar_CaptureReader::~HapticAvatar_CaptureReader()
+    {
+        close();
+    }
+
+
+    bool HapticAvatar_CaptureReader::open(const std::string& fileName)
+    {
+        close();
+
+#ifdef WIN32
+        m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            msg_error("HapticAvatar_CaptureReader") << "Can't open capture file: '" << fileName << "'. Error: " << GetLastError();
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(m_file, &size);
+        m_size = size_t(size.QuadPart);
+        if (m_size >= CAPTURE_LOG_HEADER_LEN)
+        {
+            m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (m_mapping != nullptr)
+                m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+#else
+        m_fd = ::open(fileName.c_str(), O_RDONLY);
+        if (m_fd < 0)
+        {
+            msg_error("HapticAvatar_CaptureReader") << "Can't open capture file: '" << fileName << "'. Error: " << strerror(errno);
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(m_fd, &st) == 0)
+            m_size = size_t(st.st_size);
+        if (m_size >= CAPTURE_LOG_HEADER_LEN)
+        {
+            void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+            if (data != MAP_FAILED)
+                m_data = (const char*)data;
+        }
+#endif
+
+        if (m_data == nullptr || memcmp(m_data, CAPTURE_LOG_MAGIC, strlen(CAPTURE_LOG_MAGIC)) != 0)
+        {
+            msg_error("HapticAvatar_CaptureReader") << "File: '" << fileName << "' is not a HapticAvatar capture log.";
+            close();
+            return false;
+        }
+
+        rewind();
+        return true;
+    }
+
+
+    void HapticAvatar_CaptureReader::close()
+    {
+#ifdef WIN32
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mapping != nullptr)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data != nullptr)
+            munmap((void*)m_data, m_size);
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_offset = 0;
+    }
+
+
+    bool HapticAvatar_CaptureReader::next(HapticAvatar_CaptureRecord& record)
+    {
+        if (m_data == nullptr || m_offset + CAPTURE_RECORD_HEADER_LEN > m_size)
+            return false;
+
+        const char* header = m_data + m_offset;
+        uint32_t size = 0;
+        uint8_t dir = 0;
+        memcpy(&record.timeNs, header, sizeof(record.timeNs));
+        memcpy(&size, header + 8, sizeof(size));
+        memcpy(&dir, header + 12, sizeof(dir));
+
+        // a capture interrupted before close leaves zeroed space after the last record
+        if (size == 0 || m_offset + CAPTURE_RECORD_HEADER_LEN + size > m_size)
+            return false;
+
+        record.direction = HapticAvatar_CaptureDirection(dir);
+        record.data = header + CAPTURE_RECORD_HEADER_LEN;
+        record.size = size;
+        m_offset += CAPTURE_RECORD_HEADER_LEN + size;
+        return true;
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,124 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <cstdint>
+#include <string>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+namespace sofa::HapticAvatar
+{
+
+#define CAPTURE_LOG_MAGIC "HACAPT01"
+#define CAPTURE_LOG_HEADER_LEN 16 // magic and reserved bytes
+#define CAPTURE_RECORD_HEADER_LEN 16 // time (int64), size (uint32), direction (uint8) and padding
+#define CAPTURE_LOG_INITIAL_SIZE (16 * 1024 * 1024)
+
+    /// Direction of the bytes of a capture record
+    enum class HapticAvatar_CaptureDirection : uint8_t
+    {
+        Outgoing = 0, ///< written to the device
+        Incoming = 1  ///< read from the device
+    };
+
+    /// One chunk of bytes exchanged with the device, as stored in a capture log
+    struct HapticAvatar_CaptureRecord
+    {
+        int64_t timeNs = 0; // time since the start of the capture
+        HapticAvatar_CaptureDirection direction = HapticAvatar_CaptureDirection::Outgoing;
+        const char* data = nullptr; // points into the mapped log, valid until the reader is closed
+        unsigned int size = 0;
+    };
+
+    /**
+    * Append-only binary log of the bytes exchanged with a device, written through a memory mapping so that logging
+    * from the haptic thread is a copy, not a system call. The file grows by doubling its mapping.
+    * Little-endian layout: the CAPTURE_LOG_MAGIC header, then for each record its time in ns, size, direction and the bytes.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_CaptureWriter
+    {
+    public:
+        ~HapticAvatar_CaptureWriter();
+
+        /// Create or truncate the log file. @returns false if the file can't be created or mapped.
+        bool open(const std::string& fileName);
+
+        /// Unmap the log and truncate the file to the records written.
+        void close();
+
+        bool isOpen() const { return m_data != nullptr; }
+
+        /// Append a record stamped with the time since @sa open. @returns false if the file can't grow.
+        bool append(HapticAvatar_CaptureDirection direction, const char* data, unsigned int size);
+
+    private:
+        bool map(size_t capacity);
+        void unmap();
+
+        std::string m_fileName;
+        char* m_data = nullptr;
+        size_t m_size = 0;
+        size_t m_capacity = 0;
+        int64_t m_startNs = 0;
+#ifdef WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#else
+        int m_fd = -1;
+#endif
+    };
+
+    /// Read the records of a log written by @sa HapticAvatar_CaptureWriter, through a read-only memory mapping.
+    class SOFA_HAPTICAVATAR_API HapticAvatar_CaptureReader
+    {
+    public:
+        ~HapticAvatar_CaptureReader();
+
+        /// Map a log file. @returns false if the file can't be read or is not a capture log.
+        bool open(const std::string& fileName);
+        void close();
+
+        bool isOpen() const { return m_data != nullptr; }
+
+        /// Read the next record. @returns false at the end of the log or if the last record is truncated.
+        bool next(HapticAvatar_CaptureRecord& record);
+
+        /// Go back to the first record.
+        void rewind() { m_offset = CAPTURE_LOG_HEADER_LEN; }
+
+    private:
+        const char* m_data = nullptr;
+        size_t m_size = 0;
+        size_t m_offset = 0;
+#ifdef WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#else
+        int m_fd = -1;
+#endif
+    };
+
+} // namespace sofa::HapticAvatar
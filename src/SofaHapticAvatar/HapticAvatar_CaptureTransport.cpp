@@ -0,0 +1,133 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_CaptureTransport.h>
+#include <sofa/helper/logging/Messaging.h>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_CaptureTransport::HapticAvatar_CaptureTransport(HapticAvatar_Transport* transport, const std::string& fileName)
+        : HapticAvatar_Transport(transport->getPortName())
+        , m_transport(transport)
+        , m_fileName(fileName)
+    {
+
+    }
+
+
+    HapticAvatar_CaptureTransport::~HapticAvatar_CaptureTransport()
+    {
+        close();
+        m_writer.close();
+        delete m_transport;
+    }
+
+
+    bool HapticAvatar_CaptureTransport::open()
+    {
+        m_transport->setLinkSettings(m_linkSettings);
+        if (!m_transport->open())
+            return false;
+
+        m_open = true;
+
+        // a reopened link, after a reconnection, keeps recording in the same log
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        if (m_writer.isOpen())
+            return true;
+
+        // a link without capture is still usable, only warn
+        if (m_writer.open(m_fileName))
+            msg_info("HapticAvatar_CaptureTransport") << "Capturing traffic of port: '" << m_portName << "' to: '" << m_fileName << "'";
+        else
+            msg_warning("HapticAvatar_CaptureTransport") << "Traffic of port: '" << m_portName << "' will not be captured.";
+
+        return true;
+    }
+
+
+    void HapticAvatar_CaptureTransport::close()
+    {
+        m_transport->close();
+        m_open = false;
+    }
+
+
+    bool HapticAvatar_CaptureTransport::setBaudRate(int baudRate)
+    {
+        return m_transport->setBaudRate(baudRate);
+    }
+
+
+    int HapticAvatar_CaptureTransport::read(char* buffer, unsigned int nbChar)
+    {
+        int bytesRead = m_transport->read(buffer, nbChar);
+        if (bytesRead > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_writerMutex);
+            m_writer.append(HapticAvatar_CaptureDirection::Incoming, buffer, (unsigned int)bytesRead);
+        }
+        return bytesRead;
+    }
+
+
+    bool HapticAvatar_CaptureTransport::write(const char* buffer, unsigned int nbChar)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_writerMutex);
+            m_writer.append(HapticAvatar_CaptureDirection::Outgoing, buffer, nbChar);
+        }
+        return m_transport->write(buffer, nbChar);
+    }
+
+
+    int HapticAvatar_CaptureTransport::bytesAvailable()
+    {
+        return m_transport->bytesAvailable();
+    }
+
+
+    bool HapticAvatar_CaptureTransport::waitReadable(int timeoutUs)
+    {
+        return m_transport->waitReadable(timeoutUs);
+    }
+
+
+    int HapticAvatar_CaptureTransport::readWait(char* buffer, unsigned int nbChar, int timeoutUs)
+    {
+        int bytesRead = m_transport->readWait(buffer, nbChar, timeoutUs);
+        if (bytesRead > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_writerMutex);
+            m_writer.append(HapticAvatar_CaptureDirection::Incoming, buffer, (unsigned int)bytesRead);
+        }
+        return bytesRead;
+    }
+
+
+    void HapticAvatar_CaptureTransport::flush()
+    {
+        m_transport->flush();
+    }
+
+} // namespace sofa::HapticAvatar
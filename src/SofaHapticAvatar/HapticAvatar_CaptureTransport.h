@@ -0,0 +1,67 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
+#include <SofaHapticAvatar/HapticAvatar_CaptureLog.h>
+#include <mutex>
+
+namespace sofa::HapticAvatar
+{
+
+    /**
+    * Transport decorator recording every byte written to and read from the wrapped transport in a
+    * @sa HapticAvatar_CaptureWriter log. The log can be played back later with @sa HapticAvatar_ReplayTransport.
+    * Capture is enabled with the captureFile link setting, see @sa HapticAvatar_DriverBase.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_CaptureTransport : public HapticAvatar_Transport
+    {
+    public:
+        /** Default constructor
+        * @param {HapticAvatar_Transport*} transport: the transport to record, owned by the capture transport.
+        * @param {string} fileName: path of the capture log, overwritten at the first @sa open. A link closed and reopened by a reconnection keeps recording in it.
+        */
+        HapticAvatar_CaptureTransport(HapticAvatar_Transport* transport, const std::string& fileName);
+
+        ~HapticAvatar_CaptureTransport() override;
+
+        /// HapticAvatar_Transport api
+        ///{
+        bool open() override;
+        void close() override;
+        bool setBaudRate(int baudRate) override;
+        int read(char* buffer, unsigned int nbChar) override;
+        bool write(const char* buffer, unsigned int nbChar) override;
+        int bytesAvailable() override;
+        bool waitReadable(int timeoutUs) override;
+        int readWait(char* buffer, unsigned int nbChar, int timeoutUs) override;
+        void flush() override;
+        ///}
+
+    private:
+        HapticAvatar_Transport* m_transport = nullptr;
+        HapticAvatar_CaptureWriter m_writer;
+        std::mutex m_writerMutex; // the link may be read by an I/O thread while the haptic thread writes
+        std::string m_fileName;
+    };
+
+} // namespace sofa::HapticAvatar
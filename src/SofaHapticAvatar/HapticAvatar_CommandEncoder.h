@@ -0,0 +1,140 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+namespace sofa::HapticAvatar
+{
+
+    /**
+    * Writes ASCII command tokens into a caller owned, fixed size byte buffer. Numbers are formatted with std::to_chars,
+    * so building a frame never allocates. Every put method is bounds checked against the buffer capacity
+    * and returns false, leaving the buffer untouched, if the token does not fit.
+    * The putUInt8/putUInt16/putInt32 methods write little-endian binary fields for the binary framing, see @sa HapticAvatar_BinaryProtocol.h
+    */
+    class HapticAvatar_CommandEncoder
+    {
+    public:
+        HapticAvatar_CommandEncoder(char* buffer, unsigned int capacity)
+            : m_buffer(buffer)
+            , m_capacity(capacity)
+        {}
+
+        void clear() { m_size = 0; }
+
+        const char* data() const { return m_buffer; }
+        unsigned int size() const { return m_size; }
+        unsigned int capacity() const { return m_capacity; }
+
+        /// Current write position, to be given to @sa rollback to drop a partially written command.
+        unsigned int mark() const { return m_size; }
+        void rollback(unsigned int mark) { m_size = mark; }
+
+        /// Remove the bytes [begin, end) already written, the following bytes are moved down.
+        void erase(unsigned int begin, unsigned int end)
+        {
+            memmove(m_buffer + begin, m_buffer + end, m_size - end);
+            m_size -= end - begin;
+        }
+
+        /// Append "value " to the buffer.
+        bool putInt(int value)
+        {
+            auto res = std::to_chars(m_buffer + m_size, m_buffer + m_capacity, value);
+            return finishToken(res.ptr, res.ec);
+        }
+
+        /// Append "value " to the buffer with 6 decimals, same format as std::to_string(float).
+        bool putFloat(float value)
+        {
+            auto res = std::to_chars(m_buffer + m_size, m_buffer + m_capacity, value, std::chars_format::fixed, 6);
+            return finishToken(res.ptr, res.ec);
+        }
+
+        /// Append raw bytes to the buffer.
+        bool putBytes(const char* bytes, unsigned int nbChar)
+        {
+            if (m_size + nbChar > m_capacity)
+                return false;
+            memcpy(m_buffer + m_size, bytes, nbChar);
+            m_size += nbChar;
+            return true;
+        }
+
+        /// Append a byte to the buffer.
+        bool putUInt8(uint8_t value)
+        {
+            if (m_size + 1 > m_capacity)
+                return false;
+            m_buffer[m_size++] = char(value);
+            return true;
+        }
+
+        /// Append a little-endian 16 bits integer to the buffer.
+        bool putUInt16(uint16_t value)
+        {
+            if (m_size + 2 > m_capacity)
+                return false;
+            setUInt16At(m_size, value);
+            m_size += 2;
+            return true;
+        }
+
+        /// Append a little-endian 32 bits integer to the buffer.
+        bool putInt32(int32_t value)
+        {
+            if (m_size + 4 > m_capacity)
+                return false;
+            const uint32_t bits = uint32_t(value);
+            for (int i = 0; i < 4; i++)
+                m_buffer[m_size++] = char((bits >> (8 * i)) & 0xFF);
+            return true;
+        }
+
+        /// Overwrite a little-endian 16 bits integer already written at position pos, e.g. a frame length known once the payload is written.
+        void setUInt16At(unsigned int pos, uint16_t value)
+        {
+            m_buffer[pos] = char(value & 0xFF);
+            m_buffer[pos + 1] = char(value >> 8);
+        }
+
+    private:
+        bool finishToken(char* end, std::errc ec)
+        {
+            // need room for the separator after the number
+            if (ec != std::errc() || end >= m_buffer + m_capacity)
+                return false;
+            *end++ = ' ';
+            m_size = (unsigned int)(end - m_buffer);
+            return true;
+        }
+
+        char* m_buffer;
+        unsigned int m_capacity;
+        unsigned int m_size = 0;
+    };
+
+} // namespace sofa::HapticAvatar
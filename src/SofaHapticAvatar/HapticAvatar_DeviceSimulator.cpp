@@ -0,0 +1,93 @@
+/******************************************************************************
+* License version                                                             *
+*                                                                             *
+* Authors:                                                                    *
+* Contact information:                                                        *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_DeviceSimulator.h>
+
+#include <sofa/core/ObjectFactory.h>
+#include <sofa/simulation/AnimateBeginEvent.h>
+
+namespace sofa::HapticAvatar
+{
+
+int HapticAvatar_DeviceSimulatorClass = core::RegisterObject("Software Haptic Avatar device (Port, IBox or Scope) answering a device controller through a loopback or pty link.")
+    .add< HapticAvatar_DeviceSimulator >()
+    ;
+
+
+HapticAvatar_DeviceSimulator::HapticAvatar_DeviceSimulator()
+    : d_deviceType(initData(&d_deviceType, std::string("port"), "deviceType", "Simulated device: port, ibox or scope"))
+    , d_transport(initData(&d_transport, std::string("loopback"), "transport", "Link opened by the device controller: loopback or pty"))
+    , d_portName(initData(&d_portName, "portName", "Loopback channel or pty link, same as the portName of the device controller"))
+    , d_latency(initData(&d_latency, 0, "latency", "Delay of the device replies in microseconds"))
+    , d_jitter(initData(&d_jitter, 0, "jitter", "Max random delay added to the latency, in microseconds. Replies stay in order"))
+    , d_byteLoss(initData(&d_byteLoss, 0.0f, "byteLoss", "Probability to lose each byte on the link, in both directions"))
+    , d_seed(initData(&d_seed, 0u, "seed", "Seed of the jitter and byte loss draws, for reproducible runs"))
+    , d_loopPeriod(initData(&d_loopPeriod, 0.1f, "loopPeriod", "Loop period of the simulated firmware in ms, reported to the driver"))
+    , d_frameCount(initData(&d_frameCount, 0u, "frameCount", "Number of command batches answered by the device"))
+    , d_badFrameCount(initData(&d_badFrameCount, 0u, "badFrameCount", "Number of corrupted command batches received by the device"))
+    , d_lostByteCount(initData(&d_lostByteCount, 0u, "lostByteCount", "Number of bytes dropped by the loss injection"))
+{
+    this->f_listening.setValue(true);
+
+    d_frameCount.setReadOnly(true);
+    d_badFrameCount.setReadOnly(true);
+    d_lostByteCount.setReadOnly(true);
+}
+
+
+HapticAvatar_DeviceSimulator::~HapticAvatar_DeviceSimulator()
+{
+    if (m_device)
+    {
+        delete m_device;
+        m_device = nullptr;
+    }
+}
+
+
+void HapticAvatar_DeviceSimulator::init()
+{
+    d_componentState.setValue(sofa::core::objectmodel::ComponentState::Invalid);
+
+    HapticAvatar_SimulatorSettings settings;
+    settings.transport = d_transport.getValue();
+    settings.portName = d_portName.getValue();
+    settings.latencyUs = d_latency.getValue();
+    settings.jitterUs = d_jitter.getValue();
+    settings.byteLoss = d_byteLoss.getValue();
+    settings.seed = d_seed.getValue();
+    settings.loopPeriodMs = d_loopPeriod.getValue();
+
+    if (settings.transport != "loopback" && settings.transport != "pty")
+    {
+        msg_error() << "Unknown transport: '" << settings.transport << "'. Valid transports are: loopback, pty.";
+        return;
+    }
+
+    m_device = HapticAvatar_SimulatedDevice::create(d_deviceType.getValue(), settings);
+    if (m_device == nullptr)
+        return;
+
+    // the device attaches to the link when the controller opens it, whatever the order of the components
+    m_device->start();
+    msg_info() << "Simulated " << m_device->getDeviceType() << " waiting on " << settings.transport << " '" << settings.portName << "'";
+
+    d_componentState.setValue(sofa::core::objectmodel::ComponentState::Valid);
+}
+
+
+void HapticAvatar_DeviceSimulator::handleEvent(sofa::core::objectmodel::Event* event)
+{
+    if (m_device == nullptr || !dynamic_cast<sofa::simulation::AnimateBeginEvent*>(event))
+        return;
+
+    d_frameCount.setValue(m_device->getFrameCount());
+    d_badFrameCount.setValue(m_device->getBadFrameCount());
+    d_lostByteCount.setValue(m_device->getLostByteCount());
+}
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,59 @@
+/******************************************************************************
+* License version                                                             *
+*                                                                             *
+* Authors:                                                                    *
+* Contact information:                                                        *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <SofaHapticAvatar/HapticAvatar_SimulatedDevice.h>
+
+#include <sofa/core/objectmodel/BaseObject.h>
+
+namespace sofa::HapticAvatar
+{
+
+/**
+* Software Haptic Avatar device for the scenes run without hardware. Put it next to a device controller using the
+* same portName and transport="loopback" (or "pty"), the controller then talks to it like to the real device.
+*/
+class SOFA_HAPTICAVATAR_API HapticAvatar_DeviceSimulator : public sofa::core::objectmodel::BaseObject
+{
+public:
+    SOFA_CLASS(HapticAvatar_DeviceSimulator, sofa::core::objectmodel::BaseObject);
+
+    HapticAvatar_DeviceSimulator();
+    ~HapticAvatar_DeviceSimulator() override;
+
+    void init() override;
+    void handleEvent(sofa::core::objectmodel::Event* event) override;
+
+    /// Simulated device: port, ibox or scope
+    Data<std::string> d_deviceType;
+    /// Side of the link opened by the controller: loopback or pty
+    Data<std::string> d_transport;
+    /// Loopback channel or pty link name, same as the portName of the controller
+    Data<std::string> d_portName;
+    /// Delay of the device replies in microseconds
+    Data<int> d_latency;
+    /// Random delay added to the latency, in microseconds
+    Data<int> d_jitter;
+    /// Probability to lose each byte on the link
+    Data<float> d_byteLoss;
+    /// Seed of the jitter and byte loss
+    Data<unsigned int> d_seed;
+    /// Loop period of the simulated firmware in ms
+    Data<float> d_loopPeriod;
+    /// Number of command batches answered by the device
+    Data<unsigned int> d_frameCount;
+    /// Number of corrupted command batches received by the device
+    Data<unsigned int> d_badFrameCount;
+    /// Number of bytes dropped by the loss injection
+    Data<unsigned int> d_lostByteCount;
+
+protected:
+    HapticAvatar_SimulatedDevice* m_device = nullptr;
+};
+
+} // namespace sofa::HapticAvatar
@@ -23,34 +23,49 @@
 #include <SofaHapticAvatar/HapticAvatar_DriverBase.h>
 #include <sofa/helper/logging/Messaging.h>
 
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
+#include <SofaHapticAvatar/HapticAvatar_CaptureTransport.h>
+#include <SofaHapticAvatar/HapticAvatar_BinaryProtocol.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
 namespace sofa::HapticAvatar
 {
 
     using namespace HapticAvatar;
 
-    HapticAvatar_DriverBase::HapticAvatar_DriverBase(const std::string& portName)
-        : m_connected(false)
+    HapticAvatar_DriverBase::HapticAvatar_DriverBase(const std::string& portName, const std::string& transportType, const HapticAvatar_LinkSettings& linkSettings)
+        : cmd_appended_encoder(cmd_appended_data, OUTGOING_DATA_LEN - BINARY_HEADER_LEN - BINARY_CRC_LEN) // the appended commands must fit in a single frame
+        , send_encoder(outgoingData, OUTGOING_DATA_LEN)
+        , m_linkState(LinkState::Disconnected)
         , m_portName(portName)
+        , m_transportType(transportType)
+        , m_linkSettings(linkSettings)
     {
-        // First try to connect to device
-        connectDevice();
 
-        if (!m_connected)
-        {
-            msg_error("HapticAvatar_DriverBase") << "## Device Not Connected at port: " << m_portName;
-        }
     }
 
 
     HapticAvatar_DriverBase::~HapticAvatar_DriverBase()
     {
-        //Check if we are connected before trying to disconnect
-        if (m_connected)
+        //The connection may still be running if the scene is closed during the init, or a reconnection after the link was lost
+        m_closing = true;
+        if (m_connectThread.joinable())
+            m_connectThread.join();
+
+        stopIoThread();
+        cancelQueries();
+
+        //We're no longer connected
+        m_linkState = LinkState::Disconnected;
+        //Close and release the link
+        if (m_transport)
         {
-            //We're no longer connected
-            m_connected = false;
-            //Close the serial handler
-            CloseHandle(m_hSerial);
+            delete m_transport;
+            m_transport = nullptr;
         }
     }
 
@@ -63,13 +78,19 @@ namespace sofa::HapticAvatar
 
     int HapticAvatar_DriverBase::resetDevice(int mode)
     {
-        char incomingData[INCOMING_DATA_LEN];
-        std::string arguments = std::to_string(mode);
-        if (sendCommandToDevice(0, arguments, incomingData) == false) {  // RESET command is always 0 for Haptic Avatar devices.
+        // sent in the next frame, the haptic thread keeps its rate
+        int args[1] = { mode };
+        std::future<HapticAvatar_QueryResult> future = requestOnce(0, args, 1);  // RESET command is always 0 for Haptic Avatar devices.
+        if (!waitQuery(future)) {
+            return -1;
+        }
+
+        HapticAvatar_QueryResult result = future.get();
+        if (result.nbValues == 0) {
             return -1;
         }
 
-        int res = std::atoi(incomingData);
+        int res = int(result.values[0]);
         return res;
 
         setupNumReturnVals();  // needs to be implemented in each device driver
@@ -79,13 +100,14 @@ namespace sofa::HapticAvatar
 
     bool HapticAvatar_DriverBase::sendCommandToDevice(int commandId, const std::string& arguments, char* result)
     {
-        std::string fullCommand = std::to_string(commandId) + " " + arguments + " \n";
-
-        char outgoingData[OUTGOING_DATA_LEN];
-        strcpy(outgoingData, fullCommand.c_str());
+        char commandData[OUTGOING_DATA_LEN];
+        HapticAvatar_CommandEncoder encoder(commandData, OUTGOING_DATA_LEN);
+        if (!encoder.putInt(commandId) || !encoder.putBytes(arguments.c_str(), (unsigned int)arguments.size()) || !encoder.putBytes(" \n", 2)) {
+            msg_error("HapticAvatar_DriverBase") << "Command " << commandId << " too long, max " << OUTGOING_DATA_LEN << " bytes.";
+            return false;
+        }
 
-        unsigned int outlen = (unsigned int)(strlen(outgoingData));
-        bool write_success = writeDataImpl(outgoingData, outlen);
+        bool write_success = writeDataImpl(commandData, encoder.size());
         if (!write_success) {
             return false;
         }
@@ -98,15 +120,113 @@ namespace sofa::HapticAvatar
     }
 
 
+    int HapticAvatar_DriverBase::getBaudRate() const
+    {
+        if (m_transportType != "serial")
+            return 0;
+
+        return m_linkSettings.baudRate;
+    }
+
+
+    HapticAvatar_LinkStats HapticAvatar_DriverBase::runLinkSelfTest(int nbRoundTrips, const std::string& expectedReply)
+    {
+        HapticAvatar_LinkStats stats;
+        stats.baudRate = getBaudRate();
+        if (m_linkState != LinkState::Connected)
+            return stats;
+
+        char commandData[] = "1 \n"; // GET_DEVICE_TYPE command is number 1 on all Haptic Avatar devices
+        const unsigned int commandSize = sizeof(commandData) - 1;
+        char reply[INCOMING_DATA_LEN];
+        size_t nbBytes = 0;
+        float sumRoundTripUs = 0.0f;
+
+        m_transport->flush();
+        incoming_ring.clear();
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < nbRoundTrips; i++)
+        {
+            const auto sendTime = std::chrono::steady_clock::now();
+            bool success = writeDataImpl(commandData, commandSize) && getDataImpl(reply, false) > 0;
+            const float roundTripUs = float(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sendTime).count());
+
+            if (success)
+            {
+                // a wrong baud rate gives garbage bytes, or a line but not the expected one
+                const std::string deviceType = convertSingleData(reply);
+                if (!expectedReply.empty())
+                    success = (deviceType == expectedReply);
+                else
+                    success = !deviceType.empty() && std::all_of(deviceType.begin(), deviceType.end(), [](char c) { return c >= 0x20 && c < 0x7f; });
+            }
+
+            stats.nbRoundTrips++;
+            nbBytes += commandSize;
+            if (success)
+            {
+                nbBytes += strlen(reply);
+                sumRoundTripUs += roundTripUs;
+                stats.maxRoundTripUs = std::max(stats.maxRoundTripUs, roundTripUs);
+            }
+            else
+            {
+                stats.nbFailures++;
+                // don't let the end of a late reply shift the next ones
+                m_transport->flush();
+                incoming_ring.clear();
+            }
+        }
+
+        const float elapsedS = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+        if (stats.nbRoundTrips > stats.nbFailures)
+            stats.meanRoundTripUs = sumRoundTripUs / float(stats.nbRoundTrips - stats.nbFailures);
+        if (elapsedS > 0.0f)
+            stats.bytesPerSecond = float(nbBytes) / elapsedS;
+
+        return stats;
+    }
+
+
+    int HapticAvatar_DriverBase::negotiateBaudRate(const std::vector<int>& baudRates, int nbProbes, const std::string& expectedReply, std::vector<HapticAvatar_LinkStats>* report)
+    {
+        if (m_linkState != LinkState::Connected || getBaudRate() == 0)
+            return 0;
+
+        const int previousRate = m_linkSettings.baudRate;
+        for (int baudRate : baudRates)
+        {
+            if (!m_transport->setBaudRate(baudRate))
+                continue;
+            m_linkSettings.baudRate = baudRate;
+
+            HapticAvatar_LinkStats stats = runLinkSelfTest(nbProbes, expectedReply);
+            if (report != nullptr)
+                report->push_back(stats);
+
+            if (stats.nbFailures == 0)
+                return baudRate;
+        }
+
+        // no rate worked, go back to the one the device was answering at
+        m_transport->setBaudRate(previousRate);
+        m_linkSettings.baudRate = previousRate;
+        return 0;
+    }
+
+
     std::string HapticAvatar_DriverBase::convertSingleData(char* buffer, bool forceRemoveEoL)
     {
         std::string res = std::string(buffer);
+        if (res.empty())
+            return res;
+
         if (forceRemoveEoL)
             res.pop_back();
         else if (res.back() == '\n')
             res.pop_back();
 
-        while (res.back() == ' ' || res.back() == '\n')
+        while (!res.empty() && (res.back() == ' ' || res.back() == '\n'))
         {
             res.pop_back();
         }
@@ -121,81 +241,408 @@ namespace sofa::HapticAvatar
     /////      Internal Methods for device communication      /////
     ///////////////////////////////////////////////////////////////
 
+    bool HapticAvatar_DriverBase::connect()
+    {
+        connectAsync();
+        return waitConnected();
+    }
+
+
+    void HapticAvatar_DriverBase::connectAsync()
+    {
+        if (m_transport != nullptr || m_connectThread.joinable())
+            return;
+
+        m_connectThread = std::thread(&HapticAvatar_DriverBase::connectDevice, this);
+    }
+
+
+    bool HapticAvatar_DriverBase::waitConnected()
+    {
+        if (m_connectThread.joinable())
+            m_connectThread.join();
+
+        if (m_linkState != LinkState::Connected)
+        {
+            msg_error("HapticAvatar_DriverBase") << "## Device Not Connected at port: " << m_portName;
+        }
+
+        return m_linkState == LinkState::Connected;
+    }
+
+
     void HapticAvatar_DriverBase::connectDevice()
     {
-        //Try to connect to the given port throuh CreateFile
-        m_hSerial = CreateFileA(m_portName.c_str(),
-            GENERIC_READ | GENERIC_WRITE,
-            0,
-            NULL,
-            OPEN_EXISTING,
-            FILE_ATTRIBUTE_NORMAL,
-            NULL
-        );
-
-        //Check if the connection was successfull
-        if (m_hSerial == INVALID_HANDLE_VALUE)
+        m_transport = HapticAvatar_Transport::create(m_transportType, m_portName);
+        if (m_transport == nullptr)
+            return;
+
+        if (!m_linkSettings.captureFile.empty())
+            m_transport = new HapticAvatar_CaptureTransport(m_transport, m_linkSettings.captureFile);
+
+        m_transport->setLinkSettings(m_linkSettings);
+
+        if (!m_transport->open())
+            return;
+
+        if (!startLink())
         {
-            //If not success full display an Error
-            if (GetLastError() == ERROR_FILE_NOT_FOUND) {
+            msg_error("HapticAvatar_DriverBase") << "Device on " << m_portName << " didn't answer within " << DEVICE_READY_TIMEOUT_MS << " ms.";
+            m_transport->close();
+            return;
+        }
 
-                //Print Error if neccessary
-                msg_error("HapticAvatar_DriverBase") << "Handle was not attached. Reason: " << m_portName << " not available.";
-            }
-            else
+        m_linkState = LinkState::Connected;
+    }
+
+
+    bool HapticAvatar_DriverBase::startLink()
+    {
+        if (!waitDeviceReady())
+            return false;
+
+        if (m_linkSettings.binaryProtocol)
+            negotiateBinaryMode();
+
+        // the failures of the probes sent while the device was booting don't count
+        m_linkBroken = false;
+
+        if (m_linkSettings.ioThread)
+            startIoThread();
+
+        return true;
+    }
+
+
+    void HapticAvatar_DriverBase::onLinkLost()
+    {
+        // the batches in flight will never be answered, and the appended commands may be in the framing of the previous link
+        batch_count = 0;
+        batch_head_started = false;
+        m_consecutiveTimeouts = 0;
+        m_consecutiveResyncs = 0;
+        cmd_appended_encoder.clear();
+        cmd_appended_size = 0;
+        sticky_replay_size = 0;
+        link_clock.reset();
+        requeueQueries(0);
+
+        // the replay can't be reopened to the point where it was lost
+        if (!m_linkSettings.autoReconnect || m_transportType == "replay" || m_transportType == "replay-max")
+        {
+            msg_error("HapticAvatar_DriverBase") << "Link to " << m_portName << " lost.";
+            m_linkState = LinkState::Disconnected;
+            stopIoThread();
+            return;
+        }
+
+        msg_warning("HapticAvatar_DriverBase") << "Link to " << m_portName << " lost, reconnecting in the background.";
+
+        // from now on the reconnection thread owns the link, the ring and the parser until it sets LinkState::Restoring
+        m_reconnecting = true;
+        m_linkState = LinkState::Reconnecting;
+        if (m_connectThread.joinable())
+            m_connectThread.join(); // the connection thread ended when it set LinkState::Connected
+        m_connectThread = std::thread(&HapticAvatar_DriverBase::reconnectDevice, this);
+    }
+
+
+    void HapticAvatar_DriverBase::reconnectDevice()
+    {
+        stopIoThread();
+        m_transport->close();
+
+        const auto start = std::chrono::steady_clock::now();
+        int retryMs = RECONNECT_RETRY_MS;
+        int nbAttempts = 0;
+        while (!m_closing)
+        {
+            // start again from the ASCII lines: the device may have been replaced by another firmware
+            incoming_ring.clear();
+            m_binaryMode = false;
+            response_parser.setBinaryMode(false);
+
+            nbAttempts++;
+            m_transport->setLinkSettings(m_linkSettings);
+            if (m_transport->open())
             {
-                msg_error("HapticAvatar_DriverBase") << "Unknown error occured!";
+                if (startLink())
+                {
+                    m_reconnectCounter++;
+                    msg_info("HapticAvatar_DriverBase") << "Link to " << m_portName << " reconnected after "
+                        << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms, " << nbAttempts << " attempts.";
+                    m_linkState = LinkState::Restoring;
+                    return;
+                }
+                m_transport->close();
             }
+
+            // sleep by short steps to notice the destruction of the driver
+            const auto retryTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(retryMs);
+            while (!m_closing && std::chrono::steady_clock::now() < retryTime)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            retryMs = std::min(2 * retryMs, RECONNECT_MAX_RETRY_MS);
         }
-        else
+    }
+
+
+    void HapticAvatar_DriverBase::resumeLink()
+    {
+        m_reconnecting = false;
+        if (m_connectThread.joinable())
+            m_connectThread.join(); // the reconnection thread ended when it set LinkState::Restoring
+
+        // the commands appended while the link was down were never sent, only their sticky values are
+        cmd_appended_encoder.clear();
+        cmd_appended_size = 0;
+
+        // the rebooted device lost its state: send the sticky values again, oldest first
+        for (int i = 0; i < sticky_table_size; i++)
+            sticky_replay_order[i] = i;
+        std::sort(sticky_replay_order, sticky_replay_order + sticky_table_size, [this](int a, int b) { return sticky_table[a].stamp < sticky_table[b].stamp; });
+        sticky_replay_size = sticky_table_size;
+        sticky_replay_pos = 0;
+        sticky_replay_stamp = sticky_stamp;
+        sticky_catch_up = false;
+    }
+
+
+    void HapticAvatar_DriverBase::continueStickyReplay()
+    {
+        sticky_replaying = true;
+        while (sticky_replay_pos < sticky_replay_size)
         {
-            //If connected we try to set the comm parameters
-            DCB dcbSerialParams = { 0 };
+            const HapticAvatar_StickyCmd& sticky = sticky_table[sticky_replay_order[sticky_replay_pos]];
 
-            //Try to get the current
-            if (!GetCommState(m_hSerial, &dcbSerialParams))
+            // appended again since the reconnection: its latest value was sent already, or is in the next frame. It is sent again by the second pass.
+            if (sticky.stamp > sticky_replay_stamp)
             {
-                //If impossible, show an error
-                msg_warning("HapticAvatar_DriverBase") << "Failed to get current serial parameters!";
+                sticky_replay_pos++;
+                continue;
             }
+
+            // the values which don't fit are kept for the next frames, never dropped
+            const int nbValues = std::max(sticky.nbArgs, 1);
+            const unsigned int maxSize = m_binaryMode ? 2 + 4 * nbValues : 16 * (nbValues + 1);
+            if (cmd_appended_size >= MAX_APPENDED_CMDS || cmd_appended_encoder.size() + maxSize > cmd_appended_encoder.capacity())
+                break;
+
+            if (sticky.nbArgs < 0)
+                appendFloat(sticky.cmd, sticky.value);
             else
+                appendCmd(sticky.cmd, sticky.args, sticky.nbArgs);
+            sticky_replay_pos++;
+        }
+        sticky_replaying = false;
+
+        if (sticky_replay_pos < sticky_replay_size)
+            return;
+
+        if (sticky_catch_up)
+        {
+            sticky_replay_size = 0;
+            return;
+        }
+
+        // Second pass: a value appended by the simulation during the first pass may have been overwritten on the device by an older related value
+        // sent again after it (e.g. a collision object position, then the whole object). Send these values again, in their order.
+        sticky_replay_size = 0;
+        for (int i = 0; i < sticky_table_size; i++)
+        {
+            if (sticky_table[i].stamp > sticky_replay_stamp)
+                sticky_replay_order[sticky_replay_size++] = i;
+        }
+        std::sort(sticky_replay_order, sticky_replay_order + sticky_replay_size, [this](int a, int b) { return sticky_table[a].stamp < sticky_table[b].stamp; });
+        sticky_replay_pos = 0;
+        sticky_replay_stamp = sticky_stamp;
+        sticky_catch_up = true;
+    }
+
+
+    bool HapticAvatar_DriverBase::waitDeviceReady()
+    {
+        char commandData[] = "1 \n"; // GET_DEVICE_TYPE command is number 1 on all Haptic Avatar devices
+        char reply[INCOMING_DATA_LEN];
+        int nbProbes = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto deadline = start + std::chrono::milliseconds(DEVICE_READY_TIMEOUT_MS);
+        while (std::chrono::steady_clock::now() < deadline && !m_closing)
+        {
+            // a booting board may send garbage, only a full printable line tells it is ready
+            m_transport->flush();
+            if (!writeDataImpl(commandData, sizeof(commandData) - 1))
+                return false;
+            nbProbes++;
+
+            const auto probeDeadline = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::microseconds(DEVICE_READY_POLL_US));
+            unsigned int size = 0;
+            while (size + 1 < INCOMING_DATA_LEN)
             {
-                //Define serial connection parameters for the arduino board
-                dcbSerialParams.BaudRate = CBR_9600;
-                dcbSerialParams.ByteSize = 8;
-                dcbSerialParams.StopBits = ONESTOPBIT;
-                dcbSerialParams.Parity = NOPARITY;
-                //Setting the DTR to Control_Enable ensures that the Arduino is properly
-                //reset upon establishing a connection
-                dcbSerialParams.fDtrControl = DTR_CONTROL_ENABLE;
-
-                //Set the parameters and check for their proper application
-                if (!SetCommState(m_hSerial, &dcbSerialParams))
+                int remainingUs = int(std::chrono::duration_cast<std::chrono::microseconds>(probeDeadline - std::chrono::steady_clock::now()).count());
+                if (remainingUs <= 0)
+                    break;
+
+                int n = m_transport->readWait(reply + size, INCOMING_DATA_LEN - 1 - size, remainingUs);
+                if (n < 0)
+                    return false;
+
+                size += n;
+                reply[size] = '\0';
+                if (n == 0 || memchr(reply + size - n, '\n', n) == nullptr)
+                    continue;
+
+                const std::string deviceType = convertSingleData(reply);
+                if (deviceType.empty() || !std::all_of(deviceType.begin(), deviceType.end(), [](char c) { return c >= 0x20 && c < 0x7f; }))
+                    break;
+
+                // the device may still answer to the previous probes, wait until the link is quiet before using it
+                if (nbProbes > 1)
                 {
-                    msg_warning("HapticAvatar_DriverBase") << "ALERT: Could not set Serial Port parameters";
+                    while (m_transport->readWait(reply, INCOMING_DATA_LEN, DEVICE_READY_POLL_US) > 0) {}
                 }
-                else
+                m_transport->flush();
+
                 {
-                    //If everything went fine we're connected
-                    m_connected = true;
-                    //Flush any remaining characters in the buffers
-                    PurgeComm(m_hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
-                    //We wait 2s as the arduino board will be reseting
-                    Sleep(ARDUINO_WAIT_TIME);
+                    std::lock_guard<std::mutex> lock(m_deviceTypeMutex);
+                    m_deviceType = deviceType;
                 }
+
+                msg_info("HapticAvatar_DriverBase") << "Device '" << deviceType << "' on " << m_portName << " ready after "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms.";
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    bool HapticAvatar_DriverBase::negotiateBinaryMode()
+    {
+        char frameData[16];
+        HapticAvatar_CommandEncoder encoder(frameData, sizeof(frameData));
+        startFrame(encoder, true);
+        putCommandId(encoder, 1, 0, true); // GET_DEVICE_TYPE command is number 1 on all Haptic Avatar devices
+        endFrame(encoder, true);
+
+        m_transport->flush();
+        incoming_ring.clear();
+        response_parser.setBinaryMode(true);
+        response_parser.beginFrame(1);
+        if (writeDataImpl(frameData, encoder.size()))
+        {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(COMMAND_TIMEOUT_US);
+            if (receiveFrame(true, deadline) == HapticAvatar_ResponseParser::Status::FrameComplete)
+            {
+                m_binaryMode = true;
+                response_parser.reset();
+                msg_info("HapticAvatar_DriverBase") << "Binary framing enabled on " << m_portName;
+                return true;
             }
         }
+
+        // Older firmware, forget whatever it answered and keep the ASCII lines
+        m_transport->flush();
+        incoming_ring.clear();
+        response_parser.setBinaryMode(false);
+        msg_info("HapticAvatar_DriverBase") << "Device on " << m_portName << " doesn't support the binary framing, using ASCII.";
+        return false;
+    }
+
+
+    bool HapticAvatar_DriverBase::startFrame(HapticAvatar_CommandEncoder& encoder, bool binary)
+    {
+        encoder.clear();
+        if (!binary)
+            return true;
+
+        return encoder.putUInt8(BINARY_SYNC_BYTE) && encoder.putUInt16(0);
+    }
+
+
+    bool HapticAvatar_DriverBase::endFrame(HapticAvatar_CommandEncoder& encoder, bool binary)
+    {
+        if (!binary)
+            return encoder.putBytes(" \n", 2);
+
+        encoder.setUInt16At(1, uint16_t(encoder.size() - BINARY_HEADER_LEN));
+        return encoder.putUInt16(crc16Ccitt(encoder.data() + 1, encoder.size() - 1));
+    }
+
+
+    bool HapticAvatar_DriverBase::putCommandId(HapticAvatar_CommandEncoder& encoder, int cmd, int nbArgs, bool binary)
+    {
+        if (!binary)
+            return encoder.putInt(cmd);
+
+        return encoder.putUInt8(uint8_t(cmd)) && encoder.putUInt8(uint8_t(nbArgs));
     }
 
 
     int HapticAvatar_DriverBase::getDataImpl(char* buffer, bool do_flush)
     {
+        int num_cr = 0;
+        if (m_ioRunning)
+        {
+            // the I/O thread owns the link: take the reply line from the ring
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(COMMAND_TIMEOUT_US);
+            HapticAvatar_RingView line;
+            while (!incoming_ring.peekLine(line))
+            {
+                if (!waitIoBytes(incoming_ring.size(), deadline))
+                {
+                    buffer[0] = '\0';
+                    m_receiveTimeoutCounter++;
+                    return -1;
+                }
+            }
+
+            const unsigned int size = std::min(line.size(), (unsigned int)INCOMING_DATA_LEN - 1);
+            line.copyTo(buffer, size);
+            buffer[size] = '\0';
+            incoming_ring.consume(line.size());
+            return 1;
+        }
+
+        if (m_receiveMode == ReceiveMode::Blocking)
+        {
+            // accumulate the reply until its end of line
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(COMMAND_TIMEOUT_US);
+            unsigned int size = 0;
+            buffer[0] = '\0';
+            while (size + 1 < INCOMING_DATA_LEN)
+            {
+                int remainingUs = int(std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count());
+                if (remainingUs <= 0)
+                    break;
+
+                int n = m_transport->readWait(buffer + size, INCOMING_DATA_LEN - 1 - size, remainingUs);
+                if (n < 0)
+                {
+                    m_linkBroken = true;
+                    break;
+                }
+
+                size += n;
+                buffer[size] = '\0';
+                if (n > 0 && memchr(buffer + size - n, '\n', n) != nullptr)
+                {
+                    for (unsigned int i = 0; i < size; i++)
+                        num_cr += (buffer[i] == '\n');
+                    return num_cr;
+                }
+            }
+
+            m_receiveTimeoutCounter++;
+            return -1;
+        }
+
         bool response = false;
         int cptSecu = 0;
         int n = 0;
         int que = 0;
         char* pch;
-        int num_cr = 0;
         while (!response && cptSecu < 10000)
         {
             n = readDataImpl(buffer, INCOMING_DATA_LEN, &que, do_flush);
@@ -216,7 +663,7 @@ namespace sofa::HapticAvatar
 
         if (!response) // secu loop reach end
         {
-            std::cerr << "## Error getData no message returned. Reach security loop limit: " << cptSecu << std::endl;
+            m_receiveTimeoutCounter++;
             return -1;
         }
 
@@ -226,200 +673,864 @@ namespace sofa::HapticAvatar
 
     int HapticAvatar_DriverBase::readDataImpl(char* buffer, unsigned int nbChar, int* queue, bool do_flush)
     {
-        //Number of bytes we'll have read
-        DWORD bytesRead = 0;
-        DWORD junkBytesRead = 0;
+        // With or without do_flush, the former Win32 code read the bytes already queued in the port, up to nbChar (do_flush only capped
+        // the read to the buffer size). The transport read below always does that on every platform, so there is nothing left to flush here.
+        // Discarding the pending bytes is done by HapticAvatar_Transport::flush (tcflush / PurgeComm).
+        SOFA_UNUSED(do_flush);
 
-        //Use the ClearCommError function to get status info on the Serial port
-        ClearCommError(m_hSerial, &m_errors, &m_status);
+        *queue = 0;
+        if (nbChar < 2)
+            return 0;
 
-        *queue = (int)m_status.cbInQue;
+        // Wait a few microseconds for incoming bytes so that the polling loop in getDataImpl doesn't only spin on syscalls
+        if (!m_transport->waitReadable(10))
+            return 0;
 
+        *queue = m_transport->bytesAvailable();
 
-        if (do_flush) {
-            if (*queue > 0)
-                // read away as much as possible, max 512
-                ReadFile(m_hSerial, buffer, std::min(unsigned int(*queue), nbChar), &bytesRead, NULL);
-        }
-        else {
-            // regardless of what the queue is, read nbChar bytes, in an attempt to suspend the thread
-            ReadFile(m_hSerial, buffer, *queue, &bytesRead, NULL);
-            //ClearCommError(this->hSerial, &this->errors, &this->status);
-            //*queue = (int)status.cbInQue;
-            //if (*queue > 0) {
-            //	char junkbuffer[32];
-            //	// clear the buffer from any remaining bytes
-            //	ReadFile(this->hSerial, junkbuffer, min(*queue, 32), &junkBytesRead, NULL);
-            //}
+        // keep one byte for the string terminator
+        int bytesRead = m_transport->read(buffer, nbChar - 1);
+        if (bytesRead < 0)
+            m_linkBroken = true;
+        if (bytesRead <= 0)
+            return 0;
 
-        }
+        buffer[bytesRead] = '\0';
         return bytesRead;
     }
 
 
     bool HapticAvatar_DriverBase::writeDataImpl(char* buffer, unsigned int nbChar)
     {
-        DWORD bytesSend;
+        if (m_transport->write(buffer, nbChar))
+            return true;
 
-        //Try to write the buffer on the Serial port
-        if (!WriteFile(m_hSerial, (void*)buffer, nbChar, &bytesSend, 0))
-        {
-            //In case it don't work get comm error and return false
-            ClearCommError(m_hSerial, &m_errors, &m_status);
+        m_linkBroken = true;
+        return false;
+    }
 
-            std::cerr << "Error failed to send command: '" << buffer << "'. Error returned: " << m_errors << std::endl;
+
+    void HapticAvatar_DriverBase::update()
+    {
+        // tells the threads waiting for a query that this one sends it, see waitQuery
+        m_updateOwner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        tryUpdate();
+    }
+
+    bool HapticAvatar_DriverBase::tryUpdate()
+    {
+        // a thread waiting for a query may be updating the driver, e.g. when the haptic thread starts
+        if (m_updating.exchange(true, std::memory_order_acquire))
             return false;
+
+        updateExchange();
+        m_updating.store(false, std::memory_order_release);
+        return true;
+    }
+
+    void HapticAvatar_DriverBase::updateExchange()
+    {
+        // the link was reopened by the reconnection thread, take it back
+        if (m_reconnecting && m_linkState == LinkState::Restoring)
+            resumeLink();
+
+        if (m_linkState != LinkState::Connected && m_linkState != LinkState::Restoring) {
+            // nothing can be sent: forget the commands appended meanwhile, the sticky values are sent again once the link is back
+            cmd_appended_encoder.clear();
+            cmd_appended_size = 0;
+            return;
+        }
+
+        if (m_linkBroken) {
+            onLinkLost();
+            return;
+        }
+
+        // first, receive the data from the previously sent commands. Waits only if no more batch can be sent before a reply.
+
+        updateReceive();
+
+        // the sticky values not sent again yet since a reconnection are added to the appended commands
+        if (sticky_replay_size > 0)
+            continueStickyReplay();
+
+        // the new batch is built directly in its slot of the pipeline
+        HapticAvatar_SentBatch& batch = sent_batches[(batch_head + batch_count) % MAX_PIPELINE_DEPTH];
+        batch.cmd_send_list_size = 0;
+        batch.expected_num_return_vals = 0;
+
+        // keep room for the frame terminator: " \n" or the binary CRC
+        const unsigned int terminatorSize = 2;
+        startFrame(send_encoder, m_binaryMode);
+
+        // fill the cmd_send_list again with the subscriptions due at this tick. The room of the appended commands is kept, so that they are never delayed.
+        const unsigned int reservedSize = cmd_appended_encoder.size() + terminatorSize;
+        int nbScheduled = subscription_scheduler.schedule(scheduled_cmds, SCHEDULER_MAX_CMDS);
+        for (int i = 0; i < nbScheduled; i++) {
+            const int k = scheduled_cmds[i];
+            unsigned int mark = send_encoder.mark();
+            if (!putCommandId(send_encoder, k, 0, m_binaryMode) || send_encoder.size() + reservedSize > send_encoder.capacity()) {
+                send_encoder.rollback(mark);
+                break;
+            }
+            batch.cmd_send_list[batch.cmd_send_list_size++] = k;
+            batch.expected_num_return_vals += num_return_vals[k];
+        }
+
+        // add the appended commands, if any.
+        bool appendedSent = false;
+        if (cmd_appended_size > 0 && send_encoder.size() + cmd_appended_encoder.size() + terminatorSize <= send_encoder.capacity()
+            && batch.cmd_send_list_size + cmd_appended_size <= MAX_BATCH_CMDS) {
+            for (int k = 0; k < cmd_appended_size; k++) {
+                batch.cmd_send_list[batch.cmd_send_list_size++] = cmd_appended[k].cmd;
+                batch.expected_num_return_vals += num_return_vals[cmd_appended[k].cmd];
+            }
+            send_encoder.putBytes(cmd_appended_encoder.data(), cmd_appended_encoder.size());
+            appendedSent = true;
+        }
+
+        // then the one-shot queries, after the appended commands so that their reply reflects them
+        if (m_pendingQueries.load(std::memory_order_acquire) > 0)
+            appendQueries(batch, terminatorSize);
+
+        // terminate the send string
+        endFrame(send_encoder, m_binaryMode);
+
+        unsigned int bytesSent = 0;
+        if (batch.cmd_send_list_size > 0) {
+            // Send the total command string to the device.
+            batch.send_time_ns = hostTimeNs();
+            batch.send_size = send_encoder.size();
+            bool write_success = writeDataImpl(outgoingData, send_encoder.size());
+            if (!write_success) {
+                msg_warning("HapticAvatar_DriverBase") << "Write to device type " << std::to_string(device_type) << " failed.";
+                requeueQueries(m_batchSeq + 1);
+            }
+            else {
+                bytesSent = send_encoder.size();
+                if (batch.expected_num_return_vals > 0) {
+                    // wait for the reply of this batch in the next updates
+                    batch.seq = ++m_batchSeq;
+                    batch_count++;
+                }
+            }
+        }
+
+        // Clear the appended list and string
+        if (appendedSent) {
+            cmd_appended_encoder.clear();
+            cmd_appended_size = 0;
+        }
+
+        // traffic of this tick, the received bytes may have been read by the I/O thread
+        const uint64_t bytesReceived = m_bytesReceived.load(std::memory_order_relaxed);
+        bytes_sent_per_tick.record(bytesSent);
+        bytes_received_per_tick.record(uint32_t(bytesReceived - bytes_received_at_tick));
+        bytes_received_at_tick = bytesReceived;
+
+        send_counter++;
+    }
+
+    void HapticAvatar_DriverBase::updateReceive()
+    {
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        while (batch_count > 0)
+        {
+            const HapticAvatar_SentBatch& batch = sent_batches[batch_head];
+            if (!batch_head_started)
+            {
+                response_parser.beginFrame(batch.expected_num_return_vals);
+                batch_head_started = true;
+            }
+
+            // only wait if the pipeline is full, otherwise the reply will be read at a later update
+            const bool pipelineFull = batch_count >= m_pipelineDepth;
+            if (pipelineFull && deadline == std::chrono::steady_clock::time_point::max())
+                deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(getBatchTimeoutUs(batch));
+            HapticAvatar_ResponseParser::Status status = receiveFrame(pipelineFull, deadline);
+            if (status == HapticAvatar_ResponseParser::Status::NeedMoreData)
+            {
+                if (!pipelineFull)
+                    return;
+
+                // No complete reply in time
+                m_receiveTimeoutCounter++;
+                if (++m_consecutiveTimeouts >= RECEIVE_RESYNC_TIMEOUTS)
+                {
+                    // the device doesn't answer anymore or we lost track of its replies, restart from an empty link
+                    m_transport->flush();
+                    incoming_ring.clear();
+                    response_parser.reset();
+                    link_clock.reset();
+                    batch_count = 0;
+                    batch_head_started = false;
+                    m_consecutiveTimeouts = 0;
+                    requeueQueries(0);
+
+                    // still nothing after resynchronising: the device is gone or hung, reopen the link
+                    if (++m_consecutiveResyncs >= LINK_LOST_RESYNCS)
+                        m_linkBroken = true;
+                    return;
+                }
+
+                // the reply may never come, e.g. if the request was corrupted: don't wait for it beyond the next send
+                drainLateReplies();
+                return;
+            }
+            else
+            {
+                m_consecutiveTimeouts = 0;
+                m_consecutiveResyncs = 0;
+                if (status == HapticAvatar_ResponseParser::Status::FrameComplete)
+                {
+                    // first reply after a reconnection: the values are fresh again
+                    if (m_linkState == LinkState::Restoring)
+                        m_linkState = LinkState::Connected;
+
+                    // a reply not waited for may have been complete since the previous update, the fastest round trips of the window filter this out
+                    const int64_t receiveTimeNs = hostTimeNs();
+                    link_clock.addRoundTrip(batch.send_time_ns, receiveTimeNs);
+                    recordLatency(batch, receiveTimeNs);
+                    parseMessage(batch, link_clock.toSampleTime(receiveTimeNs));
+                    completeQueries(batch);
+                    m_lastReceivedSeq = batch.seq;
+                }
+            }
+
+            // the queries of a batch without reply are sent again
+            if (status != HapticAvatar_ResponseParser::Status::FrameComplete)
+                requeueQueries(batch.seq);
+
+            popBatch();
+        }
+    }
+
+    void HapticAvatar_DriverBase::drainLateReplies()
+    {
+        // the replies come in order: the batches sent after the late one can't be answered first
+        const int nbDropped = batch_count;
+        const HapticAvatar_SentBatch& lastBatch = sent_batches[(batch_head + batch_count - 1) % MAX_PIPELINE_DEPTH];
+        const int64_t lastSendTimeNs = lastBatch.send_time_ns;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(getBatchTimeoutUs(lastBatch));
+        while (batch_count > 0)
+        {
+            requeueQueries(sent_batches[batch_head].seq);
+            popBatch();
+        }
+
+        response_parser.skipFrames(nbDropped);
+        while (response_parser.isSkipping() && !m_linkBroken && std::chrono::steady_clock::now() < deadline)
+            receiveFrame(true, deadline);
+
+        if (response_parser.isSkipping())
+        {
+            // a reply still missing is lost, or the rest of a reply cut by a lost byte: forget what came of it
+            incoming_ring.clear();
+            response_parser.reset();
         }
         else
-            return true;
+        {
+            // the round trip of a slow link is learnt even if all its replies are late, see @sa getBatchTimeoutUs
+            link_clock.addRoundTrip(lastSendTimeNs, hostTimeNs());
+        }
     }
 
+    int HapticAvatar_DriverBase::getBatchTimeoutUs(const HapticAvatar_SentBatch& batch) const
+    {
+        if (m_receiveTimeoutUs > 0)
+            return m_receiveTimeoutUs;
 
-    void HapticAvatar_DriverBase::update()
+        int64_t timeoutUs = RECEIVE_TIMEOUT_US;
+        const int baudRate = getBaudRate();
+        if (baudRate > 0)
+        {
+            // transfer time of the request and of the reply, 10 bits per byte with the start and stop bits
+            const unsigned int replySize = m_binaryMode ? BINARY_HEADER_LEN + 4 * batch.expected_num_return_vals + BINARY_CRC_LEN
+                : REPLY_ASCII_BYTES_PER_VALUE * batch.expected_num_return_vals + 2;
+            timeoutUs += int64_t(batch.send_size + replySize) * 10 * 1000000 / baudRate;
+        }
+
+        return int(std::max(timeoutUs, int64_t(RECEIVE_TIMEOUT_RTT_FACTOR * link_clock.getMinRoundTripUs())));
+    }
+
+    std::future<HapticAvatar_QueryResult> HapticAvatar_DriverBase::requestOnce(int cmd, const int* args, int nbArgs)
     {
-        if (m_connected) {
-            // first, receive the data from the previously sent commands
+        std::promise<HapticAvatar_QueryResult> promise;
+        std::future<HapticAvatar_QueryResult> future = promise.get_future();
+        HapticAvatar_QueryResult noReply;
+        noReply.cmd = cmd;
+
+        if (cmd < 0 || cmd >= device_num_cmds || num_return_vals[cmd] == 0 || nbArgs < 0 || nbArgs > MAX_QUERY_ARGS) {
+            msg_error("HapticAvatar_DriverBase") << "Command " << cmd << " can't be queried: it has no reply or more than " << MAX_QUERY_ARGS << " arguments.";
+            promise.set_value(noReply);
+            return future;
+        }
 
-            updateReceive();
+        for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+            HapticAvatar_PendingQuery& query = pending_queries[i];
+            int expected = HapticAvatar_PendingQuery::Free;
+            if (!query.state.compare_exchange_strong(expected, HapticAvatar_PendingQuery::Claimed, std::memory_order_acquire))
+                continue;
+
+            query.cmd = cmd;
+            query.nbArgs = nbArgs;
+            for (int a = 0; a < nbArgs; a++)
+                query.args[a] = args[a];
+            query.promise = std::move(promise);
+
+            // the slot is complete before the thread running update() can see it
+            m_pendingQueries.fetch_add(1, std::memory_order_relaxed);
+            query.state.store(HapticAvatar_PendingQuery::Queued, std::memory_order_release);
+            return future;
+        }
 
-            std::string send_string; 
+        msg_warning("HapticAvatar_DriverBase") << MAX_PENDING_QUERIES << " queries are already pending, command " << cmd << " not sent.";
+        promise.set_value(noReply);
+        return future;
+    }
 
-            // fill the cmd_send_list again, starting with the cmd_always list  based on the subscription
-            for (int k = 0; k < device_num_cmds; k++) {
-                if (update_cmd_every_nth[k] > 0) {
-                    if ((send_counter % update_cmd_every_nth[k]) == 0) {
-                        cmd_send_list[cmd_send_list_size++] = k;
-                        expected_num_return_vals += num_return_vals[k];
-                        send_string += std::to_string(k) + " ";
-                    }
+    void HapticAvatar_DriverBase::appendQueries(HapticAvatar_SentBatch& batch, unsigned int reservedSize)
+    {
+        for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+            HapticAvatar_PendingQuery& query = pending_queries[i];
+            if (query.state.load(std::memory_order_acquire) != HapticAvatar_PendingQuery::Queued)
+                continue;
+
+            // a command without arguments already in the frame, e.g. subscribed, answers the query too
+            bool inFrame = false;
+            for (int k = 0; k < batch.cmd_send_list_size && query.nbArgs == 0; k++) {
+                if (batch.cmd_send_list[k] == query.cmd) {
+                    inFrame = true;
+                    break;
                 }
             }
 
-            // add the appended commands, if any
-            if (cmd_appended_size > 0) {
-                for (int k = 0; k < cmd_appended_size; k++) {
-                    cmd_send_list[cmd_send_list_size++] = cmd_appended[k];
-                    expected_num_return_vals += num_return_vals[cmd_appended[k]];
+            if (!inFrame) {
+                if (batch.cmd_send_list_size >= MAX_BATCH_CMDS)
+                    return;
+
+                unsigned int mark = send_encoder.mark();
+                bool fit = putCommandId(send_encoder, query.cmd, query.nbArgs, m_binaryMode);
+                for (int a = 0; a < query.nbArgs && fit; a++)
+                    fit = m_binaryMode ? send_encoder.putInt32(query.args[a]) : send_encoder.putInt(query.args[a]);
+
+                if (!fit || send_encoder.size() + reservedSize > send_encoder.capacity()) {
+                    // the frame is full, the query waits for the next one
+                    send_encoder.rollback(mark);
+                    return;
                 }
-                send_string += cmd_appended_str;
+                batch.cmd_send_list[batch.cmd_send_list_size++] = query.cmd;
+                batch.expected_num_return_vals += num_return_vals[query.cmd];
             }
 
-            // terminate the send string
-            send_string += " \n";
- 
-            if (cmd_send_list_size > 0) {
-                // Send the total command string to the device.
-                char outgoingData[OUTGOING_DATA_LEN];
-                strcpy(outgoingData, send_string.c_str());
+            // sequence number the batch gets once written
+            query.seq = m_batchSeq + 1;
+            query.state.store(HapticAvatar_PendingQuery::Sent, std::memory_order_relaxed);
+        }
+    }
 
-                auto outlen = (unsigned int)(send_string.size());
-                bool write_success = writeDataImpl(outgoingData, outlen);
-                if (!write_success) {
-                    msg_warning("HapticAvatar_DriverBase") << "Write to device type " << std::to_string(device_type) << " failed.";
+    void HapticAvatar_DriverBase::completeQueries(const HapticAvatar_SentBatch& batch)
+    {
+        if (m_pendingQueries.load(std::memory_order_acquire) == 0)
+            return;
+
+        for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+            HapticAvatar_PendingQuery& query = pending_queries[i];
+            if (query.state.load(std::memory_order_relaxed) != HapticAvatar_PendingQuery::Sent || query.seq != batch.seq)
+                continue;
+
+            // parseMessage just wrote the reply in the result table
+            HapticAvatar_QueryResult result;
+            result.cmd = query.cmd;
+            result.nbValues = num_return_vals[query.cmd];
+            result_table.read(query.cmd, result.values, result.nbValues, &result.sampleTimeNs);
+            query.promise.set_value(result);
+
+            m_pendingQueries.fetch_sub(1, std::memory_order_relaxed);
+            query.state.store(HapticAvatar_PendingQuery::Free, std::memory_order_release);
+        }
+    }
+
+    void HapticAvatar_DriverBase::requeueQueries(unsigned int seq)
+    {
+        if (m_pendingQueries.load(std::memory_order_acquire) == 0)
+            return;
+
+        for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+            HapticAvatar_PendingQuery& query = pending_queries[i];
+            if (query.state.load(std::memory_order_relaxed) == HapticAvatar_PendingQuery::Sent && (seq == 0 || query.seq == seq))
+                query.state.store(HapticAvatar_PendingQuery::Queued, std::memory_order_relaxed);
+        }
+    }
+
+    void HapticAvatar_DriverBase::cancelQueries()
+    {
+        for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+            HapticAvatar_PendingQuery& query = pending_queries[i];
+            const int state = query.state.load(std::memory_order_acquire);
+            if (state != HapticAvatar_PendingQuery::Queued && state != HapticAvatar_PendingQuery::Sent)
+                continue;
+
+            HapticAvatar_QueryResult noReply;
+            noReply.cmd = query.cmd;
+            query.promise.set_value(noReply);
+            m_pendingQueries.fetch_sub(1, std::memory_order_relaxed);
+            query.state.store(HapticAvatar_PendingQuery::Free, std::memory_order_release);
+        }
+    }
+
+    bool HapticAvatar_DriverBase::waitQuery(std::future<HapticAvatar_QueryResult>& future)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(QUERY_TIMEOUT_MS);
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            // the query stays queued and is answered once the link is back, no need to wait for it
+            if (m_linkState != LinkState::Connected && m_linkState != LinkState::Restoring)
+                return false;
+            if (std::chrono::steady_clock::now() >= deadline)
+                return false;
+
+            // the thread driving the driver sends the query, this one doesn't take its place
+            const std::thread::id owner = m_updateOwner.load(std::memory_order_relaxed);
+            const bool drivenByAnotherThread = (owner != std::thread::id() && owner != std::this_thread::get_id());
+            if (drivenByAnotherThread || !tryUpdate())
+                future.wait_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    void HapticAvatar_DriverBase::recordLatency(const HapticAvatar_SentBatch& batch, int64_t receiveTimeNs)
+    {
+        const int64_t roundTripUs = (receiveTimeNs - batch.send_time_ns) / 1000;
+        const uint32_t latency = uint32_t(std::clamp<int64_t>(roundTripUs, 0, UINT32_MAX));
+        batch_latency.record(latency);
+
+        for (int k = 0; k < batch.cmd_send_list_size; k++) {
+            const int cmd = batch.cmd_send_list[k];
+            if (command_latency_seq[cmd] == batch.seq)
+                continue;
+
+            command_latency_seq[cmd] = batch.seq;
+            command_latency[cmd].record(latency);
+        }
+    }
+
+    void HapticAvatar_DriverBase::popBatch()
+    {
+        batch_head = (batch_head + 1) % MAX_PIPELINE_DEPTH;
+        batch_count--;
+        batch_head_started = false;
+    }
+
+    HapticAvatar_ResponseParser::Status HapticAvatar_DriverBase::receiveFrame(bool wait, std::chrono::steady_clock::time_point deadline)
+    {
+        int cptSecu = 0;
+        int que = 0;
+        while (true)
+        {
+            // first parse what is already buffered: the reply may have come with a previous read
+            HapticAvatar_ResponseParser::Status status = response_parser.parse(incoming_ring);
+            if (status != HapticAvatar_ResponseParser::Status::NeedMoreData || response_parser.isIdle())
+                return status;
+
+            if (m_ioRunning)
+            {
+                // the I/O thread reads the link, only wait for it to bring more bytes
+                if (!wait || !waitIoBytes(incoming_ring.size(), deadline))
+                    return status;
+                continue;
+            }
+
+            // read directly into the free space of the ring
+            unsigned int maxRead = 0;
+            char* ringData = incoming_ring.beginWrite(&maxRead);
+            if (maxRead == 0)
+                return status;
+
+            int n = 0;
+            if (!wait)
+            {
+                // take what the link already received, without waiting
+                n = m_transport->read(ringData, maxRead);
+                if (n < 0)
+                    m_linkBroken = true;
+                if (n <= 0)
+                    return status;
+            }
+            else if (m_receiveMode == ReceiveMode::Blocking)
+            {
+                // sleep in the transport until bytes are received, the thread doesn't spin while the device answers
+                int remainingUs = int(std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count());
+                if (remainingUs <= 0)
+                    return status;
+
+                n = m_transport->readWait(ringData, maxRead, remainingUs);
+                if (n < 0)
+                {
+                    m_linkBroken = true;
+                    return status;
                 }
             }
+            else
+            {
+                if (cptSecu >= 10000)
+                    return status;
 
-            // Clear the appended list and string
-            cmd_appended_str.clear();
-            cmd_appended_size = 0;
+                n = readDataImpl(ringData, maxRead, &que, false);
+                cptSecu++;
+            }
 
-            send_counter++;
+            if (n > 0)
+            {
+                incoming_ring.commitWrite(n);
+                m_bytesReceived.fetch_add(n, std::memory_order_relaxed);
+            }
         }
     }
 
-    void HapticAvatar_DriverBase::updateReceive()
+
+    bool HapticAvatar_DriverBase::waitIoBytes(unsigned int knownSize, std::chrono::steady_clock::time_point deadline)
     {
-        if (expected_num_return_vals > 0) {  // expected_num_return_vals is determined from the previous sent command set.
-            getDataImpl(incomingData, false);
-            parseMessage();
+        if (m_receiveMode == ReceiveMode::Polling)
+        {
+            while (incoming_ring.size() == knownSize)
+            {
+                if (!m_ioRunning || std::chrono::steady_clock::now() >= deadline)
+                    return false;
+                std::this_thread::yield();
+            }
+            return true;
         }
-        // now that the previous command is parsed, we can clear it
-        expected_num_return_vals = 0;
-        cmd_send_list_size = 0;
-        //send_string.clear();
+
+        std::unique_lock<std::mutex> lock(m_ioMutex);
+        m_ioReceived.wait_until(lock, deadline, [&] { return incoming_ring.size() != knownSize || !m_ioRunning; });
+        return incoming_ring.size() != knownSize;
     }
 
-    void HapticAvatar_DriverBase::parseMessage()
+
+    void HapticAvatar_DriverBase::startIoThread()
     {
-        // Parse and sort the incoming data into the result table, which is a two dimensional float array
-        char* pEnd = incomingData;
-        for (int k = 0; k < cmd_send_list_size; k++) {
-            for (int i = 0; i < num_return_vals[cmd_send_list[k]]; i++) {
-                result_table[cmd_send_list[k]][i] = std::strtof(pEnd, &pEnd) / scale_factor[cmd_send_list[k]];
+        if (m_ioThread.joinable())
+            return;
+
+        // the replay must stay deterministic: its records are consumed by the haptic thread only
+        if (m_transportType == "replay" || m_transportType == "replay-max")
+        {
+            msg_warning("HapticAvatar_DriverBase") << "The I/O thread is not used with the " << m_transportType << " transport.";
+            return;
+        }
+
+        // from now on, the I/O thread is the only one writing into the ring
+        m_ioRunning = true;
+        m_ioThread = std::thread(&HapticAvatar_DriverBase::ioLoop, this);
+    }
+
+
+    void HapticAvatar_DriverBase::stopIoThread()
+    {
+        m_ioRunning = false;
+        if (m_ioThread.joinable())
+            m_ioThread.join();
+    }
+
+
+    void HapticAvatar_DriverBase::ioLoop()
+    {
+        while (m_ioRunning)
+        {
+            unsigned int maxRead = 0;
+            char* ringData = incoming_ring.beginWrite(&maxRead);
+            if (maxRead == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(IO_THREAD_FULL_RING_SLEEP_US));
+                continue;
+            }
+
+            const int n = m_transport->readWait(ringData, maxRead, IO_THREAD_POLL_US);
+            if (n < 0)
+            {
+                // handled by the haptic thread at the next update
+                m_linkBroken = true;
+                break;
             }
+
+            if (n > 0)
+            {
+                incoming_ring.commitWrite(n);
+                m_bytesReceived.fetch_add(n, std::memory_order_relaxed);
+                // taking the lock orders the new bytes with the check of a haptic thread going to sleep, so the wake up is never missed
+                {
+                    std::lock_guard<std::mutex> lock(m_ioMutex);
+                }
+                m_ioReceived.notify_one();
+            }
+        }
+
+        // back to reading the link from the haptic thread
+        {
+            std::lock_guard<std::mutex> lock(m_ioMutex);
+            m_ioRunning = false;
         }
+        m_ioReceived.notify_one();
+    }
+
+    void HapticAvatar_DriverBase::parseMessage(const HapticAvatar_SentBatch& batch, int64_t sampleTimeNs)
+    {
+        // Sort the values of the complete frame into the result table, which is a two dimensional float array
+        const float* values = response_parser.values();
+        float row[RESULT_SIZEY];
+        int v = 0;
+        for (int k = 0; k < batch.cmd_send_list_size; k++) {
+            const int cmd = batch.cmd_send_list[k];
+            if (num_return_vals[cmd] == 0)
+                continue;
+
+            for (int i = 0; i < num_return_vals[cmd]; i++) {
+                row[i] = values[v++] / scale_factor[cmd];
+            }
+            result_table.write(cmd, row, num_return_vals[cmd], sampleTimeNs);
+
+            if (cmd == delta_t_cmd)
+                link_clock.setDeviceLoopPeriod(row[0]);
+        }
+    }
+
+    int64_t HapticAvatar_DriverBase::hostTimeNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::chrono::steady_clock::time_point HapticAvatar_DriverBase::getSampleTime(int cmd) const
+    {
+        return std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(result_table.getTimestamp(cmd))));
+    }
+
+    bool HapticAvatar_DriverBase::getExtrapolated(int cmd, float* values, int nbValues, std::chrono::steady_clock::time_point time) const
+    {
+        float previous[RESULT_SIZEY];
+        int64_t timeNs = 0;
+        int64_t previousTimeNs = 0;
+        const unsigned int generation = result_table.readWithPrevious(cmd, values, &timeNs, previous, &previousTimeNs, nbValues);
+
+        const int64_t intervalNs = timeNs - previousTimeNs;
+        if (generation < 2 || previousTimeNs == 0 || intervalNs <= 0)
+            return false;
+
+        const int64_t targetNs = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        const int64_t horizonNs = std::max<int64_t>(0, std::min<int64_t>({ targetNs - timeNs, intervalNs, int64_t(MAX_EXTRAPOLATION_US) * 1000 }));
+        const float ratio = float(horizonNs) / float(intervalNs);
+        for (int i = 0; i < nbValues; i++)
+            values[i] += (values[i] - previous[i]) * ratio;
+
+        return true;
+    }
+
+    void HapticAvatar_DriverBase::setPipelineDepth(int depth)
+    {
+        m_pipelineDepth = std::max(1, std::min(depth, MAX_PIPELINE_DEPTH));
     }
 
     void HapticAvatar_DriverBase::appendCmd(int cmd, const char* args)
     {
-        cmd_appended[cmd_appended_size++] = cmd;
-        cmd_appended_str += std::to_string(cmd) + " " + args;
+        if (m_binaryMode) {
+            if (args[0] != '\0') {
+                msg_error("HapticAvatar_DriverBase") << "Command " << cmd << " with preformatted arguments can't be sent in binary mode, dropped.";
+                return;
+            }
+            appendCmd(cmd, nullptr, 0);
+            return;
+        }
+
+        const int key = int(strtol(args, nullptr, 10));
+        if (!beginAppend(cmd, key))
+            return;
+
+        unsigned int mark = cmd_appended_encoder.mark();
+        if (!cmd_appended_encoder.putInt(cmd) || !cmd_appended_encoder.putBytes(args, (unsigned int)strlen(args))) {
+            cmd_appended_encoder.rollback(mark);
+            onCommandDropped(cmd);
+            return;
+        }
+        endAppend(cmd, key, mark);
+    }
+
+    bool HapticAvatar_DriverBase::appendCmd(int cmd, const int* args, int nbArgs)
+    {
+        if (sticky_modes[cmd] && !sticky_replaying)
+            recordSticky(cmd, nbArgs > 0 ? args[0] : 0, args, nbArgs, 0.0f);
+
+        return putAppendedCmd(cmd, args, nbArgs);
+    }
+
+    bool HapticAvatar_DriverBase::putAppendedCmd(int cmd, const int* args, int nbArgs)
+    {
+        const int key = nbArgs > 0 ? args[0] : 0;
+        if (!beginAppend(cmd, key))
+            return false;
+
+        unsigned int mark = cmd_appended_encoder.mark();
+        bool fit = putCommandId(cmd_appended_encoder, cmd, nbArgs, m_binaryMode);
+        for (int i = 0; i < nbArgs && fit; i++)
+            fit = m_binaryMode ? cmd_appended_encoder.putInt32(args[i]) : cmd_appended_encoder.putInt(args[i]);
+
+        if (!fit) {
+            cmd_appended_encoder.rollback(mark);
+            onCommandDropped(cmd);
+            return false;
+        }
+        endAppend(cmd, key, mark);
+        return true;
     }
 
-    void HapticAvatar_DriverBase::updateIfUnsubscribed(int cmd)
+    bool HapticAvatar_DriverBase::beginAppend(int cmd, int key)
     {
-        if (update_cmd_every_nth[cmd] == 0) {
-            appendCmd(cmd, "");
-            update(); // Read away any existing return data and request the data with cmd 
-            update(); // Read the data from this request. The data ends up in the results_table.
+        const CoalesceMode mode = coalesce_modes[cmd];
+        if (mode != CoalesceMode::None) {
+            for (int i = 0; i < cmd_appended_size; i++) {
+                const HapticAvatar_AppendedCmd& pending = cmd_appended[i];
+                if (pending.cmd != cmd || (mode == CoalesceMode::LatestPerIndex && pending.key != key))
+                    continue;
+
+                // Remove the older value. The new one goes at the end of the list, so it still overrides the related commands appended in between
+                // (e.g. a collision object position set after the object itself).
+                const unsigned int len = pending.end - pending.begin;
+                cmd_appended_encoder.erase(pending.begin, pending.end);
+                for (int j = i + 1; j < cmd_appended_size; j++) {
+                    cmd_appended[j - 1] = cmd_appended[j];
+                    cmd_appended[j - 1].begin -= len;
+                    cmd_appended[j - 1].end -= len;
+                }
+                cmd_appended_size--;
+                coalesced_cmd_counter++;
+                break;
+            }
+        }
+
+        if (cmd_appended_size >= MAX_APPENDED_CMDS) {
+            onCommandDropped(cmd);
+            return false;
+        }
+        return true;
+    }
+
+    void HapticAvatar_DriverBase::endAppend(int cmd, int key, unsigned int mark)
+    {
+        HapticAvatar_AppendedCmd& appended = cmd_appended[cmd_appended_size++];
+        appended.cmd = cmd;
+        appended.key = key;
+        appended.begin = mark;
+        appended.end = cmd_appended_encoder.size();
+    }
+
+    void HapticAvatar_DriverBase::recordSticky(int cmd, int key, const int* args, int nbArgs, float value)
+    {
+        const bool perIndex = (coalesce_modes[cmd] == CoalesceMode::LatestPerIndex);
+        HapticAvatar_StickyCmd* sticky = nullptr;
+        for (int i = 0; i < sticky_table_size; i++) {
+            if (sticky_table[i].cmd == cmd && (!perIndex || sticky_table[i].key == key)) {
+                sticky = &sticky_table[i];
+                break;
+            }
+        }
+
+        if (sticky == nullptr) {
+            if (sticky_table_size >= MAX_STICKY_CMDS) {
+                // Only warn once, like the dropped commands
+                if (dropped_sticky_counter++ == 0)
+                    msg_warning("HapticAvatar_DriverBase") << "More than " << MAX_STICKY_CMDS << " sticky values, command " << cmd << " will not be sent again after a reconnection.";
+                return;
+            }
+            sticky = &sticky_table[sticky_table_size++];
+            sticky->cmd = cmd;
+            sticky->key = key;
+        }
+
+        sticky->nbArgs = std::min(nbArgs, MAX_STICKY_ARGS);
+        for (int i = 0; i < sticky->nbArgs; i++)
+            sticky->args[i] = args[i];
+        sticky->value = value;
+        sticky->stamp = ++sticky_stamp;
+    }
+
+    void HapticAvatar_DriverBase::onCommandDropped(int cmd)
+    {
+        // Only warn once: this is called from the haptic thread and logging allocates.
+        if (dropped_cmd_counter++ == 0) {
+            msg_warning("HapticAvatar_DriverBase") << "Outgoing frame full (" << cmd_appended_encoder.capacity() << " bytes or " << MAX_APPENDED_CMDS << " commands), command " << cmd << " dropped. Further drops are only counted.";
+        }
+    }
+
+    void HapticAvatar_DriverBase::fetchIfUnsubscribed(int cmd)
+    {
+        // a low rate subscription may not have been answered yet
+        if (!subscription_scheduler.isSubscribed(cmd) || result_table.getGeneration(cmd) == 0) {
+            // The data ends up in the results_table
+            std::future<HapticAvatar_QueryResult> future = requestOnce(cmd);
+            waitQuery(future);
         }
     }
 
 
     std::string HapticAvatar_DriverBase::getDeviceType()
     {
-        // Use this command only when to determine which type of device you are communicating with.
-        char incoming_str[100];
-        sendCommandToDevice(1, "", incoming_str);  // GET_DEVICE_TYPE command is number 1 on all Haptic Avatar devices
-        return convertSingleData(incoming_str);
+        // GET_DEVICE_TYPE was answered at the connection, asking again would use the link behind the haptic thread
+        std::lock_guard<std::mutex> lock(m_deviceTypeMutex);
+        return m_deviceType;
     }
 
     void HapticAvatar_DriverBase::subscribeTo(int cmd, int every_nth)
     {
-        update_cmd_every_nth[cmd] = every_nth;
+        subscribeAtRate(cmd, every_nth > 0 ? subscription_scheduler.getTickRate() / float(every_nth) : 0.0f);
+    }
+
+    void HapticAvatar_DriverBase::subscribeAtRate(int cmd, float rateHz)
+    {
+        subscription_scheduler.subscribe(cmd, rateHz, estimateCommandBytes(cmd));
+    }
+
+    unsigned int HapticAvatar_DriverBase::estimateCommandBytes(int cmd) const
+    {
+        // request: id and separator, reply: about 7 characters per ASCII value (sign, digits of the scaled integer and separator)
+        if (m_binaryMode)
+            return 2 + 4 * num_return_vals[cmd];
+        return 3 + 7 * num_return_vals[cmd];
     }
 
     sofa::type::fixed_array<float, 6> HapticAvatar_DriverBase::getFloat6(int cmd)
     {
-        updateIfUnsubscribed(cmd);
+        fetchIfUnsubscribed(cmd);
         sofa::type::fixed_array<float, 6> results;
-        for (unsigned int i = 0; i < results.size(); i++) {
-            results[i] = result_table[cmd][i];
-        }
+        result_table.read(cmd, results.data(), 6);
         return results;
     }
 
     sofa::type::fixed_array<float, 4> HapticAvatar_DriverBase::getFloat4(int cmd)
     {
-        updateIfUnsubscribed(cmd);
+        fetchIfUnsubscribed(cmd);
         sofa::type::fixed_array<float, 4> results;
-        for (unsigned int i = 0; i < results.size(); i++) {
-            results[i] = result_table[cmd][i];
-        }
+        result_table.read(cmd, results.data(), 4);
         return results;
     }
 
     sofa::type::fixed_array<float, 3> HapticAvatar_DriverBase::getFloat3(int cmd)
     {
-        updateIfUnsubscribed(cmd);
+        fetchIfUnsubscribed(cmd);
         sofa::type::fixed_array<float, 3> results;
-        for (unsigned int i = 0; i < results.size(); i++) {
-            results[i] = result_table[cmd][i];
-        }
+        result_table.read(cmd, results.data(), 3);
         return results;
     }
 
     float HapticAvatar_DriverBase::getFloat(int cmd)
     {
-        updateIfUnsubscribed(cmd);
-        return result_table[cmd][0];
+        fetchIfUnsubscribed(cmd);
+        return result_table.get(cmd, 0);
     }
 
     float HapticAvatar_DriverBase::getFloat(int cmd, int channel)
     {
-        updateIfUnsubscribed(cmd);
+        fetchIfUnsubscribed(cmd);
         if (channel >= 0 && channel < RESULT_SIZEY)
-            return result_table[cmd][channel];
+            return result_table.get(cmd, channel);
         else
             return 0;
     }
@@ -427,33 +1538,37 @@ namespace sofa::HapticAvatar
 
     int HapticAvatar_DriverBase::getInt(int cmd)
     {
-        updateIfUnsubscribed(cmd);
-        return (int)result_table[cmd][0];
+        fetchIfUnsubscribed(cmd);
+        return (int)result_table.get(cmd, 0);
     }
     int HapticAvatar_DriverBase::getInt(int cmd, int channel)
     {
-        updateIfUnsubscribed(cmd);
+        fetchIfUnsubscribed(cmd);
         if (channel >= 0 && channel < RESULT_SIZEY)
-            return (int)result_table[cmd][channel];
+            return (int)result_table.get(cmd, channel);
         else
             return 0;
     }
 
    sofa::type::fixed_array<int, 4> HapticAvatar_DriverBase::getInt4(int cmd)
     {
-        updateIfUnsubscribed(cmd);
+        fetchIfUnsubscribed(cmd);
+        float values[4];
+        result_table.read(cmd, values, 4);
         sofa::type::fixed_array<int, 4> results;
         for (unsigned int i = 0; i < results.size(); i++) {
-            results[i] = (int)result_table[cmd][i];
+            results[i] = (int)values[i];
         }
         return results;
     }
     sofa::type::fixed_array<int, 6> HapticAvatar_DriverBase::getInt6(int cmd)
     {
-        updateIfUnsubscribed(cmd);
+        fetchIfUnsubscribed(cmd);
+        float values[6];
+        result_table.read(cmd, values, 6);
         sofa::type::fixed_array<int, 6> results;
         for (unsigned int i = 0; i < results.size(); i++) {
-            results[i] = (int)result_table[cmd][i];
+            results[i] = (int)values[i];
         }
         return results;
     }
@@ -461,81 +1576,77 @@ namespace sofa::HapticAvatar
 
     void HapticAvatar_DriverBase::appendIntFloat(int cmd, int chan, float value)
     {
-        std::string arguments;
-        arguments = std::to_string(chan) + " " + 
-            std::to_string(int(value * scale_factor[cmd])) + " ";
-        appendCmd(cmd, arguments.c_str());
+        const int args[2] = { chan, scaleToInt(cmd, value) };
+        appendCmd(cmd, args, 2);
     }
     void HapticAvatar_DriverBase::appendIntFloat(int cmd, int chan, float value1, float value2)
     {
-        std::string arguments;
-        arguments = std::to_string(chan) + " " + 
-            std::to_string(int(value1 * scale_factor[cmd])) + " " + 
-            std::to_string(int(value2 * scale_factor[cmd])) + " ";
-        appendCmd(cmd, arguments.c_str());
+        const int args[3] = { chan, scaleToInt(cmd, value1), scaleToInt(cmd, value2) };
+        appendCmd(cmd, args, 3);
     }
     void HapticAvatar_DriverBase::appendIntFloat(int cmd, int value, sofa::type::fixed_array<float, 3> values)
     {
-        std::string arguments;
-        arguments = std::to_string(value) + " " +
-            std::to_string(int(values[0] * scale_factor[cmd])) + " " +
-            std::to_string(int(values[1] * scale_factor[cmd])) + " " +
-            std::to_string(int(values[2] * scale_factor[cmd])) + " ";
-        appendCmd(cmd, arguments.c_str());
+        const int args[4] = { value, scaleToInt(cmd, values[0]), scaleToInt(cmd, values[1]), scaleToInt(cmd, values[2]) };
+        appendCmd(cmd, args, 4);
     }
 
     void HapticAvatar_DriverBase::appendInt(int cmd, int value)
     {
-        std::string arguments;
-        arguments = std::to_string(value) + " ";
-        appendCmd(cmd, arguments.c_str());
+        appendCmd(cmd, &value, 1);
     }
 
     void HapticAvatar_DriverBase::appendInt(int cmd, int value1, int value2)
     {
-        std::string arguments;
-        arguments = std::to_string(value1) + " " +
-            std::to_string(value2) + " ";
-        appendCmd(cmd, arguments.c_str());
+        const int args[2] = { value1, value2 };
+        appendCmd(cmd, args, 2);
     }
 
     void HapticAvatar_DriverBase::appendFloat(int cmd, float value)
     {
-        std::string arguments;
-        arguments = std::to_string(value) + " ";
-        appendCmd(cmd, arguments.c_str());
+        // kept as a float whatever the framing: the replay after a reconnection starts in ASCII, where it is sent unscaled
+        if (sticky_modes[cmd] && !sticky_replaying)
+            recordSticky(cmd, 0, nullptr, -1, value);
+
+        if (m_binaryMode) {
+            // binary frames only carry integers: scaled like the other commands
+            const int arg = scaleToInt(cmd, value);
+            putAppendedCmd(cmd, &arg, 1);
+            return;
+        }
+
+        // This one is sent unscaled, with 6 decimals
+        if (!beginAppend(cmd, 0))
+            return;
+
+        unsigned int mark = cmd_appended_encoder.mark();
+        if (!cmd_appended_encoder.putInt(cmd) || !cmd_appended_encoder.putFloat(value)) {
+            cmd_appended_encoder.rollback(mark);
+            onCommandDropped(cmd);
+            return;
+        }
+        endAppend(cmd, 0, mark);
     }
     void HapticAvatar_DriverBase::appendFloat(int cmd, sofa::type::fixed_array<float, 4> values)
     {
-        std::string arguments;
+        int args[4];
         for (unsigned int i = 0; i < values.size(); i++)
-        {
-            int value = int(values[i] * scale_factor[cmd]);
-            arguments += std::to_string(value) + " ";
-        }
+            args[i] = scaleToInt(cmd, values[i]);
 
-        appendCmd(cmd, arguments.c_str());
+        appendCmd(cmd, args, 4);
     }
     void HapticAvatar_DriverBase::appendFloat(int cmd, float f1, float f2, float f3, float f4)
     {
-        std::string arguments;
-        arguments = std::to_string(int(f1 * scale_factor[cmd])) + " " +
-            std::to_string(int(f2 * scale_factor[cmd])) + " " +
-            std::to_string(int(f3 * scale_factor[cmd])) + " " +
-            std::to_string(int(f4 * scale_factor[cmd])) + " ";
-        appendCmd(cmd, arguments.c_str());
+        const int args[4] = { scaleToInt(cmd, f1), scaleToInt(cmd, f2), scaleToInt(cmd, f3), scaleToInt(cmd, f4) };
+        appendCmd(cmd, args, 4);
     }
 
     void HapticAvatar_DriverBase::appendFloat(int cmd, sofa::type::fixed_array<float, 6> values)
     {
-        std::string arguments;
+        int args[6];
         for (unsigned int i = 0; i < values.size(); i++)
-        {
-            int value = int(values[i] * scale_factor[cmd]);
-            arguments += std::to_string(value) + " ";
-        }
+            args[i] = scaleToInt(cmd, values[i]);
 
-        appendCmd(cmd, arguments.c_str());
+        appendCmd(cmd, args, 6);
     }
 
 }
\ No newline at end of file
@@ -23,8 +23,22 @@
 
 #include <SofaHapticAvatar/config.h>
 //#include <SofaHapticAvatar/HapticAvatar_Defines.h>
+#include <SofaHapticAvatar/HapticAvatar_CommandEncoder.h>
+#include <SofaHapticAvatar/HapticAvatar_LatencyHistogram.h>
+#include <SofaHapticAvatar/HapticAvatar_LinkClock.h>
+#include <SofaHapticAvatar/HapticAvatar_ResponseParser.h>
+#include <SofaHapticAvatar/HapticAvatar_ResultTable.h>
+#include <SofaHapticAvatar/HapticAvatar_SubscriptionScheduler.h>
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
 #include <sofa/type/Vec.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace sofa::HapticAvatar
 {
@@ -32,9 +46,93 @@ namespace sofa::HapticAvatar
 #define OUTGOING_DATA_LEN 1024
 #define INCOMING_DATA_LEN 1024
 #define NBJOINT 6
-#define ARDUINO_WAIT_TIME 2000
-#define RESULT_SIZEX  52
-#define RESULT_SIZEY  12
+#define RECEIVE_TIMEOUT_US 1000 // processing time of the device included in the automatic receive timeout, and the whole timeout of a link without baud rate
+#define RECEIVE_TIMEOUT_RTT_FACTOR 2 // the automatic receive timeout is at least this multiple of the fastest recent round trip
+#define REPLY_ASCII_BYTES_PER_VALUE 12 // size of a value in an ASCII reply assumed by the automatic receive timeout: sign, digits, decimals and separator
+#define COMMAND_TIMEOUT_US 100000 // max wait for the reply to a single command sent with sendCommandToDevice
+#define RECEIVE_RESYNC_TIMEOUTS 100 // number of consecutive missed replies after which the link is flushed to resynchronise
+#define MAX_PIPELINE_DEPTH 8 // max number of command batches waiting for their reply
+#define MAX_BATCH_CMDS 1000
+#define MAX_APPENDED_CMDS 256 // max number of appended commands waiting for the next frame
+#define MAX_EXTRAPOLATION_US 10000 // values are never extrapolated further than this from their sample time
+#define DEVICE_READY_TIMEOUT_MS 5000 // max time for a device to answer GET_DEVICE_TYPE after the link is opened, including the board reset
+#define DEVICE_READY_POLL_US 100000 // period of the GET_DEVICE_TYPE probes while waiting for the device
+#define IO_THREAD_POLL_US 1000 // max time the I/O thread waits for bytes before checking if it must stop
+#define IO_THREAD_FULL_RING_SLEEP_US 50 // the ring is full: the haptic thread is late, leave the bytes in the link for a while
+#define LINK_LOST_RESYNCS 2 // number of resynchronisations in a row without any reply after which the link is considered lost
+#define RECONNECT_RETRY_MS 250 // pause after the first failed attempt to reopen a lost link, doubled at each new failure
+#define RECONNECT_MAX_RETRY_MS 4000 // max pause between two attempts to reopen a lost link
+#define MAX_STICKY_CMDS 1024 // max number of sticky SET values remembered to be sent again after a reconnection
+#define MAX_STICKY_ARGS 19 // longest sticky SET command: the collision object of the Port
+#define MAX_PENDING_QUERIES 32 // max number of one-shot queries waiting to be sent or answered, see @sa HapticAvatar_DriverBase::requestOnce
+#define MAX_QUERY_ARGS 4 // max number of arguments of a one-shot query
+#define QUERY_TIMEOUT_MS 100 // max time a getter waits for the reply to a command not subscribed to
+
+    /**
+    * Snapshot of a command batch sent to the device by @sa HapticAvatar_DriverBase::update, kept until its reply is parsed.
+    * The device replies to the batches in the order they were sent, so a batch is matched to its reply by its position in the queue.
+    */
+    struct HapticAvatar_SentBatch
+    {
+        unsigned int seq = 0; // host side sequence number of the batch
+        int cmd_send_list[MAX_BATCH_CMDS]; // the list of all commands sent in this batch
+        int cmd_send_list_size = 0;
+        int expected_num_return_vals = 0;
+        int64_t send_time_ns = 0; // host time when the batch was written
+        unsigned int send_size = 0; // number of bytes written
+    };
+
+    /// Command appended by the simulation and waiting for the next frame, see @sa HapticAvatar_DriverBase::appendCmd
+    struct HapticAvatar_AppendedCmd
+    {
+        int cmd = 0;
+        int key = 0; // first argument, the channel or object index of the indexed SET commands
+        unsigned int begin = 0; // position of the formatted command in the appended data
+        unsigned int end = 0;
+    };
+
+    /// Latest value of a sticky SET command, sent again to the device after a reconnection. See @sa HapticAvatar_DriverBase::setStickyCommand
+    struct HapticAvatar_StickyCmd
+    {
+        int cmd = 0;
+        int key = 0; // first argument, compared for the commands coalesced per index
+        int nbArgs = 0; // -1 for a single float sent unscaled in ASCII, see @sa HapticAvatar_DriverBase::appendFloat
+        int args[MAX_STICKY_ARGS];
+        float value = 0.0f;
+        unsigned int stamp = 0; // order of the latest append, the values are sent again in this order
+    };
+
+    /// Reply to a one-shot query, see @sa HapticAvatar_DriverBase::requestOnce
+    struct HapticAvatar_QueryResult
+    {
+        int cmd = 0;
+        int nbValues = 0; // number of values in the reply, 0 if the query could not be sent
+        float values[RESULT_SIZEY] = { 0.0f }; // already scaled, as in the result table
+        int64_t sampleTimeNs = 0; // host time at which the device sampled the values
+    };
+
+    /// One-shot query waiting for the next frame or for its reply. Claimed by any thread, sent and answered by the thread running @sa HapticAvatar_DriverBase::update
+    struct HapticAvatar_PendingQuery
+    {
+        enum State { Free, Claimed, Queued, Sent };
+        std::atomic<int> state = Free;
+        int cmd = 0;
+        int args[MAX_QUERY_ARGS];
+        int nbArgs = 0;
+        unsigned int seq = 0; // batch in which the query was sent
+        std::promise<HapticAvatar_QueryResult> promise;
+    };
+
+    /// Result of a link self-test: GET_DEVICE_TYPE round trips at a given baud rate
+    struct HapticAvatar_LinkStats
+    {
+        int baudRate = 0;
+        int nbRoundTrips = 0;
+        int nbFailures = 0; // no reply in time or unexpected reply
+        float meanRoundTripUs = 0.0f;
+        float maxRoundTripUs = 0.0f;
+        float bytesPerSecond = 0.0f; // bytes sent and received during the test
+    };
 
     /**
     * HapticAvatar driver
@@ -42,11 +140,62 @@ namespace sofa::HapticAvatar
     class SOFA_HAPTICAVATAR_API HapticAvatar_DriverBase
     {
     public:
-        HapticAvatar_DriverBase(const std::string& portName);
+        /// How the driver waits for the replies of the device
+        enum class ReceiveMode
+        {
+            Polling,  ///< Spin on non-blocking reads, up to 10k iterations
+            Blocking  ///< Sleep until bytes are received or the receive timeout expires
+        };
+
+        /// How repeated appends of a command are merged while waiting for the next frame. Last writer wins: only the newest value is sent
+        enum class CoalesceMode
+        {
+            None,          ///< Every append is sent, for commands with side effects (reset, zeroing, ...)
+            Latest,        ///< Only the newest append of the command is sent
+            LatestPerIndex ///< Only the newest append for each value of the first argument (channel, object index) is sent
+        };
+
+        /// State of the link to the device, see @sa getLinkState
+        enum class LinkState
+        {
+            Disconnected, ///< Not connected yet, the connection failed, or the link was lost with autoReconnect off
+            Connected,    ///< The device answers, @sa update exchanges the command batches
+            Reconnecting, ///< The link was lost: a background thread reopens it. @sa update sends nothing meanwhile
+            Restoring     ///< The link is back: @sa update sends the sticky values again and waits for the first reply of the device
+        };
+
+        /** Create the driver. The device is connected by @sa connect or @sa connectAsync.
+        * @param {string} portName: name of the port (ex: COM3, /dev/ttyACM0) or loopback channel / socket path depending on the transport.
+        * @param {string} transportType: link to use, see @sa HapticAvatar_Transport::create
+        * @param {HapticAvatar_LinkSettings} linkSettings: baud rate, flow control and DTR reset of a serial link.
+        */
+        HapticAvatar_DriverBase(const std::string& portName, const std::string& transportType = "serial", const HapticAvatar_LinkSettings& linkSettings = HapticAvatar_LinkSettings());
 
         virtual ~HapticAvatar_DriverBase();
 
-        bool IsConnected() { return m_connected; }
+        /** Connect to the device and wait until it answers. The board reset by DTR takes about 2s to boot.
+        * @returns {bool} true if the device is connected.
+        */
+        bool connect();
+
+        /** Start the connection in a background thread, so that several devices can boot at the same time.
+        * The driver must not be used before @sa waitConnected returns.
+        */
+        void connectAsync();
+
+        /** Wait for the end of a connection started with @sa connectAsync.
+        * @returns {bool} true if the device is connected.
+        */
+        bool waitConnected();
+
+        /// True if the device answers. False while the link is lost and being reopened, see @sa getLinkState
+        bool IsConnected() { return m_linkState == LinkState::Connected; }
+
+        /// State of the link, can be read from any thread.
+        LinkState getLinkState() const { return m_linkState; }
+
+        /// Number of times the link was lost and reopened since the driver creation. Can be read from any thread.
+        unsigned int getReconnectCounter() const { return m_reconnectCounter; }
 
         std::string getPortName() { return m_portName; }
 
@@ -61,11 +210,13 @@ namespace sofa::HapticAvatar
         virtual int getSerialNumber() = 0;
 
         /** Get the device type. This is the same command to all device in the Haptic Avatar family.
-        * @returns {string} e.g. "HapticDevice", "InstrumentBox", "Scope".
+        * It is read when the device answers at the connection, calling this method doesn't use the link.
+        * @returns {string} e.g. "HapticDevice", "InstrumentBox", "Scope". Empty if the device never answered.
         */
         std::string getDeviceType();
 
         /** Generic method which will format the command and send it to the device using HapticAvatar::Cmd and list of arguments given as input. Result will be stored in input char* result if not null.
+        * Writes and reads the link directly: must not be called while another thread runs @sa update, use @sa requestOnce instead.
         * @param {HapticAvatar::Cmd} command: the command enum to be sent.
         * @param {string} arguments: already formatted list of arguments to be sent with the command.
         * @param {char *} result: if not null, response will be asked to device and stored in this char*.
@@ -73,19 +224,233 @@ namespace sofa::HapticAvatar
         */
         bool sendCommandToDevice(int commandId, const std::string& arguments, char* result);
 
-        /// Read data from device and send new commands to device
+        /** Read data from device and send new commands to device. The calling thread, e.g. the haptic thread, drives the driver from now on:
+        * the other threads waiting for a query only wait for it to send the query, see @sa waitQuery. Skipped if another thread is updating the driver.
+        */
         void update();
 
+        /// Tell that the thread which called @sa update doesn't drive the driver anymore, e.g. when the haptic thread stops.
+        void releaseUpdates() { m_updateOwner.store(std::thread::id(), std::memory_order_relaxed); }
+
+        /** Ask the device for the values of a GET command once, without subscribing to it. Never blocks, can be called from any thread.
+        * The query is added to the next frame sent by @sa update, and the future is ready once its reply is parsed. The values are also written in the result table.
+        * A query whose reply is lost is sent again, also after a reconnection.
+        * @param {int} cmd: command id, must have return values.
+        * @param {int *} args: arguments of the command, e.g. the mode of RESET. Can be null if nbArgs is 0.
+        * @param {int} nbArgs: number of arguments, at most MAX_QUERY_ARGS.
+        * @returns {future<HapticAvatar_QueryResult>} ready at once without values if the command has no reply or MAX_PENDING_QUERIES queries are already pending.
+        */
+        std::future<HapticAvatar_QueryResult> requestOnce(int cmd, const int* args = nullptr, int nbArgs = 0);
+
         virtual void printStatus() = 0;
+
+        void setReceiveMode(ReceiveMode mode) { m_receiveMode = mode; }
+        ReceiveMode getReceiveMode() const { return m_receiveMode; }
+
+        /** Set the max time @sa update waits for the reply to the previous command batch, in blocking receive mode.
+        * A batch not answered in time is dropped: its late reply is skipped, for at most one more timeout, and its values are lost.
+        * Automatic by default: the transfer time of the request and of the reply at the baud rate plus RECEIVE_TIMEOUT_US,
+        * and at least RECEIVE_TIMEOUT_RTT_FACTOR times the fastest recent round trip.
+        * @param {int} timeoutUs: timeout in microseconds, 0 for automatic.
+        */
+        void setReceiveTimeout(int timeoutUs) { m_receiveTimeoutUs = timeoutUs; }
+        int getReceiveTimeout() const { return m_receiveTimeoutUs; }
+
+        /// Number of replies not received in time since the driver creation. Can be read from any thread.
+        unsigned int getReceiveTimeoutCounter() const { return m_receiveTimeoutCounter; }
+
+        /** Set the number of command batches that can be sent before the reply to the first one is received.
+        * With 1, @sa update waits for the reply to the previous batch before sending the next one, so the loop rate is bound by the round trip.
+        * With K > 1, update only waits when K batches are in flight and the data read is up to K-1 updates old.
+        * The device input buffer must be able to hold K batches.
+        * @param {int} depth: between 1 and MAX_PIPELINE_DEPTH.
+        */
+        void setPipelineDepth(int depth);
+        int getPipelineDepth() const { return m_pipelineDepth; }
+
+        /// True if the command batches are sent as binary frames, false for ASCII lines. See @sa HapticAvatar_BinaryProtocol.h
+        bool isBinaryMode() const { return m_binaryMode; }
+
+        /// True if a dedicated thread reads the link, see @sa HapticAvatar_LinkSettings::ioThread
+        bool hasIoThread() const { return m_ioRunning; }
+
+        /// Current baud rate of the link, 0 if the link has no baud rate.
+        int getBaudRate() const;
+
+        /** Measure the link by sending GET_DEVICE_TYPE commands one after the other. Must not be called while @sa update is running.
+        * @param {int} nbRoundTrips: number of commands to send.
+        * @param {string} expectedReply: device type the replies must match, if not empty. Otherwise any printable reply is accepted.
+        * @returns {HapticAvatar_LinkStats} round trip times and throughput at the current baud rate.
+        */
+        HapticAvatar_LinkStats runLinkSelfTest(int nbRoundTrips, const std::string& expectedReply = "");
+
+        /** Find the highest baud rate at which the device answers GET_DEVICE_TYPE reliably. Rates are tried from the first to the last one,
+        * stopping at the first one where all the probes succeed. If none works, the previous rate is restored. Must not be called while @sa update is running.
+        * @param {vector<int>} baudRates: candidate rates, highest first.
+        * @param {int} nbProbes: number of round trips which must all succeed at a rate.
+        * @param {string} expectedReply: see @sa runLinkSelfTest
+        * @param {vector<HapticAvatar_LinkStats>} report: if not null, filled with the self-test of each rate tried.
+        * @returns {int} the selected baud rate, 0 if the link has no baud rate or no rate worked.
+        */
+        int negotiateBaudRate(const std::vector<int>& baudRates, int nbProbes, const std::string& expectedReply, std::vector<HapticAvatar_LinkStats>* report = nullptr);
+
+        /// Set the rate at which @sa update is called, in Hz. Used to convert the subscription rates into ticks.
+        void setTickRate(float tickRateHz) { subscription_scheduler.setTickRate(tickRateHz); }
+
+        /** Set the max number of bytes per frame used by the subscriptions below the tick rate. See @sa HapticAvatar_SubscriptionScheduler::setByteBudget
+        * @param {uint} budget: in bytes, 0 to send a single low rate subscription per frame.
+        */
+        void setFrameByteBudget(unsigned int budget) { subscription_scheduler.setByteBudget(budget); }
+
+        /// Sequence number of the last batch sent, and of the last batch whose reply was parsed into the result table.
+        unsigned int getSentSeq() const { return m_batchSeq; }
+        unsigned int getLastReceivedSeq() const { return m_lastReceivedSeq; }
+
+        /// Number of replies received for a command, to know if its values changed since the last read. Can be called from any thread.
+        unsigned int getResultGeneration(int cmd) const { return result_table.getGeneration(cmd); }
+
+        /// Latest value of a command in the result table, without ever querying the device: 0 until its first reply. Can be called from any thread, see @sa getResultGeneration
+        float getLatestFloat(int cmd, int channel) const { return (channel >= 0 && channel < RESULT_SIZEY) ? result_table.get(cmd, channel) : 0; }
+
+        /// Host time at which the device sampled the latest values of a command, estimated by @sa getLinkClock. Can be called from any thread.
+        std::chrono::steady_clock::time_point getSampleTime(int cmd) const;
+
+        /// Latency and jitter of the link, measured on the command batches sent by @sa update
+        const HapticAvatar_LinkClock& getLinkClock() const { return link_clock; }
+
+        /// Round trip of a command in microseconds, from the write of its batch to the parsing of the reply. Can be read from any thread.
+        const HapticAvatar_LatencyHistogram& getCommandLatency(int cmd) const { return command_latency[cmd]; }
+
+        /// Round trip of the command batches sent by @sa update, in microseconds. Can be read from any thread.
+        const HapticAvatar_LatencyHistogram& getBatchLatency() const { return batch_latency; }
+
+        /// Number of bytes written to and received from the link at each @sa update. Can be read from any thread.
+        ///{
+        const HapticAvatar_LatencyHistogram& getBytesSentPerTick() const { return bytes_sent_per_tick; }
+        const HapticAvatar_LatencyHistogram& getBytesReceivedPerTick() const { return bytes_received_per_tick; }
+        ///}
+
+        /// Current host time in ns, the clock of the sample times.
+        static int64_t hostTimeNs();
+
+        /// Protocol tables of the device commands, also used by the device simulators
+        ///{
+        int getNumCommands() const { return device_num_cmds; }
+        int getNumReturnValues(int cmd) const { return num_return_vals[cmd]; }
+        float getScaleFactor(int cmd) const { return scale_factor[cmd]; }
+        int getDeviceTypeId() const { return device_type; }
+        ///}
   
 
     protected:
         /// Internal method to connect to device
         void connectDevice();
 
+        /** Internal method to set up an opened link: wait for the device, negotiate the framing and start the I/O thread.
+        * Used by @sa connectDevice and @sa reconnectDevice.
+        * @returns {bool} false if the device doesn't answer.
+        */
+        bool startLink();
+
+        /** Internal method called by the haptic thread when a read or a write failed, or the device stopped answering.
+        * The link is handed to @sa reconnectDevice in a background thread, or given up if autoReconnect is off. Never blocks.
+        */
+        void onLinkLost();
+
+        /// Internal method run by the reconnection thread: reopens the link until the device answers again or the driver is destroyed.
+        void reconnectDevice();
+
+        /// Internal method run by the haptic thread once the link is back: restarts the command pipeline and queues the sticky values.
+        void resumeLink();
+
+        /// Internal method to append the sticky values not sent again yet since the reconnection, as many as fit in the next frame.
+        void continueStickyReplay();
+
+        /** Internal method to wait until the device has booted, by sending GET_DEVICE_TYPE every DEVICE_READY_POLL_US
+        * until it answers a printable line or DEVICE_READY_TIMEOUT_MS expires.
+        * @returns {bool} true if the device answered.
+        */
+        bool waitDeviceReady();
+
+        /** Internal method to switch to the binary framing if the device supports it. A GET_DEVICE_TYPE command is sent in a binary frame:
+        * a device supporting the binary framing answers with a binary frame, an older firmware doesn't and the ASCII lines are kept.
+        * ASCII commands (@sa sendCommandToDevice) can still be sent in binary mode, the device recognises the frame format by its first byte.
+        * @returns {bool} true if the binary framing is used.
+        */
+        bool negotiateBinaryMode();
+
+        /// Start an outgoing frame: nothing in ASCII mode, the sync byte and the length placeholder in binary mode.
+        static bool startFrame(HapticAvatar_CommandEncoder& encoder, bool binary);
+        /// Terminate a frame started with @sa startFrame: " \n" in ASCII mode, payload length and CRC in binary mode. Both need 2 bytes.
+        static bool endFrame(HapticAvatar_CommandEncoder& encoder, bool binary);
+        /// Write a command id, followed by its number of arguments in binary mode.
+        static bool putCommandId(HapticAvatar_CommandEncoder& encoder, int cmd, int nbArgs, bool binary);
+
+        /** Internal method to parse the replies of the batches in flight, oldest first. Only waits for the oldest reply when the pipeline is full,
+        * until the receive timeout expires. A batch whose reply doesn't come in time is dropped, see @sa drainLateReplies
+        */
         void updateReceive();
 
-        /** Internal method to get response from the device. Will be looping while calling @sa ReadDataImplLooping with a security of 10k loop.
+        /** Internal method to drop all the batches in flight once the oldest one timed out, and to skip their late replies before the next send.
+        * Waits for the replies for at most one more receive timeout: a reply that never comes, e.g. to a corrupted request, is then forgotten
+        * instead of making the parser skip the reply of a later batch.
+        */
+        void drainLateReplies();
+
+        /// Internal method to get the receive timeout of a batch in microseconds, see @sa setReceiveTimeout
+        int getBatchTimeoutUs(const HapticAvatar_SentBatch& batch) const;
+
+        /** Internal method to read bytes into @sa incoming_ring until @sa response_parser has a complete frame, or has skipped the late replies.
+        * @param {bool} wait: if false, only parse the bytes already received. Otherwise, in blocking mode, waits on the transport until the deadline.
+        * In polling mode, loops on @sa readDataImpl with a security of 10k loop. With the I/O thread, only waits for it to fill the ring.
+        * @returns {Status} NeedMoreData if the frame is not complete yet.
+        */
+        HapticAvatar_ResponseParser::Status receiveFrame(bool wait, std::chrono::steady_clock::time_point deadline);
+
+        /** Internal method to add the queued one-shot queries to the frame being built, as long as they fit. See @sa requestOnce
+        * @param {uint} reservedSize: bytes to keep free at the end of the frame.
+        */
+        void appendQueries(HapticAvatar_SentBatch& batch, unsigned int reservedSize);
+        /// Give the reply of a batch to the queries sent in it.
+        void completeQueries(const HapticAvatar_SentBatch& batch);
+        /// Queue again the queries sent in a batch whose reply was lost, or in all the batches if seq is 0.
+        void requeueQueries(unsigned int seq);
+        /// Answer all the pending queries without values, when the driver is destroyed.
+        void cancelQueries();
+        /** Wait until a query is answered, without blocking the haptic thread: if another thread drives the driver, see @sa update, only waits for it.
+        * Otherwise, e.g. during the initialisation or if called by the haptic thread itself, updates the driver until the reply is parsed.
+        * @returns {bool} false if the reply didn't come within QUERY_TIMEOUT_MS or the link is down.
+        */
+        bool waitQuery(std::future<HapticAvatar_QueryResult>& future);
+
+        /** Internal method to exchange with the device once, see @sa update. Only one thread at a time: the exchange is skipped if another one is running.
+        * @returns {bool} false if skipped.
+        */
+        bool tryUpdate();
+        /// Internal method to receive the replies of the previous batches and send the next one, called by @sa tryUpdate
+        void updateExchange();
+
+        /// Record the round trip of a batch whose reply is complete, and of each command it contains.
+        void recordLatency(const HapticAvatar_SentBatch& batch, int64_t receiveTimeNs);
+
+        /// Remove the oldest batch in flight.
+        void popBatch();
+
+        /** Internal method to wait until the I/O thread adds bytes to @sa incoming_ring. Sleeps in blocking receive mode, spins in polling mode.
+        * @param {uint} knownSize: number of bytes in the ring already seen by the caller.
+        * @returns {bool} false if no new byte was received before the deadline.
+        */
+        bool waitIoBytes(unsigned int knownSize, std::chrono::steady_clock::time_point deadline);
+
+        /// Start and stop the thread draining the link into @sa incoming_ring
+        ///{
+        void startIoThread();
+        void stopIoThread();
+        void ioLoop();
+        ///}
+
+        /** Internal method to get response from the device. In blocking mode, waits until a full line is received or COMMAND_TIMEOUT_US expires.
+        * In polling mode, loops on @sa readDataImpl with a security of 10k loop. With the I/O thread, takes the next line of @sa incoming_ring.
         * @param {char *} buffer: array to store the response.
         * @param {bool} do_flush: to flush after getting response.
         */
@@ -95,7 +460,7 @@ namespace sofa::HapticAvatar
         * @param {char *} buffer: array to store the response.
         * @param {uint} nbChar: size of the command array
         * @param {int *} queue: queue size to be read.
-        * @param {bool} do_flush: to flush after getting response.
+        * @param {bool} do_flush: kept for compatibility, the queued bytes are always read up to nbChar.
         */
         int readDataImpl(char* buffer, unsigned int nbChar, int* queue, bool do_flush);
 
@@ -113,25 +478,98 @@ namespace sofa::HapticAvatar
         int device_num_cmds = 0;  // must be set
         int num_return_vals[RESULT_SIZEX] = { 0 }; // Shall be initialized with the number of return values from each request command
         float scale_factor[RESULT_SIZEX] = { 1.0f }; // Data from devices are sent as integers. This array shall be initialized with the convertion factors back to float.
-        float result_table[RESULT_SIZEX][RESULT_SIZEY]; // A table that contains the latest data from a device.
-        int update_cmd_every_nth[RESULT_SIZEX] = { 0 };
+        HapticAvatar_ResultTable result_table; // A table that contains the latest data from a device, readable from any thread.
+        HapticAvatar_LinkClock link_clock; // Estimates when the device sampled the values of a reply
+        int delta_t_cmd = -1; // Id of GET_CURRENT_DELTA_T, the device loop period, used by link_clock. Set by the drivers
+        HapticAvatar_LatencyHistogram command_latency[RESULT_SIZEX]; // Round trip of each command, see @sa getCommandLatency
+        unsigned int command_latency_seq[RESULT_SIZEX] = { 0 }; // Last batch in which the round trip of each command was recorded: a command sent several times in a batch is counted once
+        HapticAvatar_LatencyHistogram batch_latency; // Round trip of the batches, see @sa getBatchLatency
+        HapticAvatar_LatencyHistogram bytes_sent_per_tick;
+        HapticAvatar_LatencyHistogram bytes_received_per_tick;
+        uint64_t bytes_received_at_tick = 0; // Value of m_bytesReceived at the previous update
+        HapticAvatar_SubscriptionScheduler subscription_scheduler; // Chooses the subscribed commands sent in each frame
+        int scheduled_cmds[SCHEDULER_MAX_CMDS];
         
-        char incomingData[INCOMING_DATA_LEN];
+        HapticAvatar_RingBuffer incoming_ring; // Bytes received from the device and not parsed yet. The link is read directly into it, by the haptic thread or the I/O thread
+        HapticAvatar_ResponseParser response_parser;
 
-        int cmd_appended[1000];  // A list of commands that is appended based on events in the simulation, such as forces, turning force feedback on/off etc.
+        HapticAvatar_AppendedCmd cmd_appended[MAX_APPENDED_CMDS];  // A list of commands that is appended based on events in the simulation, such as forces, turning force feedback on/off etc.
         int cmd_appended_size = 0;
+        CoalesceMode coalesce_modes[RESULT_SIZEX] = {}; // How repeated appends of each command are merged, all None by default
         int cmd_appended_num_return_vals = 0;
-        std::string cmd_appended_str; 
-
-        int cmd_send_list[1000];  // the list of all commands to be sent
-        int cmd_send_list_size = 0;
-        int expected_num_return_vals = 0;
+        char cmd_appended_data[OUTGOING_DATA_LEN]; // The appended commands and their arguments, already formatted
+        HapticAvatar_CommandEncoder cmd_appended_encoder;
+
+        char outgoingData[OUTGOING_DATA_LEN]; // Preallocated frame sent to the device by update()
+        HapticAvatar_CommandEncoder send_encoder;
+        unsigned int dropped_cmd_counter = 0; // Number of appended commands dropped because the outgoing frame was full
+        unsigned int coalesced_cmd_counter = 0; // Number of appended commands replaced by a newer value before being sent
+
+        bool sticky_modes[RESULT_SIZEX] = {}; // SET commands sent again after a reconnection, all false by default
+        HapticAvatar_StickyCmd sticky_table[MAX_STICKY_CMDS]; // Latest value of each sticky command
+        int sticky_table_size = 0;
+        unsigned int sticky_stamp = 0; // Number of sticky appends, orders the values of sticky_table
+        int sticky_replay_order[MAX_STICKY_CMDS]; // Values to send again after a reconnection, oldest first
+        int sticky_replay_size = 0;
+        int sticky_replay_pos = 0;
+        unsigned int sticky_replay_stamp = 0; // Values appended after this stamp were already sent since the reconnection
+        bool sticky_catch_up = false; // true in the second pass, which sends again the values appended during the first one
+        bool sticky_replaying = false; // true while the sticky values are appended, they must not be recorded again
+        unsigned int dropped_sticky_counter = 0; // Number of sticky values not remembered because sticky_table was full
+
+        HapticAvatar_PendingQuery pending_queries[MAX_PENDING_QUERIES]; // One-shot queries, see @sa requestOnce
+
+        HapticAvatar_SentBatch sent_batches[MAX_PIPELINE_DEPTH]; // Batches waiting for their reply, oldest at batch_head
+        int batch_head = 0;
+        int batch_count = 0;
+        bool batch_head_started = false; // true if response_parser is already parsing the reply of the oldest batch
         int send_counter = 0; // 
 
+        /// Subscribe to a GET command every every_nth tick, 0 to unsubscribe. Kept for compatibility, see @sa subscribeAtRate
         void subscribeTo(int cmd, int every_nth);
-        void parseMessage();
+        /** Subscribe to a GET command without arguments, its reply will be in the result table.
+        * @param {int} cmd: command id.
+        * @param {float} rateHz: target rate, 0 to unsubscribe. At or above the tick rate, the command is sent in every frame.
+        */
+        void subscribeAtRate(int cmd, float rateHz);
+        /// Approximate number of bytes a command without argument adds to a frame and its reply, in the current framing.
+        unsigned int estimateCommandBytes(int cmd) const;
+        /// Sort the values of the complete reply of a batch into the result table, stamped with the host time at which the device sampled them.
+        void parseMessage(const HapticAvatar_SentBatch& batch, int64_t sampleTimeNs);
+        /** Latest values of a command linearly extrapolated to a host time from the two latest replies. The extrapolation is limited
+        * to one reply interval and MAX_EXTRAPOLATION_US, so a lost reply doesn't make the values run away.
+        * @returns {bool} false if there are not two replies yet, the latest values are returned.
+        */
+        bool getExtrapolated(int cmd, float* values, int nbValues, std::chrono::steady_clock::time_point time) const;
+        /// Append a command with its arguments already formatted as ASCII. In binary mode, only commands without arguments can be appended this way.
         void appendCmd(int cmd, const char* args);
-        void updateIfUnsubscribed(int cmd);
+        /** Append a command and its already scaled arguments to the next frame without allocating. A coalesced SET replaces its pending value, see @sa setCoalesceMode
+        * @returns {bool} false if the command does not fit in OUTGOING_DATA_LEN or MAX_APPENDED_CMDS, in which case it is dropped.
+        */
+        bool appendCmd(int cmd, const int* args, int nbArgs);
+        /// Internal method to append a command and its scaled arguments like @sa appendCmd, without recording its sticky value.
+        bool putAppendedCmd(int cmd, const int* args, int nbArgs);
+        /// Scale a float to the integer sent on the wire for this command.
+        int scaleToInt(int cmd, float value) const { return int(value * scale_factor[cmd]); }
+        /// Notify that a command has been dropped because the outgoing frame or the appended list was full.
+        void onCommandDropped(int cmd);
+        /** Prepare the append of a command: removes the pending value of the same SET if the command is coalesced, see @sa setCoalesceMode.
+        * @param {int} key: first argument of the command, compared in CoalesceMode::LatestPerIndex.
+        * @returns {bool} false if MAX_APPENDED_CMDS commands are already waiting, in which case the command is dropped.
+        */
+        bool beginAppend(int cmd, int key);
+        /// Register the command formatted in cmd_appended_encoder since mark.
+        void endAppend(int cmd, int key, unsigned int mark);
+        /// Set how repeated appends of a SET command are merged before being sent. To be called by the drivers in @sa setupCoalesceModes
+        void setCoalesceMode(int cmd, CoalesceMode mode) { coalesce_modes[cmd] = mode; }
+        /** Declare a SET command whose latest value is part of the device state (collision objects, settings), to be called by the drivers in @sa setupStickyCommands.
+        * A rebooted device forgot it: the latest value is sent again after a reconnection. One value is kept per first argument if the command is coalesced per index.
+        */
+        void setStickyCommand(int cmd) { sticky_modes[cmd] = true; }
+        /// Remember the latest value of a sticky command, see @sa setStickyCommand
+        void recordSticky(int cmd, int key, const int* args, int nbArgs, float value);
+        /// Get fresh values of a command not subscribed to, or not received yet, into the result table with a one-shot query. Blocks the caller until the reply is parsed, see @sa waitQuery
+        void fetchIfUnsubscribed(int cmd);
 
         float getFloat(int cmd);
         float getFloat(int cmd, int channel);
@@ -158,20 +596,67 @@ namespace sofa::HapticAvatar
 
         virtual void setupNumReturnVals() = 0;
         virtual void setupCmdLists() = 0;
+        /// Declare the SET commands of which only the latest value needs to be sent, see @sa setCoalesceMode
+        virtual void setupCoalesceModes() {}
+        /// Declare the SET commands to send again after a reconnection, see @sa setStickyCommand
+        virtual void setupStickyCommands() {}
 
     private:
 
-        //Connection status
-        bool m_connected;
-
-        //Serial comm handler
-        HANDLE m_hSerial;
-        //Get various information about the connection
-        COMSTAT m_status;
-        //Keep track of last error
-        DWORD m_errors;
+        //Connection status, set by the connection and reconnection threads and by the haptic thread
+        std::atomic<LinkState> m_linkState;
+        // Thread running @sa connectDevice, see @sa connectAsync, then @sa reconnectDevice when the link is lost
+        std::thread m_connectThread;
+        // A read or a write failed, set by the haptic thread or the I/O thread and handled by @sa update
+        std::atomic<bool> m_linkBroken = false;
+        // The driver is being destroyed, stops the reconnection attempts
+        std::atomic<bool> m_closing = false;
+        // True from @sa onLinkLost until @sa resumeLink, only used by the haptic thread
+        bool m_reconnecting = false;
+        std::atomic<unsigned int> m_reconnectCounter = 0;
+
+        //Link to the device (serial port, pty, loopback or socket)
+        HapticAvatar_Transport* m_transport = nullptr;
 
         // String name of the port (ex: COM3)
         std::string m_portName;
+        // Type of transport used to reach the device, see @sa HapticAvatar_Transport::create
+        std::string m_transportType;
+        // Serial parameters of the link
+        HapticAvatar_LinkSettings m_linkSettings;
+        // Framing negotiated with the device, set again by the reconnection thread
+        std::atomic<bool> m_binaryMode = false;
+
+        ReceiveMode m_receiveMode = ReceiveMode::Blocking;
+        int m_receiveTimeoutUs = 0; // 0 for automatic
+        // Number of replies not received in time, read by the simulation thread
+        std::atomic<unsigned int> m_receiveTimeoutCounter = 0;
+        int m_consecutiveTimeouts = 0;
+        int m_consecutiveResyncs = 0;
+
+        int m_pipelineDepth = 1;
+        unsigned int m_batchSeq = 0;
+        unsigned int m_lastReceivedSeq = 0;
+
+        // Device type answered at the connection, see @sa getDeviceType
+        std::string m_deviceType;
+        std::mutex m_deviceTypeMutex;
+
+        // Number of entries of pending_queries not Free, so that update() only looks at them when needed
+        std::atomic<int> m_pendingQueries = 0;
+        // Thread which drives the driver by calling update(), none if released, see @sa waitQuery
+        std::atomic<std::thread::id> m_updateOwner = std::thread::id();
+        // Taken by the thread exchanging with the device, see @sa tryUpdate
+        std::atomic<bool> m_updating = false;
+
+        // Number of bytes read into incoming_ring, by the haptic thread or the I/O thread
+        std::atomic<uint64_t> m_bytesReceived = 0;
+
+        // Thread reading the link into incoming_ring, the only producer of the ring while it runs
+        std::thread m_ioThread;
+        std::atomic<bool> m_ioRunning = false;
+        // Only used to sleep until the I/O thread receives bytes, the ring itself is lock-free
+        std::mutex m_ioMutex;
+        std::condition_variable m_ioReceived;
     };
 };
@@ -31,13 +31,16 @@ namespace sofa::HapticAvatar
     /////       Methods for specific IBOX communication       /////
     ///////////////////////////////////////////////////////////////
 
-    HapticAvatar_DriverIbox::HapticAvatar_DriverIbox(const std::string& portName)
-        : HapticAvatar_DriverBase(portName)
+    HapticAvatar_DriverIbox::HapticAvatar_DriverIbox(const std::string& portName, const std::string& transportType, const HapticAvatar_LinkSettings& linkSettings)
+        : HapticAvatar_DriverBase(portName, transportType, linkSettings)
     {
         setupNumReturnVals();  // needs to be implemented in each device driver
         setupCmdLists();   // needs to be implemented in each device driver
+        setupCoalesceModes();
+        setupStickyCommands();
 
         device_type = 2;
+        delta_t_cmd = (int)CmdIBox::GET_CURRENT_DELTA_T;
     }
 
     void HapticAvatar_DriverIbox::setupNumReturnVals()
@@ -106,24 +109,41 @@ namespace sofa::HapticAvatar
     void HapticAvatar_DriverIbox::setupCmdLists()
     {
         // Setup the data you want to subscribe to from the port device here. Subscription commands can only be of type GET_... without input arguments.
-        // It is good practice to use prime numbers to avoid that all commands are sent at once.
-        subscribeTo((int)CmdIBox::GET_OPENING_VALUES, 1);
-        subscribeTo((int)CmdIBox::GET_PEDAL_STATES, 11);
-        subscribeTo((int)CmdIBox::GET_OPTO_FORCES, 13);
-        subscribeTo((int)CmdIBox::GET_CURRENT_DELTA_T, 17);
-        subscribeTo((int)CmdIBox::GET_LAST_PWM, 19);
-        subscribeTo((int)CmdIBox::GET_STATUS, 1009);
-        subscribeTo((int)CmdIBox::GET_CALIBRATION_STATUS, 1013);
-        subscribeTo((int)CmdIBox::GET_CONNECTION_STATES, 1019);
-        subscribeTo((int)CmdIBox::GET_BOARD_TEMP, 10007);
-        subscribeTo((int)CmdIBox::GET_BATTERY_VOLTAGE, 10009);
-        subscribeTo((int)CmdIBox::GET_USB_CHARGING_CURRENT, 10037);
-        subscribeTo((int)CmdIBox::GET_PART_TEMPERATURES, 10039);
+        // Rates are in Hz. The commands below the haptic loop rate are spread over the frames by the subscription scheduler.
+        subscribeAtRate((int)CmdIBox::GET_OPENING_VALUES, SUBSCRIPTION_EVERY_TICK);
+        subscribeAtRate((int)CmdIBox::GET_PEDAL_STATES, 100.0f);
+        subscribeAtRate((int)CmdIBox::GET_OPTO_FORCES, 100.0f);
+        subscribeAtRate((int)CmdIBox::GET_CURRENT_DELTA_T, 50.0f);
+        subscribeAtRate((int)CmdIBox::GET_LAST_PWM, 50.0f);
+        subscribeAtRate((int)CmdIBox::GET_STATUS, 1.0f);
+        subscribeAtRate((int)CmdIBox::GET_CALIBRATION_STATUS, 1.0f);
+        subscribeAtRate((int)CmdIBox::GET_CONNECTION_STATES, 1.0f);
+        subscribeAtRate((int)CmdIBox::GET_BOARD_TEMP, 0.1f);
+        subscribeAtRate((int)CmdIBox::GET_BATTERY_VOLTAGE, 0.1f);
+        subscribeAtRate((int)CmdIBox::GET_USB_CHARGING_CURRENT, 0.1f);
+        subscribeAtRate((int)CmdIBox::GET_PART_TEMPERATURES, 0.1f);
+    }
+
+    void HapticAvatar_DriverIbox::setupCoalesceModes()
+    {
+        // State SET commands: if called several times before the next update, only the latest value is sent. The first argument of the per index ones is the channel.
+        setCoalesceMode((int)CmdIBox::SET_ALL_FORCES, CoalesceMode::Latest);
+        setCoalesceMode((int)CmdIBox::SET_CHAN_FORCE, CoalesceMode::LatestPerIndex);
+        setCoalesceMode((int)CmdIBox::SET_LOOP_GAIN, CoalesceMode::LatestPerIndex);
+        setCoalesceMode((int)CmdIBox::SET_FF_ENABLE, CoalesceMode::Latest);
+    }
+
+    void HapticAvatar_DriverIbox::setupStickyCommands()
+    {
+        // Settings lost when the device reboots, sent again after a reconnection. The handle forces are held at zero meanwhile.
+        setStickyCommand((int)CmdIBox::SET_LOOP_GAIN);
+        setStickyCommand((int)CmdIBox::SET_FF_ENABLE);
     }
 
     float HapticAvatar_DriverIbox::getOpeningValue(int toolId)
     {
-        return getFloat((int)CmdIBox::GET_OPENING_VALUES, convertToolIdToChannel(toolId));
+        // subscribed every tick: a one-shot query would block the device thread calling this until the haptic thread answers it
+        return getLatestFloat((int)CmdIBox::GET_OPENING_VALUES, convertToolIdToChannel(toolId));
     }
     void HapticAvatar_DriverIbox::setForce(int toolId, float force)
     {
@@ -37,7 +37,7 @@ namespace sofa::HapticAvatar
     class SOFA_HAPTICAVATAR_API HapticAvatar_DriverIbox : public HapticAvatar_DriverBase
     {
     public:
-        HapticAvatar_DriverIbox(const std::string& portName);
+        HapticAvatar_DriverIbox(const std::string& portName, const std::string& transportType = "serial", const HapticAvatar_LinkSettings& linkSettings = HapticAvatar_LinkSettings());
 
         // Functions that are typically used at initialization, see also the base class
         // ------------------------------------------------------------------
@@ -45,6 +45,7 @@ namespace sofa::HapticAvatar
         void setForceFeedbackEnable(bool on);
         int getSerialNumber() override;
 
+        /// Latest opening of a tool handle received by @sa update, 0 until the first reply. Never queries the IBox, can be called from any thread.
         float getOpeningValue(int toolId);
         void setForce(int toolId, float force);
         int getStatus();
@@ -97,8 +98,11 @@ namespace sofa::HapticAvatar
 
         void setupNumReturnVals() override;
         void setupCmdLists() override;
+        void setupCoalesceModes() override;
+        void setupStickyCommands() override;
 
-    private:
+    public:
+        // This enum is a list of all commands. The same list exists in the device.
         enum CmdIBox
         {
             RESET = 0,
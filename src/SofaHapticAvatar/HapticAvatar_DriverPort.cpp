@@ -33,13 +33,16 @@ using namespace HapticAvatar;
 /////      Methods for specific device communication      /////
 ///////////////////////////////////////////////////////////////
 
-HapticAvatar_DriverPort::HapticAvatar_DriverPort(const std::string& portName)
-    : HapticAvatar_DriverBase(portName)
+HapticAvatar_DriverPort::HapticAvatar_DriverPort(const std::string& portName, const std::string& transportType, const HapticAvatar_LinkSettings& linkSettings)
+    : HapticAvatar_DriverBase(portName, transportType, linkSettings)
 {
     setupNumReturnVals();  // needs to be implemented in each device driver
     setupCmdLists();   // needs to be implemented in each device driver
+    setupCoalesceModes();
+    setupStickyCommands();
 
     device_type = 1;
+    delta_t_cmd = (int)CmdPort::GET_CURRENT_DELTA_T;
 
 }
 
@@ -144,18 +147,66 @@ void HapticAvatar_DriverPort::setupNumReturnVals()
 void HapticAvatar_DriverPort::setupCmdLists()
 {
     // Setup the data you want to subscribe to from the port device here. Subscription commands can only be of type GET_... without input arguments.
-    // It is good practice to use prime numbers to avoid that all commands are sent at once.
-    subscribeTo((int)CmdPort::GET_ANGLES_AND_LENGTH, 1);
-    subscribeTo((int)CmdPort::GET_TOOL_INSERTED, 11);
-    subscribeTo((int)CmdPort::GET_TOOL_ID, 13);
-    subscribeTo((int)CmdPort::GET_CURRENT_DELTA_T, 17);
-    subscribeTo((int)CmdPort::GET_LAST_PWM, 19);
-    subscribeTo((int)CmdPort::GET_BOARD_TEMP, 10007);
-    subscribeTo((int)CmdPort::GET_BATTERY_VOLTAGE, 10009);
-    subscribeTo((int)CmdPort::GET_STATUS, 1009);
-    subscribeTo((int)CmdPort::GET_CALIBRATION_STATUS, 1013);
-    subscribeTo((int)CmdPort::GET_USB_CHARGING_CURRENT, 10037);
-    subscribeTo((int)CmdPort::GET_PART_TEMPERATURES, 10039);
+    // Rates are in Hz. The commands below the haptic loop rate are spread over the frames by the subscription scheduler.
+    subscribeAtRate((int)CmdPort::GET_ANGLES_AND_LENGTH, SUBSCRIPTION_EVERY_TICK);
+    subscribeAtRate((int)CmdPort::GET_TOOL_INSERTED, 100.0f);
+    subscribeAtRate((int)CmdPort::GET_TOOL_ID, 100.0f);
+    subscribeAtRate((int)CmdPort::GET_CURRENT_DELTA_T, 50.0f);
+    subscribeAtRate((int)CmdPort::GET_LAST_PWM, 50.0f);
+    subscribeAtRate((int)CmdPort::GET_BOARD_TEMP, 0.1f);
+    subscribeAtRate((int)CmdPort::GET_BATTERY_VOLTAGE, 0.1f);
+    subscribeAtRate((int)CmdPort::GET_STATUS, 1.0f);
+    subscribeAtRate((int)CmdPort::GET_CALIBRATION_STATUS, 1.0f);
+    subscribeAtRate((int)CmdPort::GET_USB_CHARGING_CURRENT, 0.1f);
+    subscribeAtRate((int)CmdPort::GET_PART_TEMPERATURES, 0.1f);
+}
+
+void HapticAvatar_DriverPort::setupCoalesceModes()
+{
+    // State SET commands: if called several times before the next update, only the latest value is sent.
+    setCoalesceMode((int)CmdPort::SET_MOTOR_FORCE_AND_TORQUES, CoalesceMode::Latest);
+    setCoalesceMode((int)CmdPort::SET_TIP_FORCE_AND_ROT_TORQUE, CoalesceMode::Latest);
+    setCoalesceMode((int)CmdPort::SET_MANUAL_PWM, CoalesceMode::Latest);
+    setCoalesceMode((int)CmdPort::SET_DEADBAND_PWM_WIDTH, CoalesceMode::Latest);
+    setCoalesceMode((int)CmdPort::SET_FF_ENABLE, CoalesceMode::Latest);
+    setCoalesceMode((int)CmdPort::SET_TOOL_DATA, CoalesceMode::Latest);
+    setCoalesceMode((int)CmdPort::SET_TOOL_JAW_OPENING_ANGLE, CoalesceMode::Latest);
+
+    // Collision object properties, the first argument is the object index
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_ACTIVE, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_P0, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_V0, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_N, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_Q, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_R, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_S, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_T, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_STIFFNESS, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_DAMPING, CoalesceMode::LatestPerIndex);
+    setCoalesceMode((int)CmdPort::SET_COLLISION_OBJECT_FRICTION, CoalesceMode::LatestPerIndex);
+}
+
+void HapticAvatar_DriverPort::setupStickyCommands()
+{
+    // Device settings and collision objects, lost when the device reboots. The forces are not: they are held at zero until the link is back.
+    setStickyCommand((int)CmdPort::SET_DEADBAND_PWM_WIDTH);
+    setStickyCommand((int)CmdPort::SET_FF_ENABLE);
+    setStickyCommand((int)CmdPort::SET_TOOL_DATA);
+    setStickyCommand((int)CmdPort::SET_TOOL_JAW_OPENING_ANGLE);
+
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_ACTIVE);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_P0);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_V0);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_N);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_Q);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_R);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_S);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_T);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_STIFFNESS);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_DAMPING);
+    setStickyCommand((int)CmdPort::SET_COLLISION_OBJECT_FRICTION);
 }
 
 
@@ -164,6 +215,14 @@ sofa::type::fixed_array<float, 4> HapticAvatar_DriverPort::getAnglesAndLength()
     return getFloat4((int)CmdPort::GET_ANGLES_AND_LENGTH);
 }
 
+sofa::type::fixed_array<float, 4> HapticAvatar_DriverPort::getAnglesAndLengthAt(std::chrono::steady_clock::time_point time)
+{
+    fetchIfUnsubscribed((int)CmdPort::GET_ANGLES_AND_LENGTH);
+    sofa::type::fixed_array<float, 4> results;
+    getExtrapolated((int)CmdPort::GET_ANGLES_AND_LENGTH, results.data(), 4, time);
+    return results;
+}
+
 sofa::type::fixed_array<float, 4> HapticAvatar_DriverPort::getLastPWM()
 {
     return getFloat4((int)CmdPort::GET_LAST_PWM);
@@ -202,7 +261,10 @@ sofa::type::fixed_array<float, 4> HapticAvatar_DriverPort::getEncoderScalingValu
 
 bool HapticAvatar_DriverPort::getYawPitchCalibrated()
 {
-    return ((bool)result_table[(int)CmdPort::GET_CALIBRATION_STATUS][0]) && ((bool)result_table[(int)CmdPort::GET_CALIBRATION_STATUS][1]);
+    // both flags must come from the same reply
+    float calibrated[2];
+    result_table.read((int)CmdPort::GET_CALIBRATION_STATUS, calibrated, 2);
+    return ((bool)calibrated[0]) && ((bool)calibrated[1]);
 }
 
 sofa::type::fixed_array<float, 4> HapticAvatar_DriverPort::getMotorScalingValues()
@@ -461,28 +523,14 @@ void HapticAvatar_DriverPort::appendPrimitive(int index, int type, int active,
     float q, float r, float s, float t, float stiffness, float friction, float damping)
 {
     int cmd = (int)CmdPort::SET_COLLISION_OBJECT;
-    std::string arguments;
-    arguments = std::to_string(index) + " " +
-        std::to_string(type) + " " +
-        std::to_string(active) + " " +
-        std::to_string(int(p0[0] * scale_factor[cmd])) + " " +
-        std::to_string(int(p0[1] * scale_factor[cmd])) + " " +
-        std::to_string(int(p0[2] * scale_factor[cmd])) + " " +
-        std::to_string(int(v0[0] * scale_factor[cmd])) + " " +
-        std::to_string(int(v0[1] * scale_factor[cmd])) + " " +
-        std::to_string(int(v0[2] * scale_factor[cmd])) + " " +
-        std::to_string(int(n[0] * scale_factor[cmd])) + " " +
-        std::to_string(int(n[1] * scale_factor[cmd])) + " " +
-        std::to_string(int(n[2] * scale_factor[cmd])) + " " +
-        std::to_string(int(q * scale_factor[cmd])) + " " +
-        std::to_string(int(r * scale_factor[cmd])) + " " +
-        std::to_string(int(s * scale_factor[cmd])) + " " +
-        std::to_string(int(t * scale_factor[cmd])) + " " +
-        std::to_string(int(stiffness * scale_factor[cmd])) + " " +
-        std::to_string(int(friction * scale_factor[cmd])) + " " +
-        std::to_string(int(damping * scale_factor[cmd])) + " ";
-
-    appendCmd((int)CmdPort::SET_COLLISION_OBJECT, arguments.c_str());
+    const int args[19] = { index, type, active,
+        scaleToInt(cmd, p0[0]), scaleToInt(cmd, p0[1]), scaleToInt(cmd, p0[2]),
+        scaleToInt(cmd, v0[0]), scaleToInt(cmd, v0[1]), scaleToInt(cmd, v0[2]),
+        scaleToInt(cmd, n[0]), scaleToInt(cmd, n[1]), scaleToInt(cmd, n[2]),
+        scaleToInt(cmd, q), scaleToInt(cmd, r), scaleToInt(cmd, s), scaleToInt(cmd, t),
+        scaleToInt(cmd, stiffness), scaleToInt(cmd, friction), scaleToInt(cmd, damping) };
+
+    appendCmd(cmd, args, 19);
 }
 
 } // namespace sofa::HapticAvatar
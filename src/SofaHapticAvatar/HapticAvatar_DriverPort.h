@@ -42,7 +42,7 @@ namespace sofa::HapticAvatar
     class SOFA_HAPTICAVATAR_API HapticAvatar_DriverPort : public HapticAvatar_DriverBase
     {
     public:
-        HapticAvatar_DriverPort(const std::string& portName);
+        HapticAvatar_DriverPort(const std::string& portName, const std::string& transportType = "serial", const HapticAvatar_LinkSettings& linkSettings = HapticAvatar_LinkSettings());
 
         // Functions that are typically used at initialization or shutdown
         // ---------------------------------------------------------------
@@ -89,6 +89,11 @@ namespace sofa::HapticAvatar
         */
         sofa::type::fixed_array<float, 4> getAnglesAndLength();
 
+        /** Get the angles and insertion length extrapolated to a host time, e.g. now, to compensate the latency of the link. See @sa getLinkClock
+        * @returns {vec4f} same order as @sa getAnglesAndLength
+        */
+        sofa::type::fixed_array<float, 4> getAnglesAndLengthAt(std::chrono::steady_clock::time_point time);
+
         /** Get the ID of the inserted tool, i.e. the simulated medical instrument (if any).
         * @returns {int} where -1=no tool inserted, 0=tool inserted but not identified, 1,2,3 ... is an identified tool
         */        
@@ -203,6 +208,10 @@ namespace sofa::HapticAvatar
         void setupNumReturnVals() override;
         /// Internal method to setup which data from the device to subscribe to, and how often.
         void setupCmdLists() override;
+        /// Internal method to setup which SET commands only send their latest value.
+        void setupCoalesceModes() override;
+        /// Internal method to setup which SET commands are sent again after a reconnection.
+        void setupStickyCommands() override;
 
         int reserveNextPrimitiveIndex();
         void appendPrimitive(int index, int type, int active,
@@ -215,6 +224,7 @@ namespace sofa::HapticAvatar
     private:
 
         bool primitive_index_used[MAX_NUM_PRIMITIVES];
+    public:
         // This enum is a list of all commands. The same list exists in the device.
         enum CmdPort
         {
@@ -22,6 +22,7 @@
 
 #include <SofaHapticAvatar/HapticAvatar_DriverScope.h>
 #include <sofa/helper/logging/Messaging.h>
+#include <iostream>
 
 namespace sofa::HapticAvatar
 {
@@ -33,13 +34,14 @@ using namespace HapticAvatar;
 /////      Methods for specific device communication      /////
 ///////////////////////////////////////////////////////////////
 
-HapticAvatar_DriverScope::HapticAvatar_DriverScope(const std::string& portName)
-    : HapticAvatar_DriverBase(portName)
+HapticAvatar_DriverScope::HapticAvatar_DriverScope(const std::string& portName, const std::string& transportType, const HapticAvatar_LinkSettings& linkSettings)
+    : HapticAvatar_DriverBase(portName, transportType, linkSettings)
 {
     setupNumReturnVals();  // needs to be implemented in each device driver
     setupCmdLists();   // needs to be implemented in each device driver
 
     device_type = 3;
+    delta_t_cmd = (int)CmdScope::GET_CURRENT_DELTA_T;
 
 }
 
@@ -68,11 +70,11 @@ void HapticAvatar_DriverScope::setupNumReturnVals()
 void HapticAvatar_DriverScope::setupCmdLists()
 {
     // Setup the data you want to subscribe to from the port device here. Subscription commands can only be of type GET_... without input arguments.
-    // It is good practice to use prime numbers to avoid that all commands are sent at once.
-    subscribeTo((int)CmdScope::GET_CAMERA_ANGLE, 1);
-    subscribeTo((int)CmdScope::GET_BUTTON_STATES, 1);
-    subscribeTo((int)CmdScope::GET_ZOOM_LEVEL, 1);
-    subscribeTo((int)CmdScope::GET_CURRENT_DELTA_T, 17);
+    // Rates are in Hz. The commands below the haptic loop rate are spread over the frames by the subscription scheduler.
+    subscribeAtRate((int)CmdScope::GET_CAMERA_ANGLE, SUBSCRIPTION_EVERY_TICK);
+    subscribeAtRate((int)CmdScope::GET_BUTTON_STATES, SUBSCRIPTION_EVERY_TICK);
+    subscribeAtRate((int)CmdScope::GET_ZOOM_LEVEL, SUBSCRIPTION_EVERY_TICK);
+    subscribeAtRate((int)CmdScope::GET_CURRENT_DELTA_T, 50.0f);
 }
 
 
@@ -108,5 +110,16 @@ int HapticAvatar_DriverScope::getSerialNumber()
 }
 
 
+void HapticAvatar_DriverScope::printStatus()
+{
+    std::cout << "Status for Scope device S/N " << getSerialNumber() << " at " << getPortName() << std::endl;
+    std::cout << "--------------------------------------------" << std::endl;
+
+    std::cout << "  Camera angle " << getCameraAngle() << " rad" << std::endl;
+    std::cout << "  Zoom level " << getZoomLevel() << std::endl;
+    std::cout << "  Loop time " << getCurrentDeltaT() << " ms" << std::endl << std::endl;
+}
+
+
 
 } // namespace sofa::HapticAvatar
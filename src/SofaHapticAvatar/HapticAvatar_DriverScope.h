@@ -32,7 +32,7 @@ namespace sofa::HapticAvatar
     class SOFA_HAPTICAVATAR_API HapticAvatar_DriverScope : public HapticAvatar_DriverBase
     {
     public:
-        HapticAvatar_DriverScope(const std::string& portName);
+        HapticAvatar_DriverScope(const std::string& portName, const std::string& transportType = "serial", const HapticAvatar_LinkSettings& linkSettings = HapticAvatar_LinkSettings());
 
         // Functions that are typically used at initialization or shutdown
         // ---------------------------------------------------------------
@@ -72,14 +72,16 @@ namespace sofa::HapticAvatar
         */
         float getCurrentDeltaT();
 
+        /// Will output to cout a report of the status of the device
+        void printStatus() override;
+
     protected:
         /// Internal method to setup how many return values each command is expecting and how to scale outgoing and incoming data.
         void setupNumReturnVals() override;
         /// Internal method to setup which data from the device to subscribe to, and how often.
         void setupCmdLists() override;
 
-    private:
-
+    public:
         // This enum is a list of all commands. The same list exists in the device.
         enum CmdScope
         {
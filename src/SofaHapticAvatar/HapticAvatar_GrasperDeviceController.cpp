@@ -135,6 +135,15 @@ void HapticAvatar_GrasperDeviceController::haptic_updateForceFeedback(HapticAvat
     if (m_forceFeedback == nullptr)
         return;
 
+    // While the link is lost, or until the device sends fresh positions after a reconnection, hold zero force
+    if (!m_HA_driver->IsConnected())
+    {
+        m_HA_driver->setMotorForceAndTorques(0.0f, 0.0f, 0.0f, 0.0f);
+        if (d_useIBox.getValue() && _IBoxCtrl != nullptr)
+            _IBoxCtrl->setHandleForce(m_hapticData.toolId, 0.0f);
+        return;
+    }
+
     m_forceFeedback->computeForce(m_toolPositionCopy, m_resForces);
 
     m_HA_driver->setMotorForceAndTorques(-float(m_resForces[2][0]), float(m_resForces[1][0]), float(m_resForces[3][0]), -float(m_resForces[0][0]));
@@ -25,10 +25,21 @@
 #include <SofaHapticAvatar/HapticAvatar_ArticulatedDeviceController.h>
 #include <SofaHapticAvatar/HapticAvatar_IBoxController.h>
 #include <SofaHapticAvatar/HapticAvatar_DriverPort.h>
+#include <SofaHapticAvatar/HapticAvatar_LoopTimer.h>
 
 #include <sofa/helper/logging/Messaging.h>
 #include <sofa/helper/system/thread/CTime.h>
+#include <algorithm>
 #include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
 
 
 namespace sofa::HapticAvatar
@@ -56,7 +67,7 @@ void HapticAvatar_HapticThreadManager::kill()
             std::cout << "kill s_hapticThread" << std::endl;
         }
 
-        s_hapticThread->m_devices.clear();        
+        // the threads are stopped before the list of devices is released, they may be in the middle of a tick
         delete s_hapticThread;
         s_hapticThread = nullptr;
     }
@@ -73,8 +84,16 @@ HapticAvatar_HapticThreadManager::~HapticAvatar_HapticThreadManager()
 {
     if (m_terminate == false)
     {
-        m_terminate = true;
+        {
+            std::lock_guard<std::mutex> lock(m_tickMutex);
+            m_terminate = true;
+        }
+        m_tickStarted.notify_all();
+        m_tickDone.notify_all();
         haptic_thread.join();
+
+        for (std::thread& deviceThread : m_deviceThreads)
+            deviceThread.join();
     }
 }
 
@@ -97,16 +116,26 @@ void HapticAvatar_HapticThreadManager::Haptics(std::atomic<bool>& terminate, voi
     
     HapticAvatar_HapticThreadManager* threadMgr = static_cast<HapticAvatar_HapticThreadManager*>(p_this);
 
-    // Loop Timer
-    long targetSpeedLoop = 1; // Target loop speed: 1ms
+    applyRealTimeSettings("haptic thread", true);
+    msg_info("HapticAvatar_HapticThreadManager") << "Real-time settings: " << getRealTimeReport();
 
-    // Use computer tick for timer
+    // Loop Timer: target loop speed given by the base rate, on absolute deadlines. Sleeps for most of the period and only spins at its end
+    float baseRate = m_baseRate;
+    HapticAvatar_LoopTimer loopTimer(int64_t(1.0e9f / baseRate));
+    loopTimer.start();
+
+    // Use computer tick for the frequency log
     ctime_t refTicksPerMs = CTime::getRefTicksPerSec() / 1000;
-    ctime_t targetTicksPerLoop = targetSpeedLoop * refTicksPerMs;
 
     int cptLoop = 0;
+    uint64_t tick = 0;
     ctime_t startTimePrev = CTime::getRefTime();
     ctime_t summedLoopDuration = 0;
+    ctime_t maxTickDuration = 0;
+
+    // drivers updated by this thread, released when it stops so that their getters update them again, see HapticAvatar_DriverBase::waitQuery
+    HapticAvatar_ArticulatedDeviceController* drivenDevice = nullptr;
+    HapticAvatar_IBoxController* drivenIBox = nullptr;
     
     while (!terminate)
     {
@@ -114,56 +143,282 @@ void HapticAvatar_HapticThreadManager::Haptics(std::atomic<bool>& terminate, voi
         summedLoopDuration += (startTime - startTimePrev);
         startTimePrev = startTime;
 
-        // loop over the devices
-        for (auto device : m_devices) // mutex?
-        {            
-            device->haptic_updateArticulations(m_IBox);
+        if (m_baseRate != baseRate)
+        {
+            baseRate = m_baseRate;
+            loopTimer.setPeriod(int64_t(1.0e9f / baseRate));
+        }
 
-            // Force feedback computation
-            if (m_simulationStarted)
-            {
-                device->haptic_updateForceFeedback(m_IBox);
-            }
+        // start the tick: the device threads exchange with their links while this thread updates the first device
+        HapticAvatar_ArticulatedDeviceController* firstDevice = nullptr;
+        HapticAvatar_IBoxController* iBox = nullptr;
+        unsigned int nbDueThreads = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_tickMutex);
+            if (terminate)
+                break; // the device threads may have stopped already
 
-            HapticAvatar_DriverBase* _driver = device->getBaseDriver();
-            _driver->update();
+            if (!m_devices.empty())
+                firstDevice = m_devices[0];
+            iBox = m_IBox;
 
-            if (m_IBox != nullptr)
+            // the device threads only run the tick if this thread marked them due, each one is counted in the barrier
+            m_nbPendingDevices = 0;
+            for (std::size_t i = 0; i < m_deviceDue.size(); i++)
             {
-                m_IBox->update();
+                m_deviceDue[i] = (tick % m_devices[i + 1]->getHapticPeriod() == 0);
+                if (m_deviceDue[i])
+                    m_nbPendingDevices++;
             }
+            nbDueThreads = m_nbPendingDevices;
+            m_tickCounter++;
+        }
+        if (nbDueThreads > 0)
+            m_tickStarted.notify_all();
+
+        if (firstDevice != nullptr && tick % firstDevice->getHapticPeriod() == 0)
+        {
+            updateDevice(firstDevice, iBox);
+            drivenDevice = firstDevice;
         }
 
+        // barrier: the tick lasts as long as its slowest device, not the sum of all of them
+        {
+            std::unique_lock<std::mutex> lock(m_tickMutex);
+            m_tickDone.wait(lock, [this] { return m_nbPendingDevices == 0 || m_terminate; });
+            if (terminate)
+                break; // the device threads stop without finishing the tick
+        }
+
+        // the IBox is a participant of the tick on its own: serviced once per period, whatever the number of devices.
+        // The handle forces of all the devices are queued by now, they are sent in a single exchange
+        if (iBox != nullptr && tick % iBox->getHapticPeriod() == 0)
+        {
+            iBox->update();
+            drivenIBox = iBox;
+        }
+
+        const ctime_t tickDuration = CTime::getRefTime() - startTime;
+        if (tickDuration > maxTickDuration)
+            maxTickDuration = tickDuration;
+        tick++;
+
         if (logThread)
         {
+            // log about once per second whatever the base rate
             cptLoop++;
-            if (cptLoop % 1000 == 0) {
-                float updateFreq = 1000 * 1000 / ((float)summedLoopDuration / (float)refTicksPerMs); // in Hz
-                std::cout << "DeviceName: " << " | Iteration: " << cptLoop << " | Average haptic loop frequency " << std::to_string(int(updateFreq)) << std::endl;
+            const int logPeriod = std::max(int(baseRate), 1);
+            if (cptLoop % logPeriod == 0) {
+                float updateFreq = logPeriod * 1000 / ((float)summedLoopDuration / (float)refTicksPerMs); // in Hz
+                std::cout << "DeviceName: " << " | Iteration: " << cptLoop << " | Average haptic loop frequency " << std::to_string(int(updateFreq)) << " (base rate " << int(baseRate) << ")"
+                    << " | Overruns: " << loopTimer.getOverrunCounter() << " | Max wake up delay: " << loopTimer.getMaxLatenessNs() / 1000 << " us"
+                    << " | Max tick duration: " << int(1000 * maxTickDuration / refTicksPerMs) << " us" << std::endl;
                 summedLoopDuration = 0;
+                maxTickDuration = 0;
             }
         }
 
+        // If loop is quicker than the target loop speed. Wait here, an overrun starts the next loop at once.
+        loopTimer.wait();
+    }
+
+    if (drivenDevice != nullptr)
+        drivenDevice->getBaseDriver()->releaseUpdates();
+    if (drivenIBox != nullptr)
+        drivenIBox->getBaseDriver()->releaseUpdates();
 
-        ctime_t endTime = CTime::getRefTime();
-        ctime_t duration = endTime - startTime;
+    if (logThread)
+    {
+        std::cout << "Haptics thread END!!" << std::endl;
+    }
+}
 
-        // If loop is quicker than the target loop speed. Wait here.
-        duration = 0;
-        while (duration < targetTicksPerLoop)
+
+
+
+void HapticAvatar_HapticThreadManager::updateDevice(HapticAvatar_ArticulatedDeviceController* device, HapticAvatar_IBoxController* iBox)
+{
+    device->haptic_updateArticulations(iBox);
+
+    // Force feedback computation
+    if (m_simulationStarted)
+    {
+        device->haptic_updateForceFeedback(iBox);
+    }
+
+    HapticAvatar_DriverBase* _driver = device->getBaseDriver();
+    _driver->update();
+}
+
+
+void HapticAvatar_HapticThreadManager::deviceThread(HapticAvatar_ArticulatedDeviceController* device, std::size_t index, uint64_t tickCounter)
+{
+    applyRealTimeSettings("device thread " + device->name.getValue(), false);
+
+    while (true)
+    {
+        HapticAvatar_IBoxController* iBox = nullptr;
         {
-            endTime = CTime::getRefTime();
-            duration = endTime - startTime;
+            std::unique_lock<std::mutex> lock(m_tickMutex);
+            m_tickStarted.wait(lock, [this, tickCounter] { return m_terminate || m_tickCounter != tickCounter; });
+            if (m_terminate)
+                break; // the devices are being destroyed, no more update
+
+            // only the haptic thread decides if the device is due at this tick: then it is counted in the barrier
+            tickCounter = m_tickCounter;
+            if (!m_deviceDue[index])
+                continue;
+
+            m_deviceDue[index] = false;
+            iBox = m_IBox;
         }
+
+        updateDevice(device, iBox);
+
+        bool lastDevice = false;
+        {
+            std::lock_guard<std::mutex> lock(m_tickMutex);
+            lastDevice = (--m_nbPendingDevices == 0);
+        }
+        if (lastDevice)
+            m_tickDone.notify_one();
     }
 
-    if (logThread)
+    device->getBaseDriver()->releaseUpdates();
+}
+
+
+void HapticAvatar_HapticThreadManager::setRealTimeSettings(const HapticAvatar_RealTimeSettings& settings)
+{
+    std::lock_guard<std::mutex> lock(m_tickMutex);
+    m_realTimeSettings = settings;
+}
+
+
+std::string HapticAvatar_HapticThreadManager::getRealTimeReport()
+{
+    std::lock_guard<std::mutex> lock(m_tickMutex);
+    return m_realTimeReport;
+}
+
+
+/// Touch the pages of the stack the haptic loop may use, so that they are mapped (and locked with mlockall) before the first tick
+static void prefaultThreadStack()
+{
+    volatile char stack[HAPTIC_PREFAULT_STACK_KB * 1024];
+    for (std::size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+
+void HapticAvatar_HapticThreadManager::applyRealTimeSettings(const std::string& threadName, bool lockMemory)
+{
+    HapticAvatar_RealTimeSettings settings;
     {
-        std::cout << "Haptics thread END!!" << std::endl;
+        std::lock_guard<std::mutex> lock(m_tickMutex);
+        settings = m_realTimeSettings;
+    }
+
+    std::stringstream report;
+    report << threadName << ":";
+
+#ifdef __linux__
+    if (settings.priority > 0)
+    {
+        sched_param param;
+        param.sched_priority = std::min(std::max(settings.priority, sched_get_priority_min(SCHED_FIFO)), sched_get_priority_max(SCHED_FIFO));
+        int res = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (res == 0)
+            report << " SCHED_FIFO " << param.sched_priority;
+        else
+            report << " SCHED_FIFO " << param.sched_priority << " refused (" << strerror(res) << "), default scheduling";
+    }
+    else
+    {
+        report << " default scheduling";
     }
-}
 
+    if (!settings.cpuAffinity.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : settings.cpuAffinity)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &cpus);
+        }
 
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (res != 0)
+            report << ", affinity refused (" << strerror(res) << ")";
+    }
+
+    cpu_set_t achievedCpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(achievedCpus), &achievedCpus) == 0)
+    {
+        report << ", CPUs";
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &achievedCpus))
+                report << " " << cpu;
+        }
+    }
+
+    if (lockMemory && settings.lockMemory)
+    {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+            report << ", memory locked";
+        else
+            report << ", mlockall refused (" << strerror(errno) << ")";
+    }
+#elif defined(WIN32)
+    if (settings.priority > 0)
+    {
+        if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+            report << " time critical priority";
+        else
+            report << " time critical priority refused, default scheduling";
+    }
+    else
+    {
+        report << " default scheduling";
+    }
+
+    if (!settings.cpuAffinity.empty())
+    {
+        DWORD_PTR mask = 0;
+        for (int cpu : settings.cpuAffinity)
+        {
+            if (cpu >= 0 && cpu < int(sizeof(DWORD_PTR) * 8))
+                mask |= DWORD_PTR(1) << cpu;
+        }
+
+        if (SetThreadAffinityMask(GetCurrentThread(), mask) != 0)
+            report << ", affinity set";
+        else
+            report << ", affinity refused";
+    }
+
+    if (lockMemory && settings.lockMemory)
+        report << ", memory locking not supported";
+#else
+    if (settings.priority > 0 || !settings.cpuAffinity.empty() || (lockMemory && settings.lockMemory))
+        report << " real-time settings not supported, default scheduling";
+    else
+        report << " default scheduling";
+#endif
+
+    if (settings.prefaultStack)
+    {
+        prefaultThreadStack();
+        report << ", " << HAPTIC_PREFAULT_STACK_KB << " KB of stack prefaulted";
+    }
+
+    std::lock_guard<std::mutex> lock(m_tickMutex);
+    if (!m_realTimeReport.empty())
+        m_realTimeReport += "\n";
+    m_realTimeReport += report.str();
+}
 
 
 void HapticAvatar_HapticThreadManager::registerDevice(HapticAvatar_ArticulatedDeviceController* device)
@@ -181,7 +436,17 @@ void HapticAvatar_HapticThreadManager::registerDevice(HapticAvatar_ArticulatedDe
 
     if (!found)
     {
-        m_devices.push_back(device);
+        {
+            std::lock_guard<std::mutex> lock(m_tickMutex);
+            m_devices.push_back(device);
+
+            // the exchanges with the link of each extra device run in their own thread, concurrently with the others
+            if (m_devices.size() > 1)
+            {
+                m_deviceDue.push_back(false);
+                m_deviceThreads.push_back(std::thread(&HapticAvatar_HapticThreadManager::deviceThread, this, device, m_deviceThreads.size(), m_tickCounter));
+            }
+        }
         createHapticThreads();
     }
     else
@@ -193,7 +458,15 @@ void HapticAvatar_HapticThreadManager::registerDevice(HapticAvatar_ArticulatedDe
 
 void HapticAvatar_HapticThreadManager::registerIBox(HapticAvatar_IBoxController* ibox)
 {
-    m_IBox = ibox;
+    {
+        std::lock_guard<std::mutex> lock(m_tickMutex);
+        if (m_IBox != nullptr && m_IBox != ibox)
+            msg_warning("HapticAvatar_HapticThreadManager") << "IBox: " << ibox->name.getValue() << " replaces " << m_IBox->name.getValue() << " in haptic thread, only one IBox is updated.";
+        m_IBox = ibox;
+    }
+
+    // the IBox is updated by the haptic thread even if no device is registered
+    createHapticThreads();
 }
 
 } // namespace sofa::HapticAvatar
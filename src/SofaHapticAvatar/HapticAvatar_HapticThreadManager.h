@@ -27,6 +27,10 @@
 
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <vector>
 
 namespace sofa::HapticAvatar
 {
@@ -34,6 +38,18 @@ class HapticAvatar_HapticThreadManager;
 class HapticAvatar_ArticulatedDeviceController;
 class HapticAvatar_IBoxController;
 
+#define HAPTIC_BASE_RATE_HZ 1000.0f // default rate of the haptic thread tick, see @sa HapticAvatar_HapticThreadSettings
+#define HAPTIC_PREFAULT_STACK_KB 256 // stack touched by each haptic thread at start when prefaultStack is set
+
+/// Real-time settings of the haptic threads. Each one falls back to the default behaviour if the process lacks the privileges.
+struct HapticAvatar_RealTimeSettings
+{
+    int priority = 0; // SCHED_FIFO priority from 1 to 99, 0 keeps the default scheduling
+    std::vector<int> cpuAffinity; // CPUs the haptic threads may run on, all if empty
+    bool lockMemory = false; // lock all the pages of the process in RAM (mlockall) so that the haptic loop never waits for a page fault
+    bool prefaultStack = false; // touch the first HAPTIC_PREFAULT_STACK_KB of the stack of each haptic thread before its first tick
+};
+
 /// Static singleton of HapticThreadManager
 static HapticAvatar_HapticThreadManager* s_hapticThread = nullptr;
 
@@ -54,13 +70,29 @@ public:
     std::atomic<bool> m_terminate;
 
     /** Method to register a new device inside the vector @m_devices
-    * Will check to avoid redundencies and call @sa createHapticThreads
+    * Will check to avoid redundencies and call @sa createHapticThreads. From the second device on, a thread is created to run the exchanges of its link, see @sa deviceThread
     */
     void registerDevice(HapticAvatar_ArticulatedDeviceController* device);
 
-    /// Method to register the Ibox. Assume only one per scene ?
+    /** Method to register the IBox, only one per scene. It is updated once every @sa HapticAvatar_BaseDeviceController::d_hapticPeriod ticks,
+    * after the force feedback of all the devices of the tick, and starts the haptic thread if needed.
+    */
     void registerIBox(HapticAvatar_IBoxController* ibox);
 
+    /** Set the rate of the haptic thread tick. Each device is updated every @sa HapticAvatar_BaseDeviceController::d_hapticPeriod ticks.
+    * @param {float} rateHz: tick rate in Hz, ignored if not positive.
+    */
+    void setBaseRate(float rateHz) { if (rateHz > 0.0f) m_baseRate = rateHz; }
+    float getBaseRate() const { return m_baseRate; }
+
+    /** Set the real-time settings applied by the haptic thread and the device threads when they start. To be set before the devices register.
+    * @param {HapticAvatar_RealTimeSettings} settings: settings to apply.
+    */
+    void setRealTimeSettings(const HapticAvatar_RealTimeSettings& settings);
+
+    /// Settings achieved by each haptic thread, one line per thread. Empty until the threads are started.
+    std::string getRealTimeReport();
+
     /// Method to notify that simulation is running
     void setSimulationStarted() { m_simulationStarted = true; }
 
@@ -72,16 +104,50 @@ private:
     /// Internal method to create the haptic thread only once. Will be called each time a device is successfully registered
     void createHapticThreads();
 
+    /// Internal method to run one tick of a device: articulations, force feedback and exchange with its link
+    void updateDevice(HapticAvatar_ArticulatedDeviceController* device, HapticAvatar_IBoxController* iBox);
+
+    /** Internal method to apply @sa m_realTimeSettings to the calling thread and add the settings achieved to @sa m_realTimeReport.
+    * @param {string} threadName: name of the thread in the report.
+    * @param {bool} lockMemory: lock the memory of the process if asked by the settings, done once by the haptic thread.
+    */
+    void applyRealTimeSettings(const std::string& threadName, bool lockMemory);
+
+    /** Loop of the thread of a device other than the first one. Waits for each tick started by @sa Haptics, updates the device
+    * if the haptic thread marked it due in @sa m_deviceDue and reports it to the barrier of the tick, so the links are all serviced at the same time.
+    * Stops as soon as @sa m_terminate is set, without updating the device again.
+    * @param {HapticAvatar_ArticulatedDeviceController *} device: device updated by this thread.
+    * @param {size_t} index: index of the thread in @sa m_deviceThreads and @sa m_deviceDue
+    * @param {uint64} tickCounter: value of @sa m_tickCounter when the thread was created, its first tick is the next one.
+    */
+    void deviceThread(HapticAvatar_ArticulatedDeviceController* device, std::size_t index, uint64_t tickCounter);
+
     /// haptic thread c++ object
     std::thread haptic_thread;
 
     bool hapticLoopStarted = false; ///< Bool to store the information is haptic thread is running or not.
     bool m_simulationStarted = false; ///< Bool to store the information that the simulation is running or not.
+    std::atomic<float> m_baseRate = HAPTIC_BASE_RATE_HZ; ///< Rate of the haptic thread tick in Hz.
 
     /// Vector of registered device to be updated in the haptic thread loop.
     sofa::type::vector< HapticAvatar_ArticulatedDeviceController*> m_devices;
-    /// Pointer to the iBox controller.
+    /// Pointer to the iBox controller, protected by @sa m_tickMutex
     HapticAvatar_IBoxController* m_IBox = nullptr;
+
+    /// Threads of the devices after the first one, the first device is updated by the haptic thread itself
+    std::vector<std::thread> m_deviceThreads;
+
+    /// Synchronisation of the device threads with the haptic thread, protects also @sa m_devices
+    ///{
+    std::mutex m_tickMutex;
+    std::condition_variable m_tickStarted; ///< notified by the haptic thread when a tick starts
+    std::condition_variable m_tickDone; ///< notified by the last device thread done with the tick
+    uint64_t m_tickCounter = 0; ///< number of ticks started, the current tick is m_tickCounter - 1
+    unsigned int m_nbPendingDevices = 0; ///< number of device threads still running the current tick
+    std::vector<bool> m_deviceDue; ///< per device thread, set by the haptic thread if the device is due at the current tick, cleared by the device thread
+    HapticAvatar_RealTimeSettings m_realTimeSettings; ///< settings applied by the threads when they start
+    std::string m_realTimeReport; ///< settings achieved by the threads
+    ///}
 };
 
 
@@ -0,0 +1,101 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_HapticThreadSettings.h>
+#include <SofaHapticAvatar/HapticAvatar_HapticThreadManager.h>
+
+#include <sofa/core/ObjectFactory.h>
+#include <sofa/simulation/AnimateBeginEvent.h>
+
+namespace sofa::HapticAvatar
+{
+
+int HapticAvatar_HapticThreadSettingsClass = core::RegisterObject("Settings of the haptic thread updating the Haptic Avatar devices: base tick rate and real-time scheduling. Each device controller runs every hapticPeriod ticks.")
+    .add< HapticAvatar_HapticThreadSettings >()
+    ;
+
+
+HapticAvatar_HapticThreadSettings::HapticAvatar_HapticThreadSettings()
+    : d_baseRate(initData(&d_baseRate, HAPTIC_BASE_RATE_HZ, "baseRate", "Rate of the haptic thread tick in Hz. A device controller with hapticPeriod n is updated at baseRate / n"))
+    , d_priority(initData(&d_priority, 0, "priority", "SCHED_FIFO priority of the haptic threads, from 1 to 99 (time critical priority on Windows). 0 keeps the default scheduling. Needs CAP_SYS_NICE or an rtprio limit, the default scheduling is kept otherwise"))
+    , d_cpuAffinity(initData(&d_cpuAffinity, "cpuAffinity", "CPUs the haptic threads may run on, for example isolated cores. All the CPUs if empty"))
+    , d_lockMemory(initData(&d_lockMemory, false, "lockMemory", "Lock all the pages of the process in RAM (mlockall) so that the haptic loop never waits for a page fault. Needs CAP_IPC_LOCK or a high enough memlock limit"))
+    , d_prefaultStack(initData(&d_prefaultStack, false, "prefaultStack", "Touch the stack of each haptic thread before its first tick, so that the loop doesn't fault its pages in"))
+    , d_realTimeReport(initData(&d_realTimeReport, "realTimeReport", "Real-time settings achieved by each haptic thread, one line per thread"))
+{
+    this->f_listening.setValue(true);
+
+    d_realTimeReport.setReadOnly(true);
+}
+
+
+void HapticAvatar_HapticThreadSettings::init()
+{
+    d_componentState.setValue(sofa::core::objectmodel::ComponentState::Invalid);
+
+    const float baseRate = d_baseRate.getValue();
+    if (baseRate <= 0.0f)
+    {
+        msg_error() << "baseRate must be positive, got " << baseRate << ". Keeping " << HapticAvatar_HapticThreadManager::getInstance()->getBaseRate() << " Hz.";
+        return;
+    }
+
+    const int priority = d_priority.getValue();
+    if (priority < 0 || priority > 99)
+    {
+        msg_error() << "priority must be between 0 and 99, got " << priority << ".";
+        return;
+    }
+
+    // read by the device controllers in their bwdInit, before they register to the thread
+    HapticAvatar_HapticThreadManager* threadMgr = HapticAvatar_HapticThreadManager::getInstance();
+    threadMgr->setBaseRate(baseRate);
+    msg_info() << "Haptic thread base rate: " << baseRate << " Hz";
+
+    HapticAvatar_RealTimeSettings settings;
+    settings.priority = priority;
+    for (int cpu : d_cpuAffinity.getValue())
+        settings.cpuAffinity.push_back(cpu);
+    settings.lockMemory = d_lockMemory.getValue();
+    settings.prefaultStack = d_prefaultStack.getValue();
+    threadMgr->setRealTimeSettings(settings);
+
+    d_componentState.setValue(sofa::core::objectmodel::ComponentState::Valid);
+}
+
+
+void HapticAvatar_HapticThreadSettings::handleEvent(sofa::core::objectmodel::Event* event)
+{
+    if (!dynamic_cast<sofa::simulation::AnimateBeginEvent*>(event))
+        return;
+
+    // the threads report their settings when they start, after the init of the scene
+    const std::string report = HapticAvatar_HapticThreadManager::getInstance()->getRealTimeReport();
+    if (report != d_realTimeReport.getValue())
+    {
+        d_realTimeReport.setValue(report);
+        if (report.find("refused") != std::string::npos || report.find("not supported") != std::string::npos)
+            msg_warning() << "Real-time settings not all applied:\n" << report;
+    }
+}
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,61 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+
+#include <sofa/core/objectmodel/BaseObject.h>
+
+namespace sofa::HapticAvatar
+{
+
+/**
+* Settings of the haptic thread shared by all the device controllers of the scene, see @sa HapticAvatar_HapticThreadManager.
+* The thread runs at baseRate and each controller is updated every hapticPeriod ticks of it. Without this component the base rate is 1 kHz.
+* The real-time settings (priority, cpuAffinity, lockMemory, prefaultStack) are applied by the haptic thread and the device threads when they start,
+* each one is skipped with a warning in realTimeReport if the process lacks the privileges.
+*/
+class SOFA_HAPTICAVATAR_API HapticAvatar_HapticThreadSettings : public sofa::core::objectmodel::BaseObject
+{
+public:
+    SOFA_CLASS(HapticAvatar_HapticThreadSettings, sofa::core::objectmodel::BaseObject);
+
+    HapticAvatar_HapticThreadSettings();
+
+    void init() override;
+    void handleEvent(sofa::core::objectmodel::Event* event) override;
+
+    /// Rate of the haptic thread tick in Hz
+    Data<float> d_baseRate;
+    /// SCHED_FIFO priority of the haptic threads, 0 for the default scheduling
+    Data<int> d_priority;
+    /// CPUs the haptic threads may run on, all if empty
+    Data<sofa::type::vector<int> > d_cpuAffinity;
+    /// Lock the memory of the process in RAM
+    Data<bool> d_lockMemory;
+    /// Touch the stack of the haptic threads before their first tick
+    Data<bool> d_prefaultStack;
+    /// Real-time settings achieved by each haptic thread
+    Data<std::string> d_realTimeReport;
+};
+
+} // namespace sofa::HapticAvatar
@@ -40,26 +40,20 @@ HapticAvatar_IBoxController::~HapticAvatar_IBoxController()
 void HapticAvatar_IBoxController::initDevice()
 {
     msg_info() << "HapticAvatar_IBoxController::init()";
-    m_HA_driver = new HapticAvatar_DriverIbox(d_portName.getValue());
-
-    if (!m_HA_driver->IsConnected()) {
-        msg_error() << "HapticAvatar_IBoxController driver creation failed";
-        return;
-    }
+    m_HA_driver = new HapticAvatar_DriverIbox(d_portName.getValue(), d_transport.getValue(), getLinkSettings());
+}
 
-    // get identity
-    std::string identity = m_HA_driver->getDeviceType();
-    d_hapticIdentity.setValue(identity);
-    msg_info() << "HapticAvatar_IBoxController identity: '" << identity << "'";
 
+void HapticAvatar_IBoxController::setupDevice()
+{
     for (int i = 0; i < IBOX_NUM_CHANNELS; i++) {
         setLoopGain(i, 2.5f, 0);
     }
 
     // connect to main thread
     auto threadMgr = HapticAvatar_HapticThreadManager::getInstance();
-    threadMgr->registerIBox(this);
     threadMgr->logThread = f_printLog.getValue();
+    threadMgr->registerIBox(this);
 
     return;
 }
@@ -72,6 +66,7 @@ float HapticAvatar_IBoxController::getJawOpeningAngle(int toolId)
 
 void HapticAvatar_IBoxController::setHandleForce(int toolId, float force)
 {
+    std::lock_guard<std::mutex> lock(m_handleForceMutex);
     return m_HA_driver->setForce(toolId, force);
 }
 
@@ -11,6 +11,7 @@
 #include <SofaHapticAvatar/HapticAvatar_BaseDeviceController.h>
 
 #include <sofa/component/controller/Controller.h>
+#include <mutex>
 
 namespace sofa::HapticAvatar
 {
@@ -31,8 +32,10 @@ public:
     HapticAvatar_IBoxController();
     ~HapticAvatar_IBoxController() override;
 
+    /// Latest jaw opening of a tool, read without querying the IBox: the device threads of @sa HapticAvatar_HapticThreadManager must not use its link.
     float getJawOpeningAngle(int toolId);
 
+    /// Queue the force of a handle, sent at the next @sa update. Can be called by the threads of several devices at the same time
     void setHandleForce(int toolId, float force);
 
 	void setLoopGain(int chan, float loopGainP, float loopGainD);
@@ -43,11 +46,15 @@ public:
 
 protected:
     void initDevice() override;
+    void setupDevice() override;
     void clearDevice() override;
     void simulation_updateData() override {}
 
 private:
     HapticAvatar_DriverIbox * m_HA_driver = nullptr;
+
+    /// Serialize the handle forces queued by the device threads, see @sa HapticAvatar_HapticThreadManager
+    std::mutex m_handleForceMutex;
 };
 
 } // namespace sofa::HapticAvatar
@@ -0,0 +1,76 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_LatencyHistogram.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_LatencyHistogram::HapticAvatar_LatencyHistogram()
+    {
+        reset();
+    }
+
+
+    void HapticAvatar_LatencyHistogram::reset()
+    {
+        for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+
+    uint32_t HapticAvatar_LatencyHistogram::getPercentile(float percent) const
+    {
+        // the buckets are counted again rather than using m_count, which may be ahead of them while a value is recorded
+        uint64_t total = 0;
+        for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+            total += m_buckets[i].load(std::memory_order_relaxed);
+        if (total == 0)
+            return 0;
+
+        const uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(double(std::clamp(percent, 0.0f, 100.0f)) * 0.01 * double(total))));
+        uint64_t seen = 0;
+        for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return std::min(bucketHighestValue(i), getMax());
+        }
+        return getMax();
+    }
+
+
+    uint32_t HapticAvatar_LatencyHistogram::bucketHighestValue(int index)
+    {
+        if (index < 2 * LATENCY_HISTOGRAM_SUB_COUNT)
+            return uint32_t(index);
+
+        const int magnitude = index / LATENCY_HISTOGRAM_SUB_COUNT - 1;
+        const uint64_t lowest = uint64_t(index - magnitude * LATENCY_HISTOGRAM_SUB_COUNT) << magnitude;
+        return uint32_t(std::min<uint64_t>(lowest + (uint64_t(1) << magnitude) - 1, UINT32_MAX));
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,97 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <atomic>
+#include <cstdint>
+
+namespace sofa::HapticAvatar
+{
+
+#define LATENCY_HISTOGRAM_SUB_BITS 4 // 16 linear buckets per power of two: a value is known within 1/16 of itself
+#define LATENCY_HISTOGRAM_SUB_COUNT (1 << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_BUCKETS ((33 - LATENCY_HISTOGRAM_SUB_BITS) * LATENCY_HISTOGRAM_SUB_COUNT) // covers the whole uint32 range
+
+    /**
+    * Distribution of a measure (round trip in microseconds, bytes per tick) with a fixed relative precision, as an HDR histogram:
+    * the values below 2*LATENCY_HISTOGRAM_SUB_COUNT have their own bucket, above each power of two is split into LATENCY_HISTOGRAM_SUB_COUNT buckets.
+    * Recording is a few integer operations on a fixed array, no lock and no allocation, so it can stay on in the haptic thread.
+    * Only one thread records, the percentiles can be read from any thread. They cover all the values since the creation or the last @sa reset.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_LatencyHistogram
+    {
+    public:
+        HapticAvatar_LatencyHistogram();
+
+        /// Forget all the values. Must be called by the recording thread, or while nothing is recorded.
+        void reset();
+
+        /// Add a value. Must only be called by one thread.
+        void record(uint32_t value)
+        {
+            std::atomic<uint32_t>& bucket = m_buckets[bucketIndex(value)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (value > m_max.load(std::memory_order_relaxed))
+                m_max.store(value, std::memory_order_relaxed);
+        }
+
+        /// Number of values recorded.
+        uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+
+        /// Highest value recorded, exact.
+        uint32_t getMax() const { return m_max.load(std::memory_order_relaxed); }
+
+        /** Value below which a percentage of the recorded values are.
+        * @param {float} percent: between 0 and 100, e.g. 50 for the median or 99.
+        * @returns {uint} the highest value of the bucket holding the percentile, never above @sa getMax. 0 if nothing was recorded.
+        */
+        uint32_t getPercentile(float percent) const;
+
+        /// Bucket of a value, see the class description.
+        static int bucketIndex(uint32_t value)
+        {
+            if (value < 2 * LATENCY_HISTOGRAM_SUB_COUNT)
+                return int(value);
+
+            // number of low bits dropped to keep LATENCY_HISTOGRAM_SUB_BITS + 1 significant bits
+            uint32_t v = value >> (LATENCY_HISTOGRAM_SUB_BITS + 1);
+            int magnitude = 1;
+            if (v >> 16) { v >>= 16; magnitude += 16; }
+            if (v >> 8) { v >>= 8; magnitude += 8; }
+            if (v >> 4) { v >>= 4; magnitude += 4; }
+            if (v >> 2) { v >>= 2; magnitude += 2; }
+            if (v >> 1) { magnitude += 1; }
+            return magnitude * LATENCY_HISTOGRAM_SUB_COUNT + int(value >> magnitude);
+        }
+
+        /// Highest value falling into a bucket.
+        static uint32_t bucketHighestValue(int index);
+
+    private:
+        std::atomic<uint32_t> m_buckets[LATENCY_HISTOGRAM_BUCKETS];
+        std::atomic<uint64_t> m_count;
+        std::atomic<uint32_t> m_max;
+    };
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,85 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_LinkClock.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_LinkClock::HapticAvatar_LinkClock()
+    {
+        reset();
+    }
+
+
+    void HapticAvatar_LinkClock::reset()
+    {
+        m_next = 0;
+        m_count = 0;
+        m_latencyUs.store(0.0f, std::memory_order_relaxed);
+        m_minRoundTripUs.store(0.0f, std::memory_order_relaxed);
+        m_jitterUs.store(0.0f, std::memory_order_relaxed);
+    }
+
+
+    void HapticAvatar_LinkClock::addRoundTrip(int64_t sendNs, int64_t receiveNs)
+    {
+        const int64_t roundTripNs = std::max<int64_t>(0, receiveNs - sendNs);
+        m_roundTripsNs[m_next] = roundTripNs;
+        m_next = (m_next + 1) % LINK_CLOCK_WINDOW;
+        m_count = std::min(m_count + 1, LINK_CLOCK_WINDOW);
+
+        int64_t minNs = roundTripNs;
+        for (int i = 0; i < m_count; i++)
+            minNs = std::min(minNs, m_roundTripsNs[i]);
+
+        const float minUs = float(minNs) * 0.001f;
+        const float deviationUs = float(roundTripNs - minNs) * 0.001f;
+        const float jitterUs = m_jitterUs.load(std::memory_order_relaxed);
+
+        m_minRoundTripUs.store(minUs, std::memory_order_relaxed);
+        m_jitterUs.store(m_count == 1 ? deviationUs : jitterUs + (deviationUs - jitterUs) / 16.0f, std::memory_order_relaxed);
+        updateLatency();
+    }
+
+
+    void HapticAvatar_LinkClock::setDeviceLoopPeriod(float periodMs)
+    {
+        if (!std::isfinite(periodMs) || periodMs < 0.0f)
+            return;
+
+        m_deviceLoopPeriodUs = periodMs * 1.0e3f;
+        updateLatency();
+    }
+
+
+    void HapticAvatar_LinkClock::updateLatency()
+    {
+        if (m_count == 0)
+            return;
+
+        m_latencyUs.store(0.5f * (m_minRoundTripUs.load(std::memory_order_relaxed) + m_deviceLoopPeriodUs), std::memory_order_relaxed);
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,80 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <atomic>
+#include <cstdint>
+
+namespace sofa::HapticAvatar
+{
+
+#define LINK_CLOCK_WINDOW 64 // number of round trips in which the fastest one is searched
+
+    /**
+    * Estimate of the age of the values received from a device, to put them on the host clock.
+    * The device doesn't send its own time: a value is sampled somewhere between the host sending the request and receiving the reply.
+    * As in NTP, the fastest recent round trip is the one with the least queuing, half of it is taken as the one-way latency.
+    * The device samples once per loop, so half of its loop period (GET_CURRENT_DELTA_T) is added.
+    * Updated by the haptic thread, the estimates can be read from any thread.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_LinkClock
+    {
+    public:
+        HapticAvatar_LinkClock();
+
+        /// Forget all the round trips, e.g. after the link is resynchronised.
+        void reset();
+
+        /** Add a round trip.
+        * @param {int64} sendNs: host time when the request was written, in ns.
+        * @param {int64} receiveNs: host time when its reply was complete, in ns.
+        */
+        void addRoundTrip(int64_t sendNs, int64_t receiveNs);
+
+        /// Set the loop period of the device in milliseconds, as returned by GET_CURRENT_DELTA_T.
+        void setDeviceLoopPeriod(float periodMs);
+
+        /// Host time at which the device most likely sampled the values of a reply received at receiveNs.
+        int64_t toSampleTime(int64_t receiveNs) const { return receiveNs - int64_t(m_latencyUs.load(std::memory_order_relaxed) * 1000.0f); }
+
+        /// Estimated time between the device sampling a value and the host receiving it, in microseconds.
+        float getLatencyUs() const { return m_latencyUs.load(std::memory_order_relaxed); }
+        /// Fastest round trip in the window, in microseconds.
+        float getMinRoundTripUs() const { return m_minRoundTripUs.load(std::memory_order_relaxed); }
+        /// Mean deviation of the round trips from the fastest one, in microseconds.
+        float getJitterUs() const { return m_jitterUs.load(std::memory_order_relaxed); }
+
+    private:
+        void updateLatency();
+
+        int64_t m_roundTripsNs[LINK_CLOCK_WINDOW];
+        int m_next = 0;
+        int m_count = 0;
+        float m_deviceLoopPeriodUs = 0.0f;
+
+        std::atomic<float> m_latencyUs;
+        std::atomic<float> m_minRoundTripUs;
+        std::atomic<float> m_jitterUs;
+    };
+
+} // namespace sofa::HapticAvatar
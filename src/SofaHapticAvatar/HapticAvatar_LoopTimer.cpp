@@ -0,0 +1,138 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_LoopTimer.h>
+#include <chrono>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define LOOP_TIMER_CPU_RELAX() _mm_pause()
+#else
+#define LOOP_TIMER_CPU_RELAX() std::atomic_signal_fence(std::memory_order_seq_cst)
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <ctime>
+#include <sys/prctl.h>
+#endif
+
+#if defined(WIN32) && !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_LoopTimer::HapticAvatar_LoopTimer(int64_t periodNs, int64_t spinNs)
+        : m_periodNs(periodNs > 0 ? periodNs : 1)
+        , m_spinNs(spinNs > 0 ? spinNs : 0)
+    {
+#ifdef WIN32
+        // the high resolution timers (Windows 10 1803 and later) don't depend on the system timer resolution of 1 to 15.6 ms
+        m_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (m_timer == NULL)
+            m_timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+#endif
+    }
+
+
+    HapticAvatar_LoopTimer::~HapticAvatar_LoopTimer()
+    {
+#ifdef WIN32
+        if (m_timer != NULL)
+            CloseHandle(m_timer);
+#endif
+    }
+
+
+    void HapticAvatar_LoopTimer::start()
+    {
+#ifdef __linux__
+        // the default timer slack of 50 us would delay every wake up past the spin margin
+        prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+#endif
+        m_deadlineNs = nowNs();
+    }
+
+
+    bool HapticAvatar_LoopTimer::wait()
+    {
+        m_deadlineNs += m_periodNs;
+        int64_t now = nowNs();
+        if (now >= m_deadlineNs)
+        {
+            // start the next loop at once, from the last deadline passed: the phase is kept and no loop is run twice to catch up
+            m_deadlineNs += ((now - m_deadlineNs) / m_periodNs) * m_periodNs;
+            m_overrunCounter.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (m_deadlineNs - now > m_spinNs)
+            sleepUntil(m_deadlineNs - m_spinNs);
+
+        // the sleep may end a bit late or early, the end of the period is waited on the clock
+        while ((now = nowNs()) < m_deadlineNs)
+            LOOP_TIMER_CPU_RELAX();
+
+        const int64_t latenessNs = now - m_deadlineNs;
+        if (latenessNs > m_maxLatenessNs.load(std::memory_order_relaxed))
+            m_maxLatenessNs.store(latenessNs, std::memory_order_relaxed);
+        return true;
+    }
+
+
+    int64_t HapticAvatar_LoopTimer::nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    void HapticAvatar_LoopTimer::sleepUntil(int64_t timeNs)
+    {
+#if defined(__linux__)
+        // steady_clock is CLOCK_MONOTONIC: the deadline can be given as an absolute time, the sleep doesn't drift if the thread is preempted before it
+        const timespec deadline = { time_t(timeNs / 1000000000), long(timeNs % 1000000000) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {}
+#elif defined(WIN32)
+        const int64_t remainingNs = timeNs - nowNs();
+        if (remainingNs <= 0)
+            return;
+
+        if (m_timer == NULL)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(remainingNs));
+            return;
+        }
+
+        // the absolute due times of the waitable timers are on the wall clock, the remaining time is given instead (negative, in 100 ns units)
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = -(remainingNs / 100);
+        if (SetWaitableTimer(m_timer, &dueTime, 0, NULL, NULL, FALSE))
+            WaitForSingleObject(m_timer, INFINITE);
+#else
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(timeNs))));
+#endif
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,93 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <atomic>
+#include <cstdint>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+namespace sofa::HapticAvatar
+{
+
+#define LOOP_TIMER_SPIN_US 50 // default time spent spinning before a deadline, covers the wake up latency of the sleep
+
+    /**
+    * Periodic timer of the haptic loop. The deadlines are absolute, start + k * period, so the loop rate doesn't drift
+    * whatever the time spent in the loop. The thread sleeps until a little before each deadline (clock_nanosleep with TIMER_ABSTIME on Linux,
+    * a high resolution waitable timer on Windows) and only spins the last spin margin, instead of keeping a core busy for the whole period.
+    * A loop longer than the period is an overrun: the next loop starts at once and the missed deadlines are skipped, they are never caught up in a burst.
+    * Must be used by a single thread, the statistics can be read from any thread.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_LoopTimer
+    {
+    public:
+        /** @param {int64} periodNs: loop period in ns.
+        * @param {int64} spinNs: time spent spinning before each deadline in ns, 0 to only sleep.
+        */
+        HapticAvatar_LoopTimer(int64_t periodNs, int64_t spinNs = int64_t(LOOP_TIMER_SPIN_US) * 1000);
+
+        ~HapticAvatar_LoopTimer();
+
+        /// Start the deadlines from now. To be called by the thread of the loop, before its first iteration.
+        void start();
+
+        /** Wait until the next deadline.
+        * @returns {bool} false if the deadline was already passed: the loop overran its period and the next one starts at once.
+        */
+        bool wait();
+
+        /** Change the loop period. The deadlines keep their phase: the next one is the last deadline plus the new period.
+        * @param {int64} periodNs: loop period in ns.
+        */
+        void setPeriod(int64_t periodNs) { m_periodNs = periodNs > 0 ? periodNs : 1; }
+        int64_t getPeriodNs() const { return m_periodNs; }
+
+        /// Number of loops longer than the period.
+        unsigned int getOverrunCounter() const { return m_overrunCounter.load(std::memory_order_relaxed); }
+
+        /// Highest delay between a deadline and the return of @sa wait, in ns, overruns excluded.
+        int64_t getMaxLatenessNs() const { return m_maxLatenessNs.load(std::memory_order_relaxed); }
+
+        /// Current time of the clock of the deadlines, in ns. Same clock as @sa HapticAvatar_DriverBase::hostTimeNs
+        static int64_t nowNs();
+
+    private:
+        /// Sleep until an absolute time of @sa nowNs, may wake up a bit later.
+        void sleepUntil(int64_t timeNs);
+
+        int64_t m_periodNs;
+        int64_t m_spinNs;
+        int64_t m_deadlineNs = 0;
+
+        std::atomic<unsigned int> m_overrunCounter = 0;
+        std::atomic<int64_t> m_maxLatenessNs = 0;
+
+#ifdef WIN32
+        HANDLE m_timer = nullptr;
+#endif
+    };
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,251 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_LoopbackTransport.h>
+#include <sofa/helper/logging/Messaging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+namespace sofa::HapticAvatar
+{
+
+    /// One direction of a loopback channel: a fixed size byte ring protected by a mutex
+    struct LoopbackPipe
+    {
+        std::mutex mutex;
+        std::condition_variable readable;
+        std::condition_variable writable;
+        char data[LOOPBACK_BUFFER_SIZE];
+        size_t head = 0; // next byte to read
+        size_t size = 0; // number of bytes stored
+    };
+
+    struct HapticAvatar_LoopbackTransport::Channel
+    {
+        LoopbackPipe toDevice;
+        LoopbackPipe toHost;
+        bool deviceAttached = false;
+        std::atomic<bool> deviceDetached = false; // the device side closed, the channel can't be attached again
+        std::atomic<bool> hostClosed = false;
+    };
+
+
+    namespace
+    {
+        std::mutex s_channelsMutex;
+        std::map<std::string, std::weak_ptr<HapticAvatar_LoopbackTransport::Channel> > s_channels;
+
+        int pipeRead(LoopbackPipe& pipe, char* buffer, unsigned int nbChar)
+        {
+            std::lock_guard<std::mutex> lock(pipe.mutex);
+            size_t n = std::min(size_t(nbChar), pipe.size);
+            for (size_t i = 0; i < n; i++)
+            {
+                buffer[i] = pipe.data[pipe.head];
+                pipe.head = (pipe.head + 1) % LOOPBACK_BUFFER_SIZE;
+            }
+            pipe.size -= n;
+            if (n > 0)
+                pipe.writable.notify_one();
+            return int(n);
+        }
+
+        void pipeNotifyClosed(LoopbackPipe& pipe)
+        {
+            std::lock_guard<std::mutex> lock(pipe.mutex);
+            pipe.readable.notify_all();
+            pipe.writable.notify_all();
+        }
+
+        bool pipeWrite(LoopbackPipe& pipe, const char* buffer, unsigned int nbChar)
+        {
+            std::unique_lock<std::mutex> lock(pipe.mutex);
+            for (unsigned int i = 0; i < nbChar; i++)
+            {
+                if (pipe.size == LOOPBACK_BUFFER_SIZE)
+                {
+                    pipe.readable.notify_one();
+                    // nobody is reading the other end
+                    if (!pipe.writable.wait_for(lock, std::chrono::milliseconds(100), [&pipe]() { return pipe.size < LOOPBACK_BUFFER_SIZE; }))
+                        return false;
+                }
+                pipe.data[(pipe.head + pipe.size) % LOOPBACK_BUFFER_SIZE] = buffer[i];
+                pipe.size++;
+            }
+            pipe.readable.notify_one();
+            return true;
+        }
+    }
+
+
+    HapticAvatar_LoopbackTransport::HapticAvatar_LoopbackTransport(const std::string& channelName)
+        : HapticAvatar_Transport(channelName)
+    {
+
+    }
+
+
+    HapticAvatar_LoopbackTransport::HapticAvatar_LoopbackTransport(const std::string& channelName, std::shared_ptr<Channel> channel)
+        : HapticAvatar_Transport(channelName)
+        , m_channel(channel)
+        , m_deviceSide(true)
+    {
+        m_open = true;
+    }
+
+
+    HapticAvatar_LoopbackTransport::~HapticAvatar_LoopbackTransport()
+    {
+        close();
+    }
+
+
+    HapticAvatar_LoopbackTransport* HapticAvatar_LoopbackTransport::connectDeviceSide(const std::string& channelName)
+    {
+        std::lock_guard<std::mutex> lock(s_channelsMutex);
+        auto it = s_channels.find(channelName);
+        if (it == s_channels.end())
+            return nullptr;
+
+        std::shared_ptr<Channel> channel = it->second.lock();
+        if (!channel || channel->deviceAttached || channel->deviceDetached)
+            return nullptr;
+
+        channel->deviceAttached = true;
+        return new HapticAvatar_LoopbackTransport(channelName, channel);
+    }
+
+
+    bool HapticAvatar_LoopbackTransport::open()
+    {
+        if (m_open)
+            return true;
+
+        std::lock_guard<std::mutex> lock(s_channelsMutex);
+        auto it = s_channels.find(m_portName);
+        if (it != s_channels.end() && !it->second.expired())
+        {
+            msg_error("HapticAvatar_LoopbackTransport") << "Loopback channel '" << m_portName << "' is already in use.";
+            return false;
+        }
+
+        m_channel = std::make_shared<Channel>();
+        s_channels[m_portName] = m_channel;
+        m_open = true;
+        return true;
+    }
+
+
+    void HapticAvatar_LoopbackTransport::close()
+    {
+        if (!m_open)
+            return;
+
+        m_open = false;
+        {
+            std::lock_guard<std::mutex> lock(s_channelsMutex);
+            if (m_deviceSide)
+            {
+                m_channel->deviceAttached = false;
+                m_channel->deviceDetached = true;
+            }
+            else
+            {
+                m_channel->hostClosed = true;
+                s_channels.erase(m_portName);
+            }
+        }
+
+        // wake up the other side if it waits for bytes
+        pipeNotifyClosed(m_channel->toDevice);
+        pipeNotifyClosed(m_channel->toHost);
+        m_channel.reset();
+    }
+
+
+    int HapticAvatar_LoopbackTransport::read(char* buffer, unsigned int nbChar)
+    {
+        if (!m_open)
+            return -1;
+
+        // the bytes sent before the other side closed are still delivered
+        int bytesRead = pipeRead(m_deviceSide ? m_channel->toDevice : m_channel->toHost, buffer, nbChar);
+        if (bytesRead == 0 && peerClosed())
+            return -1;
+        return bytesRead;
+    }
+
+
+    bool HapticAvatar_LoopbackTransport::write(const char* buffer, unsigned int nbChar)
+    {
+        if (!m_open || peerClosed())
+            return false;
+        return pipeWrite(m_deviceSide ? m_channel->toHost : m_channel->toDevice, buffer, nbChar);
+    }
+
+
+    int HapticAvatar_LoopbackTransport::bytesAvailable()
+    {
+        if (!m_open)
+            return 0;
+        LoopbackPipe& pipe = m_deviceSide ? m_channel->toDevice : m_channel->toHost;
+        std::lock_guard<std::mutex> lock(pipe.mutex);
+        return int(pipe.size);
+    }
+
+
+    bool HapticAvatar_LoopbackTransport::waitReadable(int timeoutUs)
+    {
+        if (!m_open)
+            return false;
+        LoopbackPipe& pipe = m_deviceSide ? m_channel->toDevice : m_channel->toHost;
+        std::unique_lock<std::mutex> lock(pipe.mutex);
+        // a closed peer is reported readable, the next read tells the link is broken
+        return pipe.readable.wait_for(lock, std::chrono::microseconds(timeoutUs), [this, &pipe]() { return pipe.size > 0 || peerClosed(); });
+    }
+
+
+    bool HapticAvatar_LoopbackTransport::peerClosed() const
+    {
+        return m_deviceSide ? m_channel->hostClosed : m_channel->deviceDetached;
+    }
+
+
+    void HapticAvatar_LoopbackTransport::flush()
+    {
+        if (!m_open)
+            return;
+        for (LoopbackPipe* pipe : { &m_channel->toDevice, &m_channel->toHost })
+        {
+            std::lock_guard<std::mutex> lock(pipe->mutex);
+            pipe->head = 0;
+            pipe->size = 0;
+            pipe->writable.notify_all();
+        }
+    }
+
+} // namespace sofa::HapticAvatar
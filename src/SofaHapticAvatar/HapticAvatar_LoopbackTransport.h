@@ -0,0 +1,74 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
+#include <memory>
+
+namespace sofa::HapticAvatar
+{
+
+#define LOOPBACK_BUFFER_SIZE 65536
+
+    /**
+    * In-memory transport. The host side opens a named channel (portName), a device emulator then attaches
+    * to the other end with @sa connectDeviceSide. Used to run the full protocol path without hardware.
+    * Closing one side breaks the link for the other side, as an unplugged cable would: a channel is used by a single
+    * host and device session, the host reopens a new channel to reconnect.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_LoopbackTransport : public HapticAvatar_Transport
+    {
+    public:
+        HapticAvatar_LoopbackTransport(const std::string& channelName);
+
+        ~HapticAvatar_LoopbackTransport() override;
+
+        /** Create the device side endpoint of a channel opened by a host side transport.
+        * @param {string} channelName: name given to the host side transport.
+        * @returns {HapticAvatar_LoopbackTransport*} an opened transport or nullptr if the channel does not exist.
+        */
+        static HapticAvatar_LoopbackTransport* connectDeviceSide(const std::string& channelName);
+
+        /// HapticAvatar_Transport api
+        ///{
+        bool open() override;
+        void close() override;
+        int read(char* buffer, unsigned int nbChar) override;
+        bool write(const char* buffer, unsigned int nbChar) override;
+        int bytesAvailable() override;
+        bool waitReadable(int timeoutUs) override;
+        void flush() override;
+        ///}
+
+        struct Channel;
+
+    private:
+        HapticAvatar_LoopbackTransport(const std::string& channelName, std::shared_ptr<Channel> channel);
+
+        /// True if the other side closed the channel
+        bool peerClosed() const;
+
+        std::shared_ptr<Channel> m_channel;
+        bool m_deviceSide = false;
+    };
+
+} // namespace sofa::HapticAvatar
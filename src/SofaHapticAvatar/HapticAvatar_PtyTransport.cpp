@@ -0,0 +1,190 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_PtyTransport.h>
+#include <sofa/helper/logging/Messaging.h>
+
+#ifndef WIN32
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_PtyTransport::HapticAvatar_PtyTransport(const std::string& portName)
+        : HapticAvatar_Transport(portName)
+    {
+
+    }
+
+
+    HapticAvatar_PtyTransport::~HapticAvatar_PtyTransport()
+    {
+        close();
+    }
+
+
+    bool HapticAvatar_PtyTransport::open()
+    {
+#ifdef WIN32
+        msg_error("HapticAvatar_PtyTransport") << "Pseudo-terminal transport is not available on Windows.";
+        return false;
+#else
+        m_fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (m_fd < 0 || grantpt(m_fd) != 0 || unlockpt(m_fd) != 0)
+        {
+            msg_error("HapticAvatar_PtyTransport") << "Failed to create pseudo-terminal: " << strerror(errno);
+            if (m_fd >= 0)
+                ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+        fcntl(m_fd, F_SETFD, FD_CLOEXEC);
+
+        // Raw mode so that '\n' and control bytes go through unchanged
+        termios tty;
+        if (tcgetattr(m_fd, &tty) == 0)
+        {
+            cfmakeraw(&tty);
+            tcsetattr(m_fd, TCSANOW, &tty);
+        }
+
+        m_slaveName = ptsname(m_fd);
+        m_linkCreated = false;
+        if (!m_portName.empty())
+        {
+            // only replace a stale symbolic link (ex: left by a crashed run), never a file or device the portName may point to
+            struct stat info;
+            bool pathFree = true;
+            if (::lstat(m_portName.c_str(), &info) == 0)
+            {
+                if (S_ISLNK(info.st_mode))
+                    ::unlink(m_portName.c_str());
+                else
+                    pathFree = false;
+            }
+
+            if (!pathFree)
+                msg_warning("HapticAvatar_PtyTransport") << "Could not create link " << m_portName << " to " << m_slaveName << ": the path exists and is not a symbolic link, it is left untouched.";
+            else if (::symlink(m_slaveName.c_str(), m_portName.c_str()) != 0)
+                msg_warning("HapticAvatar_PtyTransport") << "Could not create link " << m_portName << " to " << m_slaveName << ": " << strerror(errno);
+            else
+                m_linkCreated = true;
+        }
+
+        msg_info("HapticAvatar_PtyTransport") << "Device side of the link available at: " << m_slaveName;
+        m_open = true;
+        return true;
+#endif
+    }
+
+
+    void HapticAvatar_PtyTransport::close()
+    {
+        if (!m_open)
+            return;
+
+        m_open = false;
+#ifndef WIN32
+        ::close(m_fd);
+        m_fd = -1;
+
+        // remove the link only if it is still the one created by open
+        if (m_linkCreated)
+        {
+            char target[PATH_MAX];
+            ssize_t size = ::readlink(m_portName.c_str(), target, sizeof(target) - 1);
+            if (size > 0 && std::string(target, size) == m_slaveName)
+                ::unlink(m_portName.c_str());
+            m_linkCreated = false;
+        }
+#endif
+        m_slaveName.clear();
+    }
+
+
+    int HapticAvatar_PtyTransport::read(char* buffer, unsigned int nbChar)
+    {
+#ifdef WIN32
+        SOFA_UNUSED(buffer);
+        SOFA_UNUSED(nbChar);
+        return -1;
+#else
+        int n = fdRead(m_fd, buffer, nbChar);
+        // EIO only means that no process has the slave side open yet, which is not an error for the master
+        if (n < 0 && errno == EIO)
+            return 0;
+        return n;
+#endif
+    }
+
+
+    bool HapticAvatar_PtyTransport::write(const char* buffer, unsigned int nbChar)
+    {
+#ifdef WIN32
+        SOFA_UNUSED(buffer);
+        SOFA_UNUSED(nbChar);
+        return false;
+#else
+        return fdWrite(m_fd, buffer, nbChar);
+#endif
+    }
+
+
+    int HapticAvatar_PtyTransport::bytesAvailable()
+    {
+#ifdef WIN32
+        return 0;
+#else
+        return fdBytesAvailable(m_fd);
+#endif
+    }
+
+
+    bool HapticAvatar_PtyTransport::waitReadable(int timeoutUs)
+    {
+#ifdef WIN32
+        SOFA_UNUSED(timeoutUs);
+        return false;
+#else
+        return fdWaitReadable(m_fd, timeoutUs);
+#endif
+    }
+
+
+    void HapticAvatar_PtyTransport::flush()
+    {
+#ifndef WIN32
+        tcflush(m_fd, TCIOFLUSH);
+#endif
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,64 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
+
+namespace sofa::HapticAvatar
+{
+
+    /**
+    * Pseudo-terminal transport (POSIX only). The driver owns the master side, the slave side behaves like
+    * a real tty and can be opened by a device emulator or bridged to a real device (ex: with socat).
+    * If portName is not empty, a symbolic link with that name is created to the slave device. An existing symbolic link is replaced,
+    * any other file at that path is left untouched. The link is removed at close if it still points to the slave device.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_PtyTransport : public HapticAvatar_Transport
+    {
+    public:
+        HapticAvatar_PtyTransport(const std::string& portName);
+
+        ~HapticAvatar_PtyTransport() override;
+
+        /// HapticAvatar_Transport api
+        ///{
+        bool open() override;
+        void close() override;
+        int read(char* buffer, unsigned int nbChar) override;
+        bool write(const char* buffer, unsigned int nbChar) override;
+        int bytesAvailable() override;
+        bool waitReadable(int timeoutUs) override;
+        void flush() override;
+        ///}
+
+        /// Path of the device side of the pseudo-terminal (ex: /dev/pts/4). Empty if not opened.
+        const std::string& getSlaveName() const { return m_slaveName; }
+
+    private:
+        /// File descriptor of the master side
+        int m_fd = -1;
+        std::string m_slaveName;
+        /// True if open created the symbolic link portName
+        bool m_linkCreated = false;
+    };
+
+} // namespace sofa::HapticAvatar
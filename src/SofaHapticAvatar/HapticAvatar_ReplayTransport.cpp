@@ -0,0 +1,188 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_ReplayTransport.h>
+#include <sofa/helper/logging/Messaging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_ReplayTransport::HapticAvatar_ReplayTransport(const std::string& fileName, bool realTime)
+        : HapticAvatar_Transport(fileName)
+        , m_realTime(realTime)
+    {
+
+    }
+
+
+    HapticAvatar_ReplayTransport::~HapticAvatar_ReplayTransport()
+    {
+        close();
+    }
+
+
+    bool HapticAvatar_ReplayTransport::open()
+    {
+        if (!m_reader.open(m_portName))
+            return false;
+
+        m_mismatchCount = 0;
+        m_finished = false;
+        m_recordOffset = 0;
+        nextRecord();
+
+        m_startTime = std::chrono::steady_clock::now() - std::chrono::nanoseconds(m_record.timeNs);
+        m_open = true;
+        return true;
+    }
+
+
+    void HapticAvatar_ReplayTransport::close()
+    {
+        if (m_open && m_mismatchCount > 0)
+            msg_warning("HapticAvatar_ReplayTransport") << "Replay of: '" << m_portName << "' differs from the capture on " << m_mismatchCount << " written bytes.";
+
+        m_reader.close();
+        m_finished = true;
+        m_open = false;
+    }
+
+
+    bool HapticAvatar_ReplayTransport::setBaudRate(int baudRate)
+    {
+        // the capture already holds the bytes exchanged at the negotiated rate
+        SOFA_UNUSED(baudRate);
+        return true;
+    }
+
+
+    bool HapticAvatar_ReplayTransport::nextRecord()
+    {
+        m_recordOffset = 0;
+        if (!m_reader.next(m_record))
+        {
+            m_finished = true;
+            return false;
+        }
+        return true;
+    }
+
+
+    bool HapticAvatar_ReplayTransport::incomingReady()
+    {
+        if (m_finished || m_record.direction != HapticAvatar_CaptureDirection::Incoming)
+            return false;
+
+        if (m_realTime && std::chrono::steady_clock::now() < m_startTime + std::chrono::nanoseconds(m_record.timeNs))
+            return false;
+
+        return true;
+    }
+
+
+    int HapticAvatar_ReplayTransport::read(char* buffer, unsigned int nbChar)
+    {
+        if (!m_open)
+            return -1;
+
+        // deliver the contiguous device bytes available now, as a real link would coalesce them
+        unsigned int bytesRead = 0;
+        while (bytesRead < nbChar && incomingReady())
+        {
+            unsigned int n = std::min(nbChar - bytesRead, m_record.size - m_recordOffset);
+            memcpy(buffer + bytesRead, m_record.data + m_recordOffset, n);
+            bytesRead += n;
+            m_recordOffset += n;
+            if (m_recordOffset == m_record.size)
+                nextRecord();
+        }
+
+        return int(bytesRead);
+    }
+
+
+    bool HapticAvatar_ReplayTransport::write(const char* buffer, unsigned int nbChar)
+    {
+        if (!m_open)
+            return false;
+
+        unsigned int bytesSend = 0;
+        while (bytesSend < nbChar)
+        {
+            // device bytes not read by the driver before this write are dropped, as a flush would
+            while (!m_finished && m_record.direction == HapticAvatar_CaptureDirection::Incoming)
+                nextRecord();
+
+            if (m_finished)
+            {
+                m_mismatchCount += nbChar - bytesSend;
+                return true;
+            }
+
+            unsigned int n = std::min(nbChar - bytesSend, m_record.size - m_recordOffset);
+            for (unsigned int i = 0; i < n; ++i)
+            {
+                if (buffer[bytesSend + i] != m_record.data[m_recordOffset + i])
+                    m_mismatchCount++;
+            }
+            bytesSend += n;
+            m_recordOffset += n;
+            if (m_recordOffset == m_record.size)
+            {
+                // pace the device bytes from the host writes, so the device keeps its captured reply delay whatever the host timing
+                m_startTime = std::chrono::steady_clock::now() - std::chrono::nanoseconds(m_record.timeNs);
+                nextRecord();
+            }
+        }
+
+        return true;
+    }
+
+
+    int HapticAvatar_ReplayTransport::bytesAvailable()
+    {
+        if (!incomingReady())
+            return 0;
+        return int(m_record.size - m_recordOffset);
+    }
+
+
+    bool HapticAvatar_ReplayTransport::waitReadable(int timeoutUs)
+    {
+        if (incomingReady())
+            return true;
+
+        // nothing will come until the driver writes the next command or the capture is over
+        if (!m_realTime || m_finished || m_record.direction != HapticAvatar_CaptureDirection::Incoming)
+            return false;
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+        const auto recordTime = m_startTime + std::chrono::nanoseconds(m_record.timeNs);
+        std::this_thread::sleep_until(std::min(deadline, recordTime));
+        return incomingReady();
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,82 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
+#include <SofaHapticAvatar/HapticAvatar_CaptureLog.h>
+#include <chrono>
+
+namespace sofa::HapticAvatar
+{
+
+    /**
+    * Transport playing back a log recorded by @sa HapticAvatar_CaptureTransport instead of talking to a device (portName is the log path).
+    * The device bytes of the log are delivered in order, each one only once the bytes the host wrote before it in the
+    * capture have been written again, so the driver follows the exact same path as during the capture.
+    * Written bytes are compared with the capture and differences are counted, see @sa getMismatchCount.
+    * In real time mode the device bytes are delivered with the delay they had after the last host write in the capture,
+    * otherwise as fast as the driver reads them.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_ReplayTransport : public HapticAvatar_Transport
+    {
+    public:
+        HapticAvatar_ReplayTransport(const std::string& fileName, bool realTime);
+
+        ~HapticAvatar_ReplayTransport() override;
+
+        /// HapticAvatar_Transport api
+        ///{
+        bool open() override;
+        void close() override;
+        bool setBaudRate(int baudRate) override;
+        int read(char* buffer, unsigned int nbChar) override;
+        bool write(const char* buffer, unsigned int nbChar) override;
+        int bytesAvailable() override;
+        bool waitReadable(int timeoutUs) override;
+        ///}
+
+        /// Number of written bytes which differ from the capture.
+        unsigned int getMismatchCount() const { return m_mismatchCount; }
+
+        /// Returns true once all the records of the capture have been played.
+        bool isFinished() const { return m_finished; }
+
+    protected:
+        /// Move to the next record. @returns false at the end of the log.
+        bool nextRecord();
+
+        /// Returns true if the current record holds device bytes which can be delivered now.
+        bool incomingReady();
+
+    private:
+        HapticAvatar_CaptureReader m_reader;
+        HapticAvatar_CaptureRecord m_record;
+        unsigned int m_recordOffset = 0; // bytes of the current record already consumed
+        bool m_finished = true;
+        bool m_realTime = true;
+        unsigned int m_mismatchCount = 0;
+
+        /// Host time matching the start of the capture, moved at each write to follow the replay pace
+        std::chrono::steady_clock::time_point m_startTime;
+    };
+
+} // namespace sofa::HapticAvatar
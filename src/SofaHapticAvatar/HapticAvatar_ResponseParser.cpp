@@ -0,0 +1,263 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_ResponseParser.h>
+#include <SofaHapticAvatar/HapticAvatar_BinaryProtocol.h>
+#include <charconv>
+
+namespace sofa::HapticAvatar
+{
+
+    namespace
+    {
+        bool isNumberChar(char c)
+        {
+            return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+        }
+
+        bool isSpace(char c)
+        {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+    }
+
+
+    void HapticAvatar_ResponseParser::beginFrame(int nbValues)
+    {
+        // the replies still to skip come first, the frame starts once they are consumed
+        if (m_state != State::Discard)
+            m_state = (nbValues > 0) ? State::InFrame : State::Idle;
+
+        m_expected = nbValues < MAX_FRAME_VALUES ? nbValues : MAX_FRAME_VALUES;
+        m_count = 0;
+    }
+
+
+    void HapticAvatar_ResponseParser::skipFrames(int nbFrames)
+    {
+        if (nbFrames <= 0)
+        {
+            reset();
+            return;
+        }
+
+        m_state = State::Discard;
+        m_discardIsError = false;
+        m_framesToSkip = nbFrames;
+        m_expected = 0;
+        m_count = 0;
+    }
+
+
+    void HapticAvatar_ResponseParser::reset()
+    {
+        m_state = State::Idle;
+        m_framesToSkip = 0;
+        m_count = 0;
+    }
+
+
+    bool HapticAvatar_ResponseParser::pushToken(const char* token, int tokenLen)
+    {
+        float value = 0.0f;
+        auto res = std::from_chars(token, token + tokenLen, value);
+        if (res.ec != std::errc() || res.ptr != token + tokenLen)
+            return false;
+
+        m_values[m_count++] = value;
+        return true;
+    }
+
+
+    bool HapticAvatar_ResponseParser::parseLine(const HapticAvatar_RingView& line)
+    {
+        // only the tokens are copied, a token may wrap around the end of the ring
+        char token[MAX_TOKEN_LEN];
+        int tokenLen = 0;
+        m_count = 0;
+        for (unsigned int i = 0; i < line.size(); i++)
+        {
+            const char c = line[i];
+            if (isNumberChar(c))
+            {
+                // an extra value after the expected ones means we are not aligned on the replies
+                if (m_count == m_expected || tokenLen == MAX_TOKEN_LEN)
+                    return false;
+                token[tokenLen++] = c;
+            }
+            else if (isSpace(c))
+            {
+                if (tokenLen > 0 && !pushToken(token, tokenLen))
+                    return false;
+                tokenLen = 0;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return m_count == m_expected;
+    }
+
+
+    HapticAvatar_ResponseParser::Status HapticAvatar_ResponseParser::parse(HapticAvatar_RingBuffer& ring)
+    {
+        if (m_state == State::Idle)
+            return Status::NeedMoreData;
+
+        if (m_binaryMode)
+            return parseBinary(ring);
+
+        // a reply is only parsed once its whole line is received
+        HapticAvatar_RingView line;
+        while (ring.peekLine(line))
+        {
+            if (m_state == State::Discard)
+            {
+                ring.consume(line.size());
+                if (--m_framesToSkip > 0)
+                    continue;
+
+                // back in sync: either the corrupted line is over, or the late replies are skipped and the frame, if any, is the next line
+                if (m_discardIsError)
+                {
+                    m_state = State::Idle;
+                    return Status::FrameCorrupted;
+                }
+                if (m_expected == 0)
+                {
+                    m_state = State::Idle;
+                    return Status::NeedMoreData;
+                }
+                m_state = State::InFrame;
+                continue;
+            }
+
+            // the line is only released once parsed, the producer may reuse its bytes right after
+            m_state = State::Idle;
+            const bool valid = parseLine(line);
+            ring.consume(line.size());
+            if (valid)
+                return Status::FrameComplete;
+
+            m_corruptedFrames++;
+            m_count = 0;
+            return Status::FrameCorrupted;
+        }
+
+        if (ring.freeSpace() == 0)
+        {
+            // a line longer than the ring can't be a reply: drop it, up to its end of line still to come
+            ring.clear();
+            if (m_state != State::Discard)
+            {
+                m_corruptedFrames++;
+                m_state = State::Discard;
+                m_discardIsError = true;
+                m_framesToSkip = 1;
+            }
+        }
+
+        return Status::NeedMoreData;
+    }
+
+
+    HapticAvatar_ResponseParser::Status HapticAvatar_ResponseParser::parseBinary(HapticAvatar_RingBuffer& ring)
+    {
+        while (true)
+        {
+            // skip anything before the start of a frame, e.g. the tail of an ASCII reply
+            unsigned int skipped = 0;
+            while (skipped < ring.size() && uint8_t(ring.at(skipped)) != BINARY_SYNC_BYTE)
+                skipped++;
+            ring.consume(skipped);
+
+            if (ring.size() < BINARY_HEADER_LEN)
+                return Status::NeedMoreData;
+
+            const unsigned int payloadLen = unsigned(uint8_t(ring.at(1))) | (unsigned(uint8_t(ring.at(2))) << 8);
+            if (payloadLen > MAX_FRAME_VALUES * 4)
+            {
+                // not a real frame start
+                ring.consume(1);
+                continue;
+            }
+
+            const unsigned int frameLen = BINARY_HEADER_LEN + payloadLen + BINARY_CRC_LEN;
+            if (ring.size() < frameLen)
+                return Status::NeedMoreData;
+
+            // the frame is read in place, in the one or two parts of the ring it spans
+            const HapticAvatar_RingView frame = ring.peek(frameLen);
+            uint16_t crc = 0xFFFF;
+            for (unsigned int i = 1; i < BINARY_HEADER_LEN + payloadLen; i++)
+                crc = crc16Ccitt(crc, uint8_t(frame[i]));
+            const uint16_t frameCrc = uint16_t(uint8_t(frame[frameLen - 2]) | (uint8_t(frame[frameLen - 1]) << 8));
+
+            if (m_state == State::Discard)
+            {
+                if (crc == frameCrc && m_expected > 0 && payloadLen == unsigned(m_expected) * 4)
+                {
+                    // a valid frame of the expected length is the reply of the frame begun: the late replies still to skip were lost
+                    m_framesToSkip = 0;
+                    m_state = State::InFrame;
+                }
+                else
+                {
+                    // late reply of a previous frame. The pieces of a reply cut by a lost byte don't count, the caller gives up on it after a while.
+                    ring.consume(frameLen);
+                    if (crc != frameCrc || --m_framesToSkip > 0)
+                        continue;
+
+                    if (m_expected == 0)
+                    {
+                        m_state = State::Idle;
+                        return Status::NeedMoreData;
+                    }
+                    m_state = State::InFrame;
+                    continue;
+                }
+            }
+
+            m_state = State::Idle;
+            if (crc != frameCrc || payloadLen != unsigned(m_expected) * 4)
+            {
+                m_corruptedFrames++;
+                ring.consume(frameLen);
+                return Status::FrameCorrupted;
+            }
+
+            for (int k = 0; k < m_expected; k++)
+            {
+                uint32_t bits = 0;
+                for (int i = 0; i < 4; i++)
+                    bits |= uint32_t(uint8_t(frame[BINARY_HEADER_LEN + 4 * k + i])) << (8 * i);
+                m_values[k] = float(int32_t(bits));
+            }
+            m_count = m_expected;
+            ring.consume(frameLen);
+            return Status::FrameComplete;
+        }
+    }
+
+} // namespace sofa::HapticAvatar
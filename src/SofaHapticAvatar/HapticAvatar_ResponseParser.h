@@ -0,0 +1,115 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <SofaHapticAvatar/HapticAvatar_RingBuffer.h>
+
+namespace sofa::HapticAvatar
+{
+
+#define MAX_FRAME_VALUES 624 // RESULT_SIZEX * RESULT_SIZEY
+#define MAX_TOKEN_LEN 32
+
+    /**
+    * Parser for the ASCII replies of the Haptic Avatar devices.
+    * A reply frame is made of the expected number of space separated numbers followed by an end of line.
+    * A frame is parsed in place once its whole line is in the ring, see @sa HapticAvatar_RingBuffer::peekLine. A line
+    * with bytes that can't be a number, or with the wrong number of values, is dropped as corrupted.
+    * In binary mode, replies are length prefixed frames checked by a CRC, see @sa HapticAvatar_BinaryProtocol.h
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_ResponseParser
+    {
+    public:
+        enum class Status
+        {
+            NeedMoreData,
+            FrameComplete,
+            FrameCorrupted
+        };
+
+        /** Start a new frame. The reply of the previous frame must have been parsed, or skipped with @sa skipFrames.
+        * Replies still to skip are skipped first.
+        * @param {int} nbValues: number of values expected in the frame.
+        */
+        void beginFrame(int nbValues);
+
+        /** Skip the next replies, e.g. the late replies of dropped frames. A reply never received stays to skip: the caller
+        * bounds the wait, see @sa isSkipping, and calls @sa reset if they didn't all come.
+        * In binary mode, only the frames with a valid CRC count as replies, and once a frame is begun, a valid frame of its length
+        * is taken as its reply and ends the skip.
+        * @param {int} nbFrames: number of replies to skip.
+        */
+        void skipFrames(int nbFrames);
+
+        /// Forget any frame in progress and any late reply to skip. To be called after the link has been flushed.
+        void reset();
+
+        /// True while replies are skipped, see @sa skipFrames
+        bool isSkipping() const { return m_state == State::Discard && !m_discardIsError; }
+        /// True if no frame is expected: there is nothing to wait for.
+        bool isIdle() const { return m_state == State::Idle; }
+
+        /** Parse the bytes available in the ring, consuming them.
+        * @returns {Status} FrameComplete when the values are available in @sa values, FrameCorrupted if the frame was dropped.
+        */
+        Status parse(HapticAvatar_RingBuffer& ring);
+
+        /// Parse binary frames instead of ASCII lines. Any frame in progress is forgotten.
+        void setBinaryMode(bool binary) { m_binaryMode = binary; reset(); }
+        bool isBinaryMode() const { return m_binaryMode; }
+
+        /// Values of the last completed frame.
+        const float* values() const { return m_values; }
+        int nbValues() const { return m_count; }
+
+        /// Number of frames dropped because of unexpected bytes.
+        unsigned int getCorruptedFrameCounter() const { return m_corruptedFrames; }
+
+    private:
+        enum class State
+        {
+            Idle,         // no frame expected
+            InFrame,      // waiting for the reply
+            Discard       // skipping bytes up to the end of the late replies
+        };
+
+        /// Convert a token into the next value. @returns false if the token is not a number.
+        bool pushToken(const char* token, int tokenLen);
+
+        /// Read the values of a complete line. @returns false if the line is not a valid reply to the current frame.
+        bool parseLine(const HapticAvatar_RingView& line);
+
+        /// Binary mode version of @sa parse, only consumes whole frames.
+        Status parseBinary(HapticAvatar_RingBuffer& ring);
+
+        State m_state = State::Idle;
+        bool m_binaryMode = false;
+        bool m_discardIsError = false;
+        int m_framesToSkip = 0; // number of late replies to skip before the current frame starts, see @sa skipFrames
+        int m_expected = 0;
+        int m_count = 0;
+        float m_values[MAX_FRAME_VALUES];
+        unsigned int m_corruptedFrames = 0;
+    };
+
+} // namespace sofa::HapticAvatar
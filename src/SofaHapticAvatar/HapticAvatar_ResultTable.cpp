@@ -0,0 +1,110 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_ResultTable.h>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_ResultTable::HapticAvatar_ResultTable()
+    {
+        for (Row& row : m_rows)
+        {
+            row.sequence.store(0, std::memory_order_relaxed);
+            row.timestampNs.store(0, std::memory_order_relaxed);
+            row.previousTimestampNs.store(0, std::memory_order_relaxed);
+            for (int i = 0; i < RESULT_SIZEY; i++)
+            {
+                row.values[i].store(0.0f, std::memory_order_relaxed);
+                row.previousValues[i].store(0.0f, std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    void HapticAvatar_ResultTable::write(int cmd, const float* values, int nbValues, int64_t timestampNs)
+    {
+        Row& row = m_rows[cmd];
+        const unsigned int sequence = row.sequence.load(std::memory_order_relaxed);
+
+        // odd sequence: the readers know the row is being written
+        row.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        row.previousTimestampNs.store(row.timestampNs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        row.timestampNs.store(timestampNs, std::memory_order_relaxed);
+        for (int i = 0; i < nbValues; i++)
+        {
+            row.previousValues[i].store(row.values[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            row.values[i].store(values[i], std::memory_order_relaxed);
+        }
+
+        row.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+
+    unsigned int HapticAvatar_ResultTable::read(int cmd, float* values, int nbValues, int64_t* timestampNs) const
+    {
+        const Row& row = m_rows[cmd];
+        for (;;)
+        {
+            const unsigned int before = row.sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            for (int i = 0; i < nbValues; i++)
+                values[i] = row.values[i].load(std::memory_order_relaxed);
+            if (timestampNs != nullptr)
+                *timestampNs = row.timestampNs.load(std::memory_order_relaxed);
+
+            // the copy is consistent if no write started or ended meanwhile
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (row.sequence.load(std::memory_order_relaxed) == before)
+                return before / 2;
+        }
+    }
+
+
+    unsigned int HapticAvatar_ResultTable::readWithPrevious(int cmd, float* values, int64_t* timestampNs, float* previousValues, int64_t* previousTimestampNs, int nbValues) const
+    {
+        const Row& row = m_rows[cmd];
+        for (;;)
+        {
+            const unsigned int before = row.sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            for (int i = 0; i < nbValues; i++)
+            {
+                values[i] = row.values[i].load(std::memory_order_relaxed);
+                previousValues[i] = row.previousValues[i].load(std::memory_order_relaxed);
+            }
+            *timestampNs = row.timestampNs.load(std::memory_order_relaxed);
+            *previousTimestampNs = row.previousTimestampNs.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (row.sequence.load(std::memory_order_relaxed) == before)
+                return before / 2;
+        }
+    }
+
+} // namespace sofa::HapticAvatar
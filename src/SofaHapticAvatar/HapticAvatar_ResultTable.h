@@ -0,0 +1,88 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <atomic>
+#include <cstdint>
+
+namespace sofa::HapticAvatar
+{
+
+#define RESULT_SIZEX  52
+#define RESULT_SIZEY  12
+
+    /**
+    * Latest values received from a device, one row per command. Rows are written by the haptic thread and can be read
+    * from any thread without lock: each row is a seqlock, a reader copying a row while it is written retries the copy
+    * instead of getting half old and half new values. The writer never waits.
+    * Each row keeps the host time of its values and the previous values, to extrapolate them.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_ResultTable
+    {
+    public:
+        HapticAvatar_ResultTable();
+
+        /** Replace the values of a row. Must only be called by one thread.
+        * @param {int} cmd: row index, the command id.
+        * @param {float *} values: new values, already scaled.
+        * @param {int} nbValues: number of values, at most RESULT_SIZEY.
+        * @param {int64} timestampNs: host time at which the values were sampled, in ns.
+        */
+        void write(int cmd, const float* values, int nbValues, int64_t timestampNs = 0);
+
+        /** Copy the first values of a row, all from the same reply.
+        * @param {float *} values: array to store the values.
+        * @param {int} nbValues: number of values to copy, at most RESULT_SIZEY.
+        * @param {int64 *} timestampNs: if not null, host time of the values.
+        * @returns {uint} generation of the copied values, see @sa getGeneration
+        */
+        unsigned int read(int cmd, float* values, int nbValues, int64_t* timestampNs = nullptr) const;
+
+        /** Copy the first values of a row and the values of the reply before, with their host times.
+        * @returns {uint} generation of the copied values, the previous values are valid if it is above 1.
+        */
+        unsigned int readWithPrevious(int cmd, float* values, int64_t* timestampNs, float* previousValues, int64_t* previousTimestampNs, int nbValues) const;
+
+        /// Host time of the values of a row, in ns. 0 if nothing was received.
+        int64_t getTimestamp(int cmd) const { return m_rows[cmd].timestampNs.load(std::memory_order_relaxed); }
+
+        /// Single value of a row. A single value can't tear, no retry needed.
+        float get(int cmd, int index) const { return m_rows[cmd].values[index].load(std::memory_order_relaxed); }
+
+        /// Number of times a row has been written, to know if new values were received since the last read.
+        unsigned int getGeneration(int cmd) const { return m_rows[cmd].sequence.load(std::memory_order_acquire) / 2; }
+
+    private:
+        struct Row
+        {
+            std::atomic<unsigned int> sequence; // odd while the row is written
+            std::atomic<float> values[RESULT_SIZEY];
+            std::atomic<int64_t> timestampNs;
+            std::atomic<float> previousValues[RESULT_SIZEY];
+            std::atomic<int64_t> previousTimestampNs;
+        };
+
+        Row m_rows[RESULT_SIZEX];
+    };
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,113 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_RingBuffer.h>
+#include <algorithm>
+#include <cstring>
+
+namespace sofa::HapticAvatar
+{
+
+    void HapticAvatar_RingView::copyTo(char* buffer, unsigned int nbChar) const
+    {
+        const unsigned int firstChunk = std::min(nbChar, firstLen);
+        memcpy(buffer, first, firstChunk);
+        memcpy(buffer + firstChunk, second, nbChar - firstChunk);
+    }
+
+
+    unsigned int HapticAvatar_RingBuffer::write(const char* data, unsigned int nbChar)
+    {
+        nbChar = std::min(nbChar, freeSpace());
+
+        // copy in at most two chunks: until the end of the array, then from its start
+        const unsigned int tail = m_tail.load(std::memory_order_relaxed);
+        unsigned int start = tail & (INCOMING_RING_LEN - 1);
+        unsigned int firstChunk = std::min(nbChar, INCOMING_RING_LEN - start);
+        memcpy(m_data + start, data, firstChunk);
+        memcpy(m_data, data + firstChunk, nbChar - firstChunk);
+
+        m_tail.store(tail + nbChar, std::memory_order_release);
+        return nbChar;
+    }
+
+
+    char* HapticAvatar_RingBuffer::beginWrite(unsigned int* nbChar)
+    {
+        const unsigned int start = m_tail.load(std::memory_order_relaxed) & (INCOMING_RING_LEN - 1);
+        *nbChar = std::min(freeSpace(), INCOMING_RING_LEN - start);
+        return m_data + start;
+    }
+
+
+    void HapticAvatar_RingBuffer::consume(unsigned int nbChar)
+    {
+        m_scanned = (nbChar < m_scanned) ? m_scanned - nbChar : 0;
+        m_head.store(m_head.load(std::memory_order_relaxed) + nbChar, std::memory_order_release);
+    }
+
+
+    HapticAvatar_RingView HapticAvatar_RingBuffer::peek(unsigned int nbChar) const
+    {
+        HapticAvatar_RingView view;
+        const unsigned int start = m_head.load(std::memory_order_relaxed) & (INCOMING_RING_LEN - 1);
+        view.first = m_data + start;
+        view.firstLen = std::min(nbChar, INCOMING_RING_LEN - start);
+        view.second = m_data;
+        view.secondLen = nbChar - view.firstLen;
+        return view;
+    }
+
+
+    bool HapticAvatar_RingBuffer::peekLine(HapticAvatar_RingView& line)
+    {
+        const unsigned int available = size();
+        const HapticAvatar_RingView view = peek(available);
+
+        // search each part of the view from the first byte not searched yet
+        while (m_scanned < available)
+        {
+            const bool inFirst = m_scanned < view.firstLen;
+            const char* begin = inFirst ? view.first + m_scanned : view.second + (m_scanned - view.firstLen);
+            const unsigned int length = inFirst ? view.firstLen - m_scanned : available - m_scanned;
+            const char* eol = static_cast<const char*>(memchr(begin, '\n', length));
+            if (eol != nullptr)
+            {
+                // stay on the end of line, so the same line is found again until it is consumed
+                m_scanned += (unsigned int)(eol - begin);
+                line = peek(m_scanned + 1);
+                return true;
+            }
+            m_scanned += length;
+        }
+
+        return false;
+    }
+
+
+    void HapticAvatar_RingBuffer::clear()
+    {
+        m_scanned = 0;
+        m_head.store(m_tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,99 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <atomic>
+
+namespace sofa::HapticAvatar
+{
+
+#define INCOMING_RING_LEN 4096 // must be a power of two
+
+    /// Unread bytes of a @sa HapticAvatar_RingBuffer, seen in place. The second part is not empty when the bytes wrap around the end of the ring.
+    struct HapticAvatar_RingView
+    {
+        const char* first = nullptr;
+        unsigned int firstLen = 0;
+        const char* second = nullptr;
+        unsigned int secondLen = 0;
+
+        unsigned int size() const { return firstLen + secondLen; }
+
+        char operator[](unsigned int i) const { return i < firstLen ? first[i] : second[i - firstLen]; }
+
+        /// Copy the nbChar first bytes of the view, nbChar <= size()
+        void copyTo(char* buffer, unsigned int nbChar) const;
+    };
+
+    /**
+    * Fixed size byte ring buffer between the link and the response parser. Bytes are appended by @sa write
+    * and removed in order by @sa consume, so a reply can be gathered over several reads.
+    * Lock-free for one producer thread (write, beginWrite/commitWrite) and one consumer thread (all the other methods),
+    * so a dedicated I/O thread can drain the link while the haptic thread parses the replies.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_RingBuffer
+    {
+    public:
+        /** Append bytes at the end of the ring. Producer side.
+        * @returns {uint} number of bytes stored, less than nbChar if the ring is full.
+        */
+        unsigned int write(const char* data, unsigned int nbChar);
+
+        /** Zero-copy append: free space right after the last byte, to be filled in place then published by @sa commitWrite. Producer side.
+        * @param {uint *} nbChar: set to the number of contiguous bytes that can be written, 0 if the ring is full.
+        * @returns {char *} where to write the bytes.
+        */
+        char* beginWrite(unsigned int* nbChar);
+
+        /// Publish nbChar bytes written at the address returned by @sa beginWrite.
+        void commitWrite(unsigned int nbChar) { m_tail.store(m_tail.load(std::memory_order_relaxed) + nbChar, std::memory_order_release); }
+
+        /// Remove the nbChar oldest bytes.
+        void consume(unsigned int nbChar);
+
+        /// i-th unread byte, i < size()
+        char at(unsigned int i) const { return m_data[(m_head.load(std::memory_order_relaxed) + i) & (INCOMING_RING_LEN - 1)]; }
+
+        /// View of the nbChar oldest bytes, nbChar <= size(). Valid until they are consumed.
+        HapticAvatar_RingView peek(unsigned int nbChar) const;
+
+        /** View of the oldest complete line, end of line included. The bytes already searched are not searched again at the next call.
+        * @returns {bool} false if no end of line was received yet.
+        */
+        bool peekLine(HapticAvatar_RingView& line);
+
+        unsigned int size() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+        unsigned int freeSpace() const { return INCOMING_RING_LEN - size(); }
+
+        /// Drop all the unread bytes. Consumer side, the producer may keep writing.
+        void clear();
+
+    private:
+        char m_data[INCOMING_RING_LEN];
+        // free running read and write indices, wrapped with the mask on access. On separate cache lines, each one is written by a single thread.
+        alignas(64) std::atomic<unsigned int> m_head = { 0 };
+        alignas(64) std::atomic<unsigned int> m_tail = { 0 };
+        unsigned int m_scanned = 0; // unread bytes already searched by peekLine, consumer side
+    };
+
+} // namespace sofa::HapticAvatar
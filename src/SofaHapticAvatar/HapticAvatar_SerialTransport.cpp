@@ -0,0 +1,400 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_SerialTransport.h>
+#include <sofa/helper/logging/Messaging.h>
+
+#include <algorithm>
+
+#ifndef WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+#endif
+
+namespace sofa::HapticAvatar
+{
+
+#ifndef WIN32
+    namespace
+    {
+        /// Convert a baud rate into its termios constant. @returns B0 if the rate is not supported.
+        speed_t baudToSpeed(int baudRate)
+        {
+            switch (baudRate)
+            {
+            case 9600: return B9600;
+            case 19200: return B19200;
+            case 38400: return B38400;
+            case 57600: return B57600;
+            case 115200: return B115200;
+            case 230400: return B230400;
+#ifdef B460800
+            case 460800: return B460800;
+            case 500000: return B500000;
+            case 921600: return B921600;
+            case 1000000: return B1000000;
+            case 2000000: return B2000000;
+#endif
+            default: return B0;
+            }
+        }
+    }
+#endif
+
+
+    HapticAvatar_SerialTransport::HapticAvatar_SerialTransport(const std::string& portName)
+        : HapticAvatar_Transport(portName)
+    {
+
+    }
+
+
+    HapticAvatar_SerialTransport::~HapticAvatar_SerialTransport()
+    {
+        close();
+    }
+
+
+    bool HapticAvatar_SerialTransport::open()
+    {
+#ifdef WIN32
+        //Try to connect to the given port throuh CreateFile
+        m_hSerial = CreateFileA(m_portName.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            0,
+            NULL,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            NULL
+        );
+
+        //Check if the connection was successfull
+        if (m_hSerial == INVALID_HANDLE_VALUE)
+        {
+            //If not success full display an Error
+            if (GetLastError() == ERROR_FILE_NOT_FOUND) {
+
+                //Print Error if neccessary
+                msg_error("HapticAvatar_SerialTransport") << "Handle was not attached. Reason: " << m_portName << " not available.";
+            }
+            else
+            {
+                msg_error("HapticAvatar_SerialTransport") << "Unknown error occured!";
+            }
+        }
+        else
+        {
+            //If connected we try to set the comm parameters
+            if (!applyLinkSettings())
+            {
+                msg_warning("HapticAvatar_SerialTransport") << "ALERT: Could not set Serial Port parameters";
+            }
+            else
+            {
+                //If everything went fine we're connected
+                m_open = true;
+                //Flush any remaining characters in the buffers
+                PurgeComm(m_hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
+                //The arduino board is reseting, HapticAvatar_DriverBase waits until it answers
+            }
+        }
+#else
+        //Try to connect to the given port (ex: /dev/ttyACM0). The port is opened non-blocking, waiting for data is done with poll()
+        m_fd = ::open(m_portName.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (m_fd < 0)
+        {
+            if (errno == ENOENT) {
+                msg_error("HapticAvatar_SerialTransport") << "Handle was not attached. Reason: " << m_portName << " not available.";
+            }
+            else
+            {
+                msg_error("HapticAvatar_SerialTransport") << "Failed to open " << m_portName << ": " << strerror(errno);
+            }
+            return false;
+        }
+
+        //Take an exclusive lock so that two scenes (or a serial monitor) can't share the same device
+        if (flock(m_fd, LOCK_EX | LOCK_NB) != 0 || ioctl(m_fd, TIOCEXCL) != 0)
+        {
+            if (errno == EWOULDBLOCK || errno == EBUSY) {
+                msg_error("HapticAvatar_SerialTransport") << "Port " << m_portName << " is already in use by another process.";
+            }
+            else
+            {
+                msg_error("HapticAvatar_SerialTransport") << "Failed to lock " << m_portName << ": " << strerror(errno);
+            }
+            ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+
+        if (!applyLinkSettings())
+        {
+            msg_warning("HapticAvatar_SerialTransport") << "ALERT: Could not set Serial Port parameters";
+            ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+
+#ifdef __linux__
+        //Ask the tty driver to push received bytes immediately instead of batching them (not supported by every USB-serial driver)
+        serial_struct serial;
+        if (ioctl(m_fd, TIOCGSERIAL, &serial) == 0)
+        {
+            serial.flags |= ASYNC_LOW_LATENCY;
+            if (ioctl(m_fd, TIOCSSERIAL, &serial) != 0)
+                msg_info("HapticAvatar_SerialTransport") << "ASYNC_LOW_LATENCY not supported on " << m_portName;
+        }
+#endif
+
+        //Setting the DTR ensures that the Arduino is properly reset upon establishing a connection
+        if (m_linkSettings.dtrReset)
+        {
+            int modemFlags = TIOCM_DTR;
+            ioctl(m_fd, TIOCMBIS, &modemFlags);
+        }
+
+        //If everything went fine we're connected
+        m_open = true;
+        //Flush any remaining characters in the buffers
+        tcflush(m_fd, TCIOFLUSH);
+        //The arduino board is reseting, HapticAvatar_DriverBase waits until it answers
+#endif
+        return m_open;
+    }
+
+
+    void HapticAvatar_SerialTransport::close()
+    {
+        //Check if we are connected before trying to disconnect
+        if (!m_open)
+            return;
+
+        //We're no longer connected
+        m_open = false;
+        //Close the serial handler
+#ifdef WIN32
+        CloseHandle(m_hSerial);
+#else
+        ::close(m_fd);
+        m_fd = -1;
+#endif
+    }
+
+
+    bool HapticAvatar_SerialTransport::applyLinkSettings()
+    {
+        const bool hardwareFlow = (m_linkSettings.flowControl == "hardware");
+        const bool softwareFlow = (m_linkSettings.flowControl == "software");
+#ifdef WIN32
+        DCB dcbSerialParams = { 0 };
+
+        //Try to get the current
+        if (!GetCommState(m_hSerial, &dcbSerialParams))
+        {
+            //If impossible, show an error
+            msg_warning("HapticAvatar_SerialTransport") << "Failed to get current serial parameters!";
+            return false;
+        }
+
+        //Define serial connection parameters for the arduino board
+        dcbSerialParams.BaudRate = DWORD(m_linkSettings.baudRate);
+        dcbSerialParams.ByteSize = 8;
+        dcbSerialParams.StopBits = ONESTOPBIT;
+        dcbSerialParams.Parity = NOPARITY;
+        //Setting the DTR to Control_Enable ensures that the Arduino is properly
+        //reset upon establishing a connection
+        dcbSerialParams.fDtrControl = m_linkSettings.dtrReset ? DTR_CONTROL_ENABLE : DTR_CONTROL_DISABLE;
+        dcbSerialParams.fOutxCtsFlow = hardwareFlow;
+        dcbSerialParams.fRtsControl = hardwareFlow ? RTS_CONTROL_HANDSHAKE : RTS_CONTROL_ENABLE;
+        dcbSerialParams.fOutX = softwareFlow;
+        dcbSerialParams.fInX = softwareFlow;
+
+        //Set the parameters and check for their proper application
+        return SetCommState(m_hSerial, &dcbSerialParams) != 0;
+#else
+        const speed_t speed = baudToSpeed(m_linkSettings.baudRate);
+        if (speed == B0)
+        {
+            msg_warning("HapticAvatar_SerialTransport") << "Baud rate " << m_linkSettings.baudRate << " is not supported.";
+            return false;
+        }
+
+        termios tty;
+        if (tcgetattr(m_fd, &tty) != 0)
+        {
+            msg_warning("HapticAvatar_SerialTransport") << "Failed to get current serial parameters!";
+            return false;
+        }
+
+        //Define serial connection parameters for the arduino board: raw 8N1
+        cfmakeraw(&tty);
+        cfsetispeed(&tty, speed);
+        cfsetospeed(&tty, speed);
+        tty.c_cflag |= (CLOCAL | CREAD | CS8);
+        tty.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+        if (hardwareFlow)
+            tty.c_cflag |= CRTSCTS;
+        else if (softwareFlow)
+            tty.c_iflag |= (IXON | IXOFF);
+        //Without DTR reset, keep DTR up when the port is closed so that the next open doesn't reset the board
+        if (!m_linkSettings.dtrReset)
+            tty.c_cflag &= ~HUPCL;
+        //read() returns immediately with what is available
+        tty.c_cc[VMIN] = 0;
+        tty.c_cc[VTIME] = 0;
+
+        return tcsetattr(m_fd, TCSANOW, &tty) == 0;
+#endif
+    }
+
+
+    bool HapticAvatar_SerialTransport::setBaudRate(int baudRate)
+    {
+        const int previousRate = m_linkSettings.baudRate;
+        m_linkSettings.baudRate = baudRate;
+        if (!m_open)
+            return true;
+
+        if (!applyLinkSettings())
+        {
+            m_linkSettings.baudRate = previousRate;
+            applyLinkSettings();
+            return false;
+        }
+
+        flush();
+        return true;
+    }
+
+
+    int HapticAvatar_SerialTransport::read(char* buffer, unsigned int nbChar)
+    {
+#ifdef WIN32
+        //Number of bytes we'll have read
+        DWORD bytesRead = 0;
+
+        //Use the ClearCommError function to get status info on the Serial port
+        ClearCommError(m_hSerial, &m_errors, &m_status);
+
+        DWORD queue = m_status.cbInQue;
+        if (queue > 0)
+            ReadFile(m_hSerial, buffer, std::min(DWORD(queue), DWORD(nbChar)), &bytesRead, NULL);
+
+        return int(bytesRead);
+#else
+        return fdRead(m_fd, buffer, nbChar);
+#endif
+    }
+
+
+    bool HapticAvatar_SerialTransport::write(const char* buffer, unsigned int nbChar)
+    {
+#ifdef WIN32
+        DWORD bytesSend;
+
+        //Try to write the buffer on the Serial port
+        if (!WriteFile(m_hSerial, (void*)buffer, nbChar, &bytesSend, 0))
+        {
+            //In case it don't work get comm error and return false
+            ClearCommError(m_hSerial, &m_errors, &m_status);
+
+            msg_error("HapticAvatar_SerialTransport") << "Failed to send " << nbChar << " bytes on " << m_portName << ". Communication errors: " << m_errors;
+            return false;
+        }
+        else
+            return true;
+#else
+        return fdWrite(m_fd, buffer, nbChar);
+#endif
+    }
+
+
+    int HapticAvatar_SerialTransport::bytesAvailable()
+    {
+#ifdef WIN32
+        ClearCommError(m_hSerial, &m_errors, &m_status);
+        return (int)m_status.cbInQue;
+#else
+        return fdBytesAvailable(m_fd);
+#endif
+    }
+
+
+    bool HapticAvatar_SerialTransport::waitReadable(int timeoutUs)
+    {
+#ifdef WIN32
+        SOFA_UNUSED(timeoutUs);
+        return bytesAvailable() > 0;
+#else
+        return fdWaitReadable(m_fd, timeoutUs);
+#endif
+    }
+
+
+    int HapticAvatar_SerialTransport::readWait(char* buffer, unsigned int nbChar, int timeoutUs)
+    {
+#ifdef WIN32
+        //ReadFile returns as soon as one byte is received, or after ReadTotalTimeoutConstant ms without any byte.
+        //The timeouts are only changed when the requested value changes, to avoid a syscall at each read.
+        DWORD timeoutMs = std::max(DWORD(1), DWORD((timeoutUs + 999) / 1000));
+        if (timeoutMs != m_readTimeoutMs)
+        {
+            COMMTIMEOUTS timeouts = { 0 };
+            timeouts.ReadIntervalTimeout = MAXDWORD;
+            timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+            timeouts.ReadTotalTimeoutConstant = timeoutMs;
+            if (!SetCommTimeouts(m_hSerial, &timeouts))
+                return -1;
+            m_readTimeoutMs = timeoutMs;
+        }
+
+        DWORD bytesRead = 0;
+        if (!ReadFile(m_hSerial, buffer, DWORD(nbChar), &bytesRead, NULL))
+            return -1;
+
+        return int(bytesRead);
+#else
+        return HapticAvatar_Transport::readWait(buffer, nbChar, timeoutUs);
+#endif
+    }
+
+
+    void HapticAvatar_SerialTransport::flush()
+    {
+#ifdef WIN32
+        PurgeComm(m_hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
+#else
+        tcflush(m_fd, TCIOFLUSH);
+#endif
+    }
+
+} // namespace sofa::HapticAvatar
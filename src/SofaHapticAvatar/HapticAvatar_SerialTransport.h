@@ -0,0 +1,71 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
+
+namespace sofa::HapticAvatar
+{
+
+    /**
+    * Serial port transport. Uses Win32 comm API on Windows and a termios tty on POSIX systems.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_SerialTransport : public HapticAvatar_Transport
+    {
+    public:
+        HapticAvatar_SerialTransport(const std::string& portName);
+
+        ~HapticAvatar_SerialTransport() override;
+
+        /// HapticAvatar_Transport api
+        ///{
+        bool open() override;
+        void close() override;
+        int read(char* buffer, unsigned int nbChar) override;
+        bool write(const char* buffer, unsigned int nbChar) override;
+        int bytesAvailable() override;
+        bool waitReadable(int timeoutUs) override;
+        int readWait(char* buffer, unsigned int nbChar, int timeoutUs) override;
+        void flush() override;
+        bool setBaudRate(int baudRate) override;
+        ///}
+
+    private:
+        /// Apply @sa m_linkSettings to the opened port. @returns false if the port refused them.
+        bool applyLinkSettings();
+
+#ifdef WIN32
+        //Serial comm handler
+        HANDLE m_hSerial;
+        //Get various information about the connection
+        COMSTAT m_status;
+        //Keep track of last error
+        DWORD m_errors;
+        //Read timeout currently set in the COMMTIMEOUTS of the port, in ms (0 if not set yet)
+        DWORD m_readTimeoutMs = 0;
+#else
+        //Serial comm file descriptor (termios tty)
+        int m_fd = -1;
+#endif
+    };
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,488 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_SimulatedDevice.h>
+#include <SofaHapticAvatar/HapticAvatar_SimulatedPort.h>
+#include <SofaHapticAvatar/HapticAvatar_SimulatedIbox.h>
+#include <SofaHapticAvatar/HapticAvatar_SimulatedScope.h>
+#include <SofaHapticAvatar/HapticAvatar_DriverBase.h>
+#include <SofaHapticAvatar/HapticAvatar_BinaryProtocol.h>
+#include <SofaHapticAvatar/HapticAvatar_LoopbackTransport.h>
+#include <SofaHapticAvatar/HapticAvatar_SerialTransport.h>
+#include <sofa/helper/logging/Messaging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_SimulatedDevice::HapticAvatar_SimulatedDevice(const std::string& deviceType, const HapticAvatar_SimulatorSettings& settings)
+        : m_settings(settings)
+        , m_deviceType(deviceType)
+        , m_running(false)
+        , m_attached(false)
+        , m_unpluggedUntilNs(0)
+        , m_random(settings.seed)
+        , m_lossDraw(std::clamp(double(settings.byteLoss), 0.0, 1.0))
+        , m_jitterDraw(0, std::max(settings.jitterUs, 0))
+        , m_frameCount(0)
+        , m_badFrameCount(0)
+        , m_lostByteCount(0)
+    {
+
+    }
+
+
+    HapticAvatar_SimulatedDevice::~HapticAvatar_SimulatedDevice()
+    {
+        stop();
+    }
+
+
+    HapticAvatar_SimulatedDevice* HapticAvatar_SimulatedDevice::create(const std::string& type, const HapticAvatar_SimulatorSettings& settings)
+    {
+        if (type == "port")
+            return new HapticAvatar_SimulatedPort(settings);
+        else if (type == "ibox")
+            return new HapticAvatar_SimulatedIbox(settings);
+        else if (type == "scope")
+            return new HapticAvatar_SimulatedScope(settings);
+
+        msg_error("HapticAvatar_SimulatedDevice") << "Unknown device type: '" << type << "'. Valid types are: port, ibox, scope.";
+        return nullptr;
+    }
+
+
+    void HapticAvatar_SimulatedDevice::setupProtocol(const HapticAvatar_DriverBase& driver)
+    {
+        m_deviceTypeId = driver.getDeviceTypeId();
+        m_numCommands = driver.getNumCommands();
+        for (int i = 0; i < m_numCommands; i++)
+        {
+            m_numReturnVals[i] = driver.getNumReturnValues(i);
+            m_scaleFactor[i] = driver.getScaleFactor(i);
+        }
+    }
+
+
+    void HapticAvatar_SimulatedDevice::start()
+    {
+        if (m_running)
+            return;
+
+        m_running = true;
+        m_thread = std::thread(&HapticAvatar_SimulatedDevice::run, this);
+    }
+
+
+    void HapticAvatar_SimulatedDevice::stop()
+    {
+        m_running = false;
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+
+    void HapticAvatar_SimulatedDevice::unplug(int durationMs)
+    {
+        m_unpluggedUntilNs = clockNs() + int64_t(durationMs) * 1000000;
+    }
+
+
+    int64_t HapticAvatar_SimulatedDevice::clockNs() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    bool HapticAvatar_SimulatedDevice::attach()
+    {
+        if (m_settings.transport == "loopback")
+        {
+            // the channel exists once the driver opened its side
+            m_transport = HapticAvatar_LoopbackTransport::connectDeviceSide(m_settings.portName);
+        }
+        else if (m_settings.transport == "pty")
+        {
+            // the link to the slave side is created when the driver opens the pseudo-terminal
+            if (!std::ifstream(m_settings.portName).good())
+                return false;
+
+            HapticAvatar_LinkSettings linkSettings;
+            linkSettings.dtrReset = false;
+            m_transport = new HapticAvatar_SerialTransport(m_settings.portName);
+            m_transport->setLinkSettings(linkSettings);
+            if (!m_transport->open())
+            {
+                delete m_transport;
+                m_transport = nullptr;
+            }
+        }
+
+        if (m_transport == nullptr)
+            return false;
+
+        m_input.clear();
+        m_binaryFraming = false;
+        m_replies.clear();
+        m_lastDueNs = 0;
+        m_lastStepNs = clockNs();
+        m_attached = true;
+        return true;
+    }
+
+
+    void HapticAvatar_SimulatedDevice::detach()
+    {
+        if (m_transport != nullptr)
+        {
+            m_transport->close();
+            delete m_transport;
+            m_transport = nullptr;
+        }
+        m_attached = false;
+    }
+
+
+    void HapticAvatar_SimulatedDevice::run()
+    {
+        if (m_settings.transport != "loopback" && m_settings.transport != "pty")
+        {
+            msg_error("HapticAvatar_SimulatedDevice") << "Unknown transport: '" << m_settings.transport << "'. Valid transports are: loopback, pty.";
+            return;
+        }
+
+        char buffer[INCOMING_DATA_LEN];
+        while (m_running)
+        {
+            if (m_unpluggedUntilNs != 0)
+            {
+                if (clockNs() < m_unpluggedUntilNs)
+                {
+                    if (m_attached)
+                        detach();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(SIMULATED_DEVICE_ATTACH_POLL_MS));
+                    continue;
+                }
+
+                // plugged again: the firmware boots from scratch
+                m_unpluggedUntilNs = 0;
+                reset();
+            }
+
+            if (!m_attached && !attach())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(SIMULATED_DEVICE_ATTACH_POLL_MS));
+                continue;
+            }
+
+            // sleep until the driver sends a batch or a reply is due, and check the stop request every ms
+            if (m_transport->waitReadable(waitTimeUs(clockNs(), 1000)))
+            {
+                int n = m_transport->read(buffer, INCOMING_DATA_LEN);
+                if (n < 0)
+                {
+                    // the driver closed the link, wait for the next connection
+                    detach();
+                    continue;
+                }
+
+                for (int i = 0; i < n; i++)
+                {
+                    if (m_settings.byteLoss > 0.0f && m_lossDraw(m_random))
+                        m_lostByteCount++;
+                    else
+                        m_input.push_back(buffer[i]);
+                }
+                processInput();
+            }
+
+            if (!sendDueReplies(clockNs()))
+                detach();
+        }
+
+        detach();
+    }
+
+
+    void HapticAvatar_SimulatedDevice::processInput()
+    {
+        size_t pos = 0;
+        while (pos < m_input.size())
+        {
+            if (uint8_t(m_input[pos]) == BINARY_SYNC_BYTE)
+            {
+                if (m_input.size() - pos < BINARY_HEADER_LEN)
+                    break;
+
+                const unsigned int payloadLen = unsigned(uint8_t(m_input[pos + 1])) | (unsigned(uint8_t(m_input[pos + 2])) << 8);
+                if (payloadLen > OUTGOING_DATA_LEN - BINARY_HEADER_LEN - BINARY_CRC_LEN)
+                {
+                    // not a frame start, resynchronise on the next byte
+                    m_badFrameCount++;
+                    pos++;
+                    continue;
+                }
+
+                const size_t frameLen = BINARY_HEADER_LEN + payloadLen + BINARY_CRC_LEN;
+                if (m_input.size() - pos < frameLen)
+                    break;
+
+                const char* frame = m_input.data() + pos;
+                const uint16_t crc = uint16_t(uint8_t(frame[frameLen - 2]) | (uint8_t(frame[frameLen - 1]) << 8));
+                if (crc != crc16Ccitt(frame + 1, (unsigned int)frameLen - 1 - BINARY_CRC_LEN) || !processBinaryFrame(frame + BINARY_HEADER_LEN, payloadLen))
+                {
+                    // a corrupted frame is not answered, like on the firmware
+                    m_badFrameCount++;
+                    pos++;
+                    continue;
+                }
+                pos += frameLen;
+                m_binaryFraming = true;
+            }
+            else if (m_binaryFraming)
+            {
+                // lost sync inside a binary stream, which may never contain an end of line: skip to the next sync byte
+                pos++;
+            }
+            else
+            {
+                auto eol = std::find(m_input.begin() + pos, m_input.end(), '\n');
+                if (eol == m_input.end())
+                    break;
+
+                const size_t lineLen = size_t(eol - m_input.begin()) - pos;
+                if (!processAsciiLine(m_input.data() + pos, (unsigned int)lineLen))
+                    m_badFrameCount++;
+                pos += lineLen + 1;
+            }
+        }
+
+        m_input.erase(m_input.begin(), m_input.begin() + pos);
+    }
+
+
+    bool HapticAvatar_SimulatedDevice::processAsciiLine(const char* line, unsigned int size)
+    {
+        // split the line in tokens
+        std::vector<std::string> tokens;
+        unsigned int i = 0;
+        while (i < size)
+        {
+            while (i < size && (line[i] == ' ' || line[i] == '\r' || line[i] == '\t'))
+                i++;
+            const unsigned int begin = i;
+            while (i < size && line[i] != ' ' && line[i] != '\r' && line[i] != '\t')
+                i++;
+            if (i > begin)
+                tokens.emplace_back(line + begin, i - begin);
+        }
+
+        if (tokens.empty())
+            return true;
+
+        const int64_t now = clockNs();
+        step(std::min(double(now - m_lastStepNs) * 1.0e-9, SIMULATED_DEVICE_MAX_STEP_S));
+        m_lastStepNs = now;
+
+        // decode all the commands first: a malformed batch is not executed at all
+        std::vector<int> cmds;
+        std::vector<int32_t> args;
+        std::vector<int> argStart;
+        size_t t = 0;
+        while (t < tokens.size())
+        {
+            char* end = nullptr;
+            const long cmd = strtol(tokens[t].c_str(), &end, 10);
+            if (*end != '\0' || cmd < 0 || cmd >= m_numCommands)
+                return false;
+            t++;
+
+            const int nbArgs = getNumArgs(int(cmd));
+            if (t + nbArgs > tokens.size())
+                return false;
+
+            cmds.push_back(int(cmd));
+            argStart.push_back(int(args.size()));
+            for (int a = 0; a < nbArgs; a++, t++)
+            {
+                const std::string& token = tokens[t];
+                // the driver sends some single float arguments unscaled with decimals, the firmware scales them like the binary ones
+                if (token.find('.') != std::string::npos)
+                    args.push_back(int32_t(std::lround(strtod(token.c_str(), nullptr) * m_scaleFactor[cmd])));
+                else
+                    args.push_back(int32_t(strtol(token.c_str(), nullptr, 10)));
+            }
+        }
+        argStart.push_back(int(args.size()));
+
+        std::vector<int32_t> reply;
+        std::string text;
+        for (size_t k = 0; k < cmds.size(); k++)
+        {
+            // the identity is a name in ASCII, the driver checks it is printable
+            if (cmds[k] == 1 && cmds.size() == 1)
+            {
+                text = m_deviceType + " ";
+                continue;
+            }
+            executeCommand(cmds[k], args.data() + argStart[k], argStart[k + 1] - argStart[k], reply);
+        }
+
+        for (int32_t value : reply)
+            text += std::to_string(value) + " ";
+
+        m_frameCount++;
+        if (!text.empty())
+            queueReply(text + "\n");
+        return true;
+    }
+
+
+    bool HapticAvatar_SimulatedDevice::processBinaryFrame(const char* payload, unsigned int size)
+    {
+        // check the whole payload before executing it
+        unsigned int pos = 0;
+        while (pos < size)
+        {
+            if (pos + 2 > size)
+                return false;
+            const int cmd = uint8_t(payload[pos]);
+            const int nbArgs = uint8_t(payload[pos + 1]);
+            if (cmd >= m_numCommands || nbArgs > SIMULATED_DEVICE_MAX_ARGS)
+                return false;
+            pos += 2 + 4 * nbArgs;
+        }
+        if (pos != size)
+            return false;
+
+        const int64_t now = clockNs();
+        step(std::min(double(now - m_lastStepNs) * 1.0e-9, SIMULATED_DEVICE_MAX_STEP_S));
+        m_lastStepNs = now;
+
+        std::vector<int32_t> reply;
+        int32_t args[SIMULATED_DEVICE_MAX_ARGS];
+        pos = 0;
+        while (pos < size)
+        {
+            const int cmd = uint8_t(payload[pos]);
+            const int nbArgs = uint8_t(payload[pos + 1]);
+            pos += 2;
+            for (int a = 0; a < nbArgs; a++, pos += 4)
+            {
+                uint32_t bits = 0;
+                for (int b = 0; b < 4; b++)
+                    bits |= uint32_t(uint8_t(payload[pos + b])) << (8 * b);
+                args[a] = int32_t(bits);
+            }
+
+            // the identity is the device type id in binary mode
+            if (cmd == 1)
+                reply.push_back(m_deviceTypeId);
+            else
+                executeCommand(cmd, args, nbArgs, reply);
+        }
+
+        m_frameCount++;
+        if (reply.empty())
+            return true;
+
+        std::string frame;
+        frame.push_back(char(BINARY_SYNC_BYTE));
+        const uint16_t payloadLen = uint16_t(reply.size() * 4);
+        frame.push_back(char(payloadLen & 0xFF));
+        frame.push_back(char(payloadLen >> 8));
+        for (int32_t value : reply)
+        {
+            const uint32_t bits = uint32_t(value);
+            for (int b = 0; b < 4; b++)
+                frame.push_back(char((bits >> (8 * b)) & 0xFF));
+        }
+        const uint16_t crc = crc16Ccitt(frame.data() + 1, (unsigned int)frame.size() - 1);
+        frame.push_back(char(crc & 0xFF));
+        frame.push_back(char(crc >> 8));
+        queueReply(frame);
+        return true;
+    }
+
+
+    void HapticAvatar_SimulatedDevice::executeCommand(int cmd, const int32_t* args, int nbArgs, std::vector<int32_t>& reply)
+    {
+        float values[RESULT_SIZEY] = { 0.0f };
+        execute(cmd, args, nbArgs, values);
+        for (int i = 0; i < m_numReturnVals[cmd]; i++)
+            reply.push_back(int32_t(std::lround(values[i] * m_scaleFactor[cmd])));
+    }
+
+
+    void HapticAvatar_SimulatedDevice::queueReply(const std::string& reply)
+    {
+        PendingReply pending;
+        pending.dueNs = clockNs() + int64_t(m_settings.latencyUs) * 1000;
+        if (m_settings.jitterUs > 0)
+            pending.dueNs += int64_t(m_jitterDraw(m_random)) * 1000;
+
+        // the device answers in order, a reply never overtakes the previous one
+        pending.dueNs = std::max(pending.dueNs, m_lastDueNs);
+        m_lastDueNs = pending.dueNs;
+        pending.bytes = reply;
+        m_replies.push_back(pending);
+    }
+
+
+    bool HapticAvatar_SimulatedDevice::sendDueReplies(int64_t nowNs)
+    {
+        while (!m_replies.empty() && m_replies.front().dueNs <= nowNs)
+        {
+            std::string bytes;
+            bytes.swap(m_replies.front().bytes);
+            m_replies.pop_front();
+
+            if (m_settings.byteLoss > 0.0f)
+            {
+                auto lost = std::remove_if(bytes.begin(), bytes.end(), [this](char) { return m_lossDraw(m_random); });
+                m_lostByteCount += (unsigned int)(bytes.end() - lost);
+                bytes.erase(lost, bytes.end());
+            }
+
+            if (!bytes.empty() && !m_transport->write(bytes.data(), (unsigned int)bytes.size()))
+                return false;
+        }
+        return true;
+    }
+
+
+    int HapticAvatar_SimulatedDevice::waitTimeUs(int64_t nowNs, int maxUs) const
+    {
+        if (m_replies.empty())
+            return maxUs;
+
+        const int64_t waitUs = (m_replies.front().dueNs - nowNs) / 1000;
+        return int(std::clamp(waitUs, int64_t(0), int64_t(maxUs)));
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,184 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <SofaHapticAvatar/HapticAvatar_ResultTable.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sofa::HapticAvatar
+{
+
+#define SIMULATED_DEVICE_MAX_ARGS 32
+#define SIMULATED_DEVICE_ATTACH_POLL_MS 10 // period of the attempts to attach to the link until the driver opens it
+#define SIMULATED_DEVICE_MAX_STEP_S 0.1 // longer pauses of the device thread are not integrated
+
+    class HapticAvatar_DriverBase;
+    class HapticAvatar_Transport;
+
+    /// Link of a simulated device and the faults injected on it
+    struct HapticAvatar_SimulatorSettings
+    {
+        std::string transport = "loopback"; // loopback (portName is the channel) or pty (portName is the link created by the driver)
+        std::string portName;
+        int latencyUs = 0; // delay between a command batch and its reply
+        int jitterUs = 0; // random delay added to the latency, uniform in [0, jitterUs]. Replies stay in order.
+        float byteLoss = 0.0f; // probability to lose each byte, in both directions. See also @sa HapticAvatar_SimulatedDevice::unplug
+        unsigned int seed = 0; // seed of the jitter and byte loss draws, for reproducible runs
+        float loopPeriodMs = 0.1f; // loop period of the device firmware, reported by GET_CURRENT_DELTA_T
+    };
+
+    /**
+    * Software Haptic Avatar device. It attaches to the device side of a loopback or pty link opened by a driver and
+    * answers the command batches like the firmware: ASCII lines, or binary frames once the driver negotiated them,
+    * with the num_return_vals and scale_factor tables of the matching driver. Latency, jitter and byte loss can be injected.
+    * Device models implement the commands, see @sa HapticAvatar_SimulatedPort, @sa HapticAvatar_SimulatedIbox and @sa HapticAvatar_SimulatedScope
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_SimulatedDevice
+    {
+    public:
+        /** Default constructor
+        * @param {string} deviceType: identity returned to GET_DEVICE_TYPE in ASCII mode (ex: "HapticDevice").
+        * @param {HapticAvatar_SimulatorSettings} settings: link and fault injection.
+        */
+        HapticAvatar_SimulatedDevice(const std::string& deviceType, const HapticAvatar_SimulatorSettings& settings);
+
+        virtual ~HapticAvatar_SimulatedDevice();
+
+        /** Factory method to create a device model from its type name.
+        * @param {string} type: one of "port", "ibox" or "scope".
+        * @returns {HapticAvatar_SimulatedDevice*} a new, not yet started, device or nullptr if the type is unknown.
+        */
+        static HapticAvatar_SimulatedDevice* create(const std::string& type, const HapticAvatar_SimulatorSettings& settings);
+
+        /// Start the device thread. The device attaches to the link as soon as the driver opened it.
+        void start();
+
+        /// Stop the device thread and detach from the link. Must be called by the destructor of the device models.
+        void stop();
+
+        bool isAttached() const { return m_attached; }
+
+        /** Simulate an unplugged cable: the device detaches from the link and loses its state, then attaches to the next link
+        * opened by the driver once the duration expired. Can be called from any thread.
+        * @param {int} durationMs: time during which the device stays unplugged.
+        */
+        void unplug(int durationMs);
+
+        const std::string& getDeviceType() const { return m_deviceType; }
+
+        /// Statistics of the device side of the link. Can be read from any thread.
+        ///{
+        unsigned int getFrameCount() const { return m_frameCount; } ///< command batches answered
+        unsigned int getBadFrameCount() const { return m_badFrameCount; } ///< batches with a CRC error or an unknown command
+        unsigned int getLostByteCount() const { return m_lostByteCount; } ///< bytes dropped by the loss injection
+        ///}
+
+    protected:
+        /// Copy the protocol tables of the driver of this device, to be called by the constructor of the device models.
+        void setupProtocol(const HapticAvatar_DriverBase& driver);
+
+        /// Number of arguments of a command. The ASCII lines don't carry it, the firmware knows it for each command.
+        virtual int getNumArgs(int cmd) const = 0;
+
+        /** Execute a command on the device model.
+        * @param {int} cmd: command id, below the number of commands of the device.
+        * @param {int32 *} args: arguments as sent by the driver: indices and channels as is, values multiplied by the scale factor, see @sa toFloat
+        * @param {float *} values: num_return_vals(cmd) values to return, before scaling.
+        */
+        virtual void execute(int cmd, const int32_t* args, int nbArgs, float* values) = 0;
+
+        /// Advance the device model of dt seconds. Called before each command batch.
+        virtual void step(double dt) { SOFA_UNUSED(dt); }
+
+        /// Back to the power-on state of the device model. Called by the RESET command and when the device is plugged again after @sa unplug
+        virtual void reset() {}
+
+        int getNumReturnValues(int cmd) const { return m_numReturnVals[cmd]; }
+
+        /// Value of a scaled argument of a command
+        float toFloat(int cmd, int32_t arg) const { return float(arg) / m_scaleFactor[cmd]; }
+
+        HapticAvatar_SimulatorSettings m_settings;
+
+    private:
+        void run();
+        bool attach();
+        void detach();
+
+        /// Parse the received bytes, execute the complete batches and queue their replies
+        void processInput();
+        bool processAsciiLine(const char* line, unsigned int size);
+        bool processBinaryFrame(const char* payload, unsigned int size);
+
+        /// Execute a command and add its values to the reply being built
+        void executeCommand(int cmd, const int32_t* args, int nbArgs, std::vector<int32_t>& reply);
+
+        /// Send the replies whose delay expired
+        bool sendDueReplies(int64_t nowNs);
+        void queueReply(const std::string& reply);
+
+        /// Time to wait for the next due reply, capped by maxUs
+        int waitTimeUs(int64_t nowNs, int maxUs) const;
+
+        int64_t clockNs() const;
+
+        struct PendingReply
+        {
+            int64_t dueNs = 0;
+            std::string bytes;
+        };
+
+        std::string m_deviceType;
+        int m_deviceTypeId = 0;
+        int m_numCommands = 0;
+        int m_numReturnVals[RESULT_SIZEX] = { 0 };
+        float m_scaleFactor[RESULT_SIZEX] = { 1.0f };
+
+        HapticAvatar_Transport* m_transport = nullptr;
+        std::thread m_thread;
+        std::atomic<bool> m_running;
+        std::atomic<bool> m_attached;
+        std::atomic<int64_t> m_unpluggedUntilNs; // see @sa unplug
+
+        std::vector<char> m_input; // received bytes not parsed yet
+        bool m_binaryFraming = false; // a valid binary frame was received, stray bytes are then skipped instead of read as an ASCII line
+        std::deque<PendingReply> m_replies;
+        int64_t m_lastDueNs = 0;
+        int64_t m_lastStepNs = 0;
+
+        std::mt19937 m_random;
+        std::bernoulli_distribution m_lossDraw;
+        std::uniform_int_distribution<int> m_jitterDraw;
+
+        std::atomic<unsigned int> m_frameCount;
+        std::atomic<unsigned int> m_badFrameCount;
+        std::atomic<unsigned int> m_lostByteCount;
+    };
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,189 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_SimulatedIbox.h>
+
+#include <algorithm>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_SimulatedIbox::HapticAvatar_SimulatedIbox(const HapticAvatar_SimulatorSettings& settings)
+        : HapticAvatar_SimulatedDevice("InstrumentBox", settings)
+    {
+        HapticAvatar_DriverIbox driver("", "loopback");
+        setupProtocol(driver);
+        reset();
+    }
+
+
+    HapticAvatar_SimulatedIbox::~HapticAvatar_SimulatedIbox()
+    {
+        // the device thread calls the model, stop it before the model is destroyed
+        stop();
+    }
+
+
+    void HapticAvatar_SimulatedIbox::reset()
+    {
+        for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+        {
+            m_openings[i] = SIMULATED_IBOX_REST_OPENING;
+            m_velocities[i] = 0.0;
+            m_forces[i] = 0.0;
+            m_forceOffsets[i] = 0.0;
+        }
+        m_forceFeedback = true;
+    }
+
+
+    int HapticAvatar_SimulatedIbox::getNumArgs(int cmd) const
+    {
+        switch (cmd)
+        {
+        case CmdIBox::RESET:
+        case CmdIBox::SET_POWER_ON_MANUAL:
+        case CmdIBox::SET_FAN_ON_MANUAL:
+        case CmdIBox::SET_FF_ENABLE:
+        case CmdIBox::SET_ZERO_FORCE:
+        case CmdIBox::SET_CHARGE_ENABLE:
+        case CmdIBox::SET_TO_CALIBRATE:
+        case CmdIBox::SET_MAX_USB_CHARGE_CURRENT:
+            return 1;
+        case CmdIBox::SET_CHAN_FORCE:
+        case CmdIBox::SET_HANDLE_LED:
+        case CmdIBox::SET_FORCE_OFFSET:
+            return 2;
+        case CmdIBox::SET_LOOP_GAIN:
+            return 3;
+        case CmdIBox::SET_ALL_FORCES:
+        case CmdIBox::SET_MANUAL_PWM:
+            return IBOX_NUM_CHANNELS;
+        default:
+            return 0; // the GET commands
+        }
+    }
+
+
+    void HapticAvatar_SimulatedIbox::step(double dt)
+    {
+        const double loopPeriod = std::max(double(m_settings.loopPeriodMs) * 1.0e-3, 1.0e-5);
+        for (double t = 0.0; t < dt; t += loopPeriod)
+        {
+            const double h = std::min(loopPeriod, dt - t);
+            for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+            {
+                double force = -SIMULATED_IBOX_STIFFNESS * (m_openings[i] - SIMULATED_IBOX_REST_OPENING) - SIMULATED_IBOX_DAMPING * m_velocities[i];
+                if (m_forceFeedback)
+                    force += m_forces[i] + m_forceOffsets[i];
+                m_velocities[i] += h * force / SIMULATED_IBOX_MASS;
+                m_openings[i] = std::clamp(m_openings[i] + h * m_velocities[i], 0.0, 1.0);
+            }
+        }
+    }
+
+
+    void HapticAvatar_SimulatedIbox::execute(int cmd, const int32_t* args, int nbArgs, float* values)
+    {
+        SOFA_UNUSED(nbArgs);
+        const bool validChannel = getNumArgs(cmd) > 0 && args[0] >= 0 && args[0] < IBOX_NUM_CHANNELS;
+        switch (cmd)
+        {
+        case CmdIBox::RESET:
+            reset();
+            values[0] = 1.0f;
+            break;
+        case CmdIBox::GET_OPENING_VALUES:
+            for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+                values[i] = float(m_openings[i]);
+            break;
+        case CmdIBox::GET_HANDLE_IDS:
+        case CmdIBox::GET_HANDLE_IDS_REAL:
+            for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+                values[i] = float(i + 1);
+            break;
+        case CmdIBox::SET_ALL_FORCES:
+            for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+                m_forces[i] = toFloat(cmd, args[i]);
+            break;
+        case CmdIBox::SET_CHAN_FORCE:
+            if (validChannel)
+                m_forces[args[0]] = toFloat(cmd, args[1]);
+            break;
+        case CmdIBox::SET_FORCE_OFFSET:
+            if (validChannel)
+                m_forceOffsets[args[0]] = toFloat(cmd, args[1]);
+            break;
+        case CmdIBox::SET_ZERO_FORCE:
+            if (validChannel)
+                m_forces[args[0]] = 0.0;
+            break;
+        case CmdIBox::SET_FF_ENABLE:
+            m_forceFeedback = args[0] != 0;
+            break;
+        case CmdIBox::GET_CALIBRATION_STATUS:
+        case CmdIBox::GET_MOTOR_BOARD_STATUS:
+            for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+                values[i] = 1.0f;
+            break;
+        case CmdIBox::GET_LAST_PWM:
+            for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+                values[i] = float(std::clamp(int((m_forces[i] + m_forceOffsets[i]) * 255.0), -255, 255));
+            break;
+        case CmdIBox::GET_OPTO_FORCES:
+            for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+                values[i] = float(m_forces[i] + m_forceOffsets[i]);
+            break;
+        case CmdIBox::GET_POS_VOLTAGES:
+        case CmdIBox::GET_OPTO_VOLTAGES:
+            for (int i = 0; i < IBOX_NUM_CHANNELS; i++)
+                values[i] = float(m_openings[i] * 3.3);
+            break;
+        case CmdIBox::GET_CURRENT_DELTA_T:
+            values[0] = m_settings.loopPeriodMs;
+            break;
+        case CmdIBox::GET_BATTERY_VOLTAGE:
+            values[0] = 12.0f;
+            break;
+        case CmdIBox::GET_BOARD_TEMP:
+            values[0] = 35.0f;
+            break;
+        case CmdIBox::GET_BUILD_DATE:
+            values[0] = 210101.0f; // yymmdd
+            break;
+        case CmdIBox::GET_SERIAL_NUM:
+            values[0] = 2000001.0f;
+            break;
+        case CmdIBox::GET_PART_TEMPERATURES:
+            for (int i = 0; i < getNumReturnValues(cmd); i++)
+                values[i] = 30.0f;
+            break;
+        case CmdIBox::GET_CONNECTION_STATES:
+            values[0] = float((1 << IBOX_NUM_CHANNELS) - 1); // one bit per connected handle
+            break;
+        default:
+            // commands without effect on the simulated device (leds, fan, charge, gains...) and status values left to 0
+            break;
+        }
+    }
+
+} // namespace sofa::HapticAvatar
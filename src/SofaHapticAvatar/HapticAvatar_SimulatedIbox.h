@@ -0,0 +1,62 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_SimulatedDevice.h>
+#include <SofaHapticAvatar/HapticAvatar_DriverIbox.h>
+
+namespace sofa::HapticAvatar
+{
+
+#define SIMULATED_IBOX_MASS 0.01 // inertia of each handle
+#define SIMULATED_IBOX_STIFFNESS 0.5 // spring of the hand squeezing the handle towards its rest opening
+#define SIMULATED_IBOX_DAMPING 0.05
+#define SIMULATED_IBOX_REST_OPENING 0.5
+
+    /**
+    * Simulated instrument box. Each channel is a handle whose opening is a mass-spring-damper
+    * driven by the channel force and force offset, when force feedback is enabled.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_SimulatedIbox : public HapticAvatar_SimulatedDevice
+    {
+    public:
+        using CmdIBox = HapticAvatar_DriverIbox::CmdIBox;
+
+        HapticAvatar_SimulatedIbox(const HapticAvatar_SimulatorSettings& settings);
+
+        ~HapticAvatar_SimulatedIbox() override;
+
+    protected:
+        int getNumArgs(int cmd) const override;
+        void execute(int cmd, const int32_t* args, int nbArgs, float* values) override;
+        void step(double dt) override;
+
+        void reset() override;
+
+        double m_openings[IBOX_NUM_CHANNELS];
+        double m_velocities[IBOX_NUM_CHANNELS];
+        double m_forces[IBOX_NUM_CHANNELS];
+        double m_forceOffsets[IBOX_NUM_CHANNELS];
+        bool m_forceFeedback = true;
+    };
+
+} // namespace sofa::HapticAvatar
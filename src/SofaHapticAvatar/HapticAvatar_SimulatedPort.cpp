@@ -0,0 +1,390 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_SimulatedPort.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_SimulatedPort::HapticAvatar_SimulatedPort(const HapticAvatar_SimulatorSettings& settings)
+        : HapticAvatar_SimulatedDevice("HapticDevice", settings)
+    {
+        HapticAvatar_DriverPort driver("", "loopback");
+        setupProtocol(driver);
+        reset();
+    }
+
+
+    HapticAvatar_SimulatedPort::~HapticAvatar_SimulatedPort()
+    {
+        // the device thread calls the model, stop it before the model is destroyed
+        stop();
+    }
+
+
+    void HapticAvatar_SimulatedPort::reset()
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            m_joints[i] = 0.0;
+            m_velocities[i] = 0.0;
+            m_motorForces[i] = 0.0;
+            m_collisionJointForces[i] = 0.0;
+            m_deadBand[i] = 0.0f;
+        }
+        m_yawPitchZero[0] = m_yawPitchZero[1] = 0.0;
+        m_forceFeedback = true;
+        m_tip = tipPosition(m_joints);
+        m_tipVelocity = sofa::type::Vec3d();
+        m_collisionForce = sofa::type::Vec3d();
+        m_nbContacts = 0;
+
+        for (Primitive& primitive : m_primitives)
+            primitive = Primitive();
+    }
+
+
+    int HapticAvatar_SimulatedPort::getNumArgs(int cmd) const
+    {
+        switch (cmd)
+        {
+        case CmdPort::RESET:
+        case CmdPort::SET_LED_BLINK_MODE:
+        case CmdPort::SET_TOOL_JAW_OPENING_ANGLE:
+        case CmdPort::SET_POWER_ON_MANUAL:
+        case CmdPort::SET_FAN_ON_MANUAL:
+        case CmdPort::SET_FF_ENABLE:
+        case CmdPort::SET_CHARGE_ENABLE:
+        case CmdPort::SET_MAX_USB_CHARGE_CURRENT:
+            return 1;
+        case CmdPort::SET_YAW_PITCH_ZERO_ANG:
+        case CmdPort::SET_COLLISION_OBJECT_ACTIVE:
+        case CmdPort::SET_COLLISION_OBJECT_Q:
+        case CmdPort::SET_COLLISION_OBJECT_R:
+        case CmdPort::SET_COLLISION_OBJECT_S:
+        case CmdPort::SET_COLLISION_OBJECT_T:
+        case CmdPort::SET_COLLISION_OBJECT_STIFFNESS:
+        case CmdPort::SET_COLLISION_OBJECT_DAMPING:
+        case CmdPort::SET_COLLISION_OBJECT_FRICTION:
+            return 2;
+        case CmdPort::SET_MOTOR_FORCE_AND_TORQUES:
+        case CmdPort::SET_TIP_FORCE_AND_ROT_TORQUE:
+        case CmdPort::SET_COLLISION_OBJECT_P0:
+        case CmdPort::SET_COLLISION_OBJECT_V0:
+        case CmdPort::SET_COLLISION_OBJECT_N:
+        case CmdPort::SET_TOOL_DATA:
+        case CmdPort::SET_MANUAL_PWM:
+        case CmdPort::SET_DEADBAND_PWM_WIDTH:
+            return 4;
+        case CmdPort::SET_COLLISION_OBJECT:
+            return 19;
+        default:
+            return 0; // the GET commands
+        }
+    }
+
+
+    sofa::type::Vec3d HapticAvatar_SimulatedPort::tipPosition(const double* joints) const
+    {
+        const double pitch = joints[Dof::PITCH] - m_yawPitchZero[1];
+        const double yaw = joints[Dof::YAW] - m_yawPitchZero[0];
+        const sofa::type::Vec3d direction(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw));
+        return direction * joints[Dof::Z];
+    }
+
+
+    bool HapticAvatar_SimulatedPort::contactForce(const Primitive& primitive, const sofa::type::Vec3d& tip, const sofa::type::Vec3d& tipVelocity, sofa::type::Vec3d& force) const
+    {
+        sofa::type::Vec3d normal;
+        double depth = 0.0;
+        switch (primitive.type)
+        {
+        case HapticAvatar_DriverPort::CO_PLANE:
+        case HapticAvatar_DriverPort::CO_STICKY_PLANE:
+        {
+            normal = primitive.n;
+            if (normal.norm() == 0.0)
+                return false;
+            normal.normalize();
+            depth = -dot(tip - primitive.p0, normal);
+            break;
+        }
+        case HapticAvatar_DriverPort::CO_SPHERE:
+        {
+            const sofa::type::Vec3d d = tip - primitive.p0;
+            const double dist = d.norm();
+            depth = primitive.r - dist;
+            normal = dist > 0.0 ? d / dist : primitive.n;
+            break;
+        }
+        case HapticAvatar_DriverPort::CO_CYLINDER:
+        {
+            // capsule of radius r around the segment from p0 along v0
+            sofa::type::Vec3d axis = primitive.v0;
+            if (axis.norm() == 0.0)
+                return false;
+            axis.normalize();
+            const double length = primitive.s > 0.0 ? primitive.s : primitive.t;
+            const double along = std::clamp(dot(tip - primitive.p0, axis), 0.0, length);
+            const sofa::type::Vec3d d = tip - (primitive.p0 + axis * along);
+            const double dist = d.norm();
+            depth = primitive.r - dist;
+            normal = dist > 0.0 ? d / dist : primitive.n;
+            break;
+        }
+        case HapticAvatar_DriverPort::CO_SPRING:
+            force = (primitive.p0 - tip) * primitive.stiffness - tipVelocity * primitive.damping;
+            return true;
+        default:
+            return false;
+        }
+
+        if (depth <= 0.0)
+            return false;
+
+        // penalty along the normal, damping of the normal velocity and viscous friction of the tangential one
+        const double normalVelocity = dot(tipVelocity, normal);
+        const sofa::type::Vec3d tangentVelocity = tipVelocity - normal * normalVelocity;
+        force = normal * (primitive.stiffness * depth - primitive.damping * normalVelocity) - tangentVelocity * primitive.friction;
+        return true;
+    }
+
+
+    void HapticAvatar_SimulatedPort::computeCollision()
+    {
+        m_collisionForce = sofa::type::Vec3d();
+        m_nbContacts = 0;
+        for (const Primitive& primitive : m_primitives)
+        {
+            sofa::type::Vec3d force;
+            if (primitive.active && contactForce(primitive, m_tip, m_tipVelocity, force))
+            {
+                m_collisionForce += force;
+                m_nbContacts++;
+            }
+        }
+
+        // joint forces are the transposed jacobian of the tip position times the tip force, by finite differences
+        const double h = 1.0e-6;
+        for (int j = 0; j < 4; j++)
+        {
+            double joints[4] = { m_joints[0], m_joints[1], m_joints[2], m_joints[3] };
+            joints[j] += h;
+            const sofa::type::Vec3d column = (tipPosition(joints) - m_tip) / h;
+            m_collisionJointForces[j] = dot(column, m_collisionForce);
+        }
+    }
+
+
+    void HapticAvatar_SimulatedPort::step(double dt)
+    {
+        // the forces are held during the step, like between two firmware loops
+        computeCollision();
+
+        const double loopPeriod = std::max(double(m_settings.loopPeriodMs) * 1.0e-3, 1.0e-5);
+        const sofa::type::Vec3d previousTip = m_tip;
+        for (double t = 0.0; t < dt; t += loopPeriod)
+        {
+            const double h = std::min(loopPeriod, dt - t);
+            for (int j = 0; j < 4; j++)
+            {
+                double force = m_motorForces[j] - SIMULATED_PORT_STIFFNESS * m_joints[j] - SIMULATED_PORT_DAMPING * m_velocities[j];
+                if (m_forceFeedback)
+                    force += m_collisionJointForces[j];
+                m_velocities[j] += h * force / SIMULATED_PORT_MASS;
+                m_joints[j] += h * m_velocities[j];
+            }
+        }
+
+        m_tip = tipPosition(m_joints);
+        if (dt > 0.0)
+            m_tipVelocity = (m_tip - previousTip) / dt;
+    }
+
+
+    void HapticAvatar_SimulatedPort::execute(int cmd, const int32_t* args, int nbArgs, float* values)
+    {
+        SOFA_UNUSED(nbArgs);
+        switch (cmd)
+        {
+        case CmdPort::RESET:
+            reset();
+            values[0] = 1.0f;
+            break;
+        case CmdPort::GET_ANGLES_AND_LENGTH:
+            for (int j = 0; j < 4; j++)
+                values[j] = float(m_joints[j]);
+            break;
+        case CmdPort::GET_TOOL_ID:
+            values[0] = 1.0f;
+            break;
+        case CmdPort::GET_CURRENT_DELTA_T:
+            values[0] = m_settings.loopPeriodMs;
+            break;
+        case CmdPort::GET_STATUS:
+            values[0] = 0.0f;
+            break;
+        case CmdPort::SET_MOTOR_FORCE_AND_TORQUES:
+        case CmdPort::SET_MANUAL_PWM:
+            for (int j = 0; j < 4; j++)
+                m_motorForces[j] = toFloat(cmd, args[j]);
+            break;
+        case CmdPort::SET_YAW_PITCH_ZERO_ANG:
+            m_yawPitchZero[0] = toFloat(cmd, args[0]);
+            m_yawPitchZero[1] = toFloat(cmd, args[1]);
+            break;
+        case CmdPort::SET_FF_ENABLE:
+            m_forceFeedback = args[0] != 0;
+            break;
+        case CmdPort::SET_DEADBAND_PWM_WIDTH:
+            for (int j = 0; j < 4; j++)
+                m_deadBand[j] = toFloat(cmd, args[j]);
+            values[0] = 1.0f;
+            break;
+        case CmdPort::SET_COLLISION_OBJECT:
+        {
+            if (args[0] < 0 || args[0] >= MAX_NUM_PRIMITIVES)
+                break;
+            Primitive& primitive = m_primitives[args[0]];
+            primitive.type = args[1];
+            primitive.active = args[2] != 0;
+            primitive.p0 = sofa::type::Vec3d(toFloat(cmd, args[3]), toFloat(cmd, args[4]), toFloat(cmd, args[5]));
+            primitive.v0 = sofa::type::Vec3d(toFloat(cmd, args[6]), toFloat(cmd, args[7]), toFloat(cmd, args[8]));
+            primitive.n = sofa::type::Vec3d(toFloat(cmd, args[9]), toFloat(cmd, args[10]), toFloat(cmd, args[11]));
+            primitive.q = toFloat(cmd, args[12]);
+            primitive.r = toFloat(cmd, args[13]);
+            primitive.s = toFloat(cmd, args[14]);
+            primitive.t = toFloat(cmd, args[15]);
+            primitive.stiffness = toFloat(cmd, args[16]);
+            primitive.friction = toFloat(cmd, args[17]);
+            primitive.damping = toFloat(cmd, args[18]);
+            break;
+        }
+        case CmdPort::SET_COLLISION_OBJECT_ACTIVE:
+        case CmdPort::SET_COLLISION_OBJECT_P0:
+        case CmdPort::SET_COLLISION_OBJECT_V0:
+        case CmdPort::SET_COLLISION_OBJECT_N:
+        case CmdPort::SET_COLLISION_OBJECT_Q:
+        case CmdPort::SET_COLLISION_OBJECT_R:
+        case CmdPort::SET_COLLISION_OBJECT_S:
+        case CmdPort::SET_COLLISION_OBJECT_T:
+        case CmdPort::SET_COLLISION_OBJECT_STIFFNESS:
+        case CmdPort::SET_COLLISION_OBJECT_DAMPING:
+        case CmdPort::SET_COLLISION_OBJECT_FRICTION:
+        {
+            if (args[0] < 0 || args[0] >= MAX_NUM_PRIMITIVES)
+                break;
+            Primitive& primitive = m_primitives[args[0]];
+            const double value = toFloat(cmd, args[1]);
+            if (cmd == CmdPort::SET_COLLISION_OBJECT_ACTIVE)
+                primitive.active = args[1] != 0;
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_P0)
+                primitive.p0 = sofa::type::Vec3d(value, toFloat(cmd, args[2]), toFloat(cmd, args[3]));
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_V0)
+                primitive.v0 = sofa::type::Vec3d(value, toFloat(cmd, args[2]), toFloat(cmd, args[3]));
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_N)
+                primitive.n = sofa::type::Vec3d(value, toFloat(cmd, args[2]), toFloat(cmd, args[3]));
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_Q)
+                primitive.q = value;
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_R)
+                primitive.r = value;
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_S)
+                primitive.s = value;
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_T)
+                primitive.t = value;
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_STIFFNESS)
+                primitive.stiffness = value;
+            else if (cmd == CmdPort::SET_COLLISION_OBJECT_DAMPING)
+                primitive.damping = value;
+            else
+                primitive.friction = value;
+            break;
+        }
+        case CmdPort::GET_LAST_COLLISION_FORCE:
+            for (int i = 0; i < 3; i++)
+                values[i] = float(m_collisionForce[i]);
+            break;
+        case CmdPort::GET_LAST_COLLISION_DATA:
+            values[0] = float(m_nbContacts);
+            break;
+        case CmdPort::GET_LAST_PWM:
+            // normalised motor output
+            for (int j = 0; j < 4; j++)
+                values[j] = float(std::clamp(m_motorForces[j] + (m_forceFeedback ? m_collisionJointForces[j] : 0.0), -1.0, 1.0));
+            break;
+        case CmdPort::GET_TOOL_INSERTED:
+        case CmdPort::GET_SERIAL_NUM:
+            values[0] = (cmd == CmdPort::GET_TOOL_INSERTED) ? 1.0f : 1000001.0f;
+            break;
+        case CmdPort::GET_TOOL_TIP_VELOCITY:
+        case CmdPort::GET_TOOL_TIP_POSITION:
+        case CmdPort::GET_TOOL_DIRECTION:
+        {
+            sofa::type::Vec3d vec = (cmd == CmdPort::GET_TOOL_TIP_VELOCITY) ? m_tipVelocity : m_tip;
+            if (cmd == CmdPort::GET_TOOL_DIRECTION)
+            {
+                double joints[4] = { m_joints[0], m_joints[1], 1.0, m_joints[3] };
+                vec = tipPosition(joints);
+            }
+            for (int i = 0; i < 3; i++)
+                values[i] = float(vec[i]);
+            break;
+        }
+        case CmdPort::GET_RAW_ENCODER_VALUES:
+            for (int j = 0; j < 4; j++)
+                values[j] = float(std::lround(m_joints[j] * 10000.0));
+            break;
+        case CmdPort::GET_ENCODER_SCALING_VALUES:
+        case CmdPort::GET_MOTOR_SCALING_VALUES:
+            for (int j = 0; j < 4; j++)
+                values[j] = 1.0f;
+            break;
+        case CmdPort::GET_BOARD_TEMP:
+            values[0] = 35.0f;
+            break;
+        case CmdPort::GET_BATTERY_VOLTAGE:
+            values[0] = 12.0f;
+            break;
+        case CmdPort::GET_CALIBRATION_STATUS:
+            for (int i = 0; i < 3; i++)
+                values[i] = 1.0f;
+            break;
+        case CmdPort::GET_BUILD_DATE:
+            values[0] = 210101.0f; // yymmdd
+            break;
+        case CmdPort::GET_TIP_LENGTH:
+            values[0] = float(m_joints[Dof::Z]);
+            break;
+        case CmdPort::GET_PART_TEMPERATURES:
+            for (int i = 0; i < getNumReturnValues(cmd); i++)
+                values[i] = 30.0f;
+            break;
+        default:
+            // commands without effect on the simulated device (leds, fan, charge...) and status values left to 0
+            break;
+        }
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,89 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_SimulatedDevice.h>
+#include <SofaHapticAvatar/HapticAvatar_DriverPort.h>
+
+namespace sofa::HapticAvatar
+{
+
+#define SIMULATED_PORT_MASS 0.05 // inertia of each joint, kg or kg.m2
+#define SIMULATED_PORT_STIFFNESS 2.0 // spring of the hand holding the tool at its rest pose
+#define SIMULATED_PORT_DAMPING 0.5
+
+    /**
+    * Simulated Port device. The four joints (rot, pitch, z, yaw) are mass-spring-dampers around a rest pose, driven by the
+    * motor forces and, when force feedback is enabled, by the collision primitives which the firmware renders at the tool tip.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_SimulatedPort : public HapticAvatar_SimulatedDevice
+    {
+    public:
+        using CmdPort = HapticAvatar_DriverPort::CmdPort;
+
+        HapticAvatar_SimulatedPort(const HapticAvatar_SimulatorSettings& settings);
+
+        ~HapticAvatar_SimulatedPort() override;
+
+    protected:
+        int getNumArgs(int cmd) const override;
+        void execute(int cmd, const int32_t* args, int nbArgs, float* values) override;
+        void step(double dt) override;
+
+        /// Collision primitive set by the SET_COLLISION_OBJECT commands, see @sa HapticAvatar_DriverPort::addSphere
+        struct Primitive
+        {
+            int type = 0;
+            bool active = false;
+            sofa::type::Vec3d p0, v0, n;
+            double q = 0, r = 0, s = 0, t = 0;
+            double stiffness = 0, friction = 0, damping = 0;
+        };
+
+        /// Tool tip position for the given joint values
+        sofa::type::Vec3d tipPosition(const double* joints) const;
+
+        /// Force of a primitive on the tool tip, returns false if there is no contact
+        bool contactForce(const Primitive& primitive, const sofa::type::Vec3d& tip, const sofa::type::Vec3d& tipVelocity, sofa::type::Vec3d& force) const;
+
+        /// Sum of the collision forces on the tip, converted to joint forces
+        void computeCollision();
+
+        void reset() override;
+
+        double m_joints[4];
+        double m_velocities[4];
+        double m_motorForces[4];
+        double m_collisionJointForces[4];
+        double m_yawPitchZero[2];
+        float m_deadBand[4];
+        bool m_forceFeedback = true;
+
+        sofa::type::Vec3d m_tip;
+        sofa::type::Vec3d m_tipVelocity;
+        sofa::type::Vec3d m_collisionForce;
+        int m_nbContacts = 0;
+
+        Primitive m_primitives[MAX_NUM_PRIMITIVES];
+    };
+
+} // namespace sofa::HapticAvatar
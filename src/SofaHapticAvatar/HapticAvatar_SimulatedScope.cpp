@@ -0,0 +1,87 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_SimulatedScope.h>
+
+#include <cmath>
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_SimulatedScope::HapticAvatar_SimulatedScope(const HapticAvatar_SimulatorSettings& settings)
+        : HapticAvatar_SimulatedDevice("Scope", settings)
+    {
+        HapticAvatar_DriverScope driver("", "loopback");
+        setupProtocol(driver);
+    }
+
+
+    HapticAvatar_SimulatedScope::~HapticAvatar_SimulatedScope()
+    {
+        // the device thread calls the model, stop it before the model is destroyed
+        stop();
+    }
+
+
+    int HapticAvatar_SimulatedScope::getNumArgs(int cmd) const
+    {
+        return (cmd == CmdScope::RESET) ? 1 : 0;
+    }
+
+
+    void HapticAvatar_SimulatedScope::step(double dt)
+    {
+        // one turn in a minute
+        const double twoPi = 6.283185307179586;
+        m_cameraAngle = std::fmod(m_cameraAngle + dt * twoPi / 60.0, twoPi);
+    }
+
+
+    void HapticAvatar_SimulatedScope::execute(int cmd, const int32_t* args, int nbArgs, float* values)
+    {
+        SOFA_UNUSED(args);
+        SOFA_UNUSED(nbArgs);
+        switch (cmd)
+        {
+        case CmdScope::RESET:
+            m_cameraAngle = 0.0;
+            values[0] = 1.0f;
+            break;
+        case CmdScope::GET_CAMERA_ANGLE:
+            values[0] = float(m_cameraAngle);
+            break;
+        case CmdScope::GET_CRC_POLY:
+            values[0] = 0x1021; // polynomial of the binary framing CRC
+            break;
+        case CmdScope::GET_CURRENT_DELTA_T:
+            values[0] = m_settings.loopPeriodMs;
+            break;
+        case CmdScope::GET_SERIAL_NUM:
+            values[0] = 3000001.0f;
+            break;
+        default:
+            // buttons released, zoom level 0
+            break;
+        }
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,48 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_SimulatedDevice.h>
+#include <SofaHapticAvatar/HapticAvatar_DriverScope.h>
+
+namespace sofa::HapticAvatar
+{
+
+    /// Simulated scope: the camera angle turns slowly, the buttons are released and the zoom is at its middle level.
+    class SOFA_HAPTICAVATAR_API HapticAvatar_SimulatedScope : public HapticAvatar_SimulatedDevice
+    {
+    public:
+        using CmdScope = HapticAvatar_DriverScope::CmdScope;
+
+        HapticAvatar_SimulatedScope(const HapticAvatar_SimulatorSettings& settings);
+
+        ~HapticAvatar_SimulatedScope() override;
+
+    protected:
+        int getNumArgs(int cmd) const override;
+        void execute(int cmd, const int32_t* args, int nbArgs, float* values) override;
+        void step(double dt) override;
+
+        double m_cameraAngle = 0.0;
+    };
+
+} // namespace sofa::HapticAvatar
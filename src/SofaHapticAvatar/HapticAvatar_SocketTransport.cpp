@@ -0,0 +1,185 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_SocketTransport.h>
+#include <sofa/helper/logging/Messaging.h>
+
+#ifndef WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_SocketTransport::HapticAvatar_SocketTransport(const std::string& socketPath)
+        : HapticAvatar_Transport(socketPath)
+    {
+
+    }
+
+
+    HapticAvatar_SocketTransport::~HapticAvatar_SocketTransport()
+    {
+        close();
+    }
+
+
+    bool HapticAvatar_SocketTransport::open()
+    {
+#ifdef WIN32
+        msg_error("HapticAvatar_SocketTransport") << "Unix-domain socket transport is not available on Windows.";
+        return false;
+#else
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (m_portName.size() >= sizeof(addr.sun_path))
+        {
+            msg_error("HapticAvatar_SocketTransport") << "Socket path too long: " << m_portName;
+            return false;
+        }
+        strncpy(addr.sun_path, m_portName.c_str(), sizeof(addr.sun_path) - 1);
+
+        m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_fd < 0 || ::connect(m_fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            msg_error("HapticAvatar_SocketTransport") << "Failed to connect to " << m_portName << ": " << strerror(errno);
+            if (m_fd >= 0)
+                ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+
+        // connect blocking, then switch to non-blocking I/O like the other transports
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+        int noSigPipe = 1;
+        setsockopt(m_fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+        m_open = true;
+        return true;
+#endif
+    }
+
+
+    void HapticAvatar_SocketTransport::close()
+    {
+        if (!m_open)
+            return;
+
+        m_open = false;
+#ifndef WIN32
+        ::close(m_fd);
+        m_fd = -1;
+#endif
+    }
+
+
+    int HapticAvatar_SocketTransport::read(char* buffer, unsigned int nbChar)
+    {
+#ifdef WIN32
+        SOFA_UNUSED(buffer);
+        SOFA_UNUSED(nbChar);
+        return -1;
+#else
+        ssize_t n = ::recv(m_fd, buffer, nbChar, MSG_DONTWAIT);
+        if (n > 0)
+            return int(n);
+        // 0 on a stream socket means the server hung up
+        if (n == 0 || (errno != EAGAIN && errno != EINTR))
+            return -1;
+        return 0;
+#endif
+    }
+
+
+    bool HapticAvatar_SocketTransport::write(const char* buffer, unsigned int nbChar)
+    {
+#ifdef WIN32
+        SOFA_UNUSED(buffer);
+        SOFA_UNUSED(nbChar);
+        return false;
+#else
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL; // a closed server must not raise SIGPIPE in the haptic thread
+#else
+        const int flags = 0;
+#endif
+        unsigned int bytesSend = 0;
+        while (bytesSend < nbChar)
+        {
+            ssize_t n = ::send(m_fd, buffer + bytesSend, nbChar - bytesSend, flags);
+            if (n > 0)
+            {
+                bytesSend += (unsigned int)n;
+            }
+            else if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            {
+                waitWritable();
+            }
+            else
+            {
+                msg_error("HapticAvatar_SocketTransport") << "Failed to send " << nbChar << " bytes, " << bytesSend << " sent: " << strerror(errno);
+                return false;
+            }
+        }
+        return true;
+#endif
+    }
+
+
+    void HapticAvatar_SocketTransport::waitWritable()
+    {
+#ifndef WIN32
+        pollfd pfd = { m_fd, POLLOUT, 0 };
+        ::poll(&pfd, 1, 1);
+#endif
+    }
+
+
+    int HapticAvatar_SocketTransport::bytesAvailable()
+    {
+#ifdef WIN32
+        return 0;
+#else
+        return fdBytesAvailable(m_fd);
+#endif
+    }
+
+
+    bool HapticAvatar_SocketTransport::waitReadable(int timeoutUs)
+    {
+#ifdef WIN32
+        SOFA_UNUSED(timeoutUs);
+        return false;
+#else
+        return fdWaitReadable(m_fd, timeoutUs);
+#endif
+    }
+
+} // namespace sofa::HapticAvatar
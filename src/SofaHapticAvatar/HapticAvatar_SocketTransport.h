@@ -0,0 +1,58 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
+
+namespace sofa::HapticAvatar
+{
+
+    /**
+    * Unix-domain stream socket transport (POSIX only). portName is the path of the socket to connect to,
+    * served by a device emulator or a bridge process owning the real device.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_SocketTransport : public HapticAvatar_Transport
+    {
+    public:
+        HapticAvatar_SocketTransport(const std::string& socketPath);
+
+        ~HapticAvatar_SocketTransport() override;
+
+        /// HapticAvatar_Transport api
+        ///{
+        bool open() override;
+        void close() override;
+        int read(char* buffer, unsigned int nbChar) override;
+        bool write(const char* buffer, unsigned int nbChar) override;
+        int bytesAvailable() override;
+        bool waitReadable(int timeoutUs) override;
+        ///}
+
+    private:
+        /// Wait until the socket send buffer can take more bytes
+        void waitWritable();
+
+        /// Socket file descriptor
+        int m_fd = -1;
+    };
+
+} // namespace sofa::HapticAvatar
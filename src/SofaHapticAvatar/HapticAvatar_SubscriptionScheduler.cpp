@@ -0,0 +1,92 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_SubscriptionScheduler.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sofa::HapticAvatar
+{
+
+#define SCHEDULER_MAX_CREDIT 2.0f // a command delayed by the budget is sent at most twice in a row to catch up
+
+    void HapticAvatar_SubscriptionScheduler::setTickRate(float tickRateHz)
+    {
+        if (tickRateHz > 0.0f)
+            m_tickRate = tickRateHz;
+    }
+
+
+    void HapticAvatar_SubscriptionScheduler::subscribe(int cmd, float rateHz, unsigned int cost)
+    {
+        if (cmd < 0 || cmd >= SCHEDULER_MAX_CMDS)
+            return;
+
+        m_rate[cmd] = rateHz > 0.0f ? rateHz : 0.0f;
+        m_cost[cmd] = cost;
+        // start each command at a different phase (golden ratio sequence) so that commands with the same rate are not due at the same tick
+        float phase = float(cmd) * 0.618034f;
+        m_credit[cmd] = phase - std::floor(phase);
+    }
+
+
+    int HapticAvatar_SubscriptionScheduler::schedule(int* cmds, int maxCmds)
+    {
+        int nbCmds = 0;
+        unsigned int lowRateBytes = 0;
+        int nbLowRate = 0;
+
+        // commands at the tick rate go in every frame
+        for (int k = 0; k < SCHEDULER_MAX_CMDS && nbCmds < maxCmds; k++)
+        {
+            if (m_rate[k] >= m_tickRate)
+                cmds[nbCmds++] = k;
+            else if (m_rate[k] > 0.0f)
+                m_credit[k] = std::min(m_credit[k] + m_rate[k] / m_tickRate, SCHEDULER_MAX_CREDIT);
+        }
+
+        // then the due low rate commands, most overdue first, while they fit in the budget
+        while (nbCmds < maxCmds)
+        {
+            int best = -1;
+            for (int k = 0; k < SCHEDULER_MAX_CMDS; k++)
+            {
+                if (m_rate[k] > 0.0f && m_rate[k] < m_tickRate && m_credit[k] >= 1.0f && (best == -1 || m_credit[k] > m_credit[best]))
+                    best = k;
+            }
+
+            if (best == -1)
+                break;
+
+            if (nbLowRate > 0 && lowRateBytes + m_cost[best] > m_byteBudget)
+                break;
+
+            cmds[nbCmds++] = best;
+            lowRateBytes += m_cost[best];
+            nbLowRate++;
+            m_credit[best] -= 1.0f;
+        }
+
+        return nbCmds;
+    }
+
+} // namespace sofa::HapticAvatar
@@ -0,0 +1,78 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+
+namespace sofa::HapticAvatar
+{
+
+#define SCHEDULER_MAX_CMDS 64
+#define DEFAULT_TICK_RATE_HZ 1000.0f // rate of the haptic loop calling HapticAvatar_DriverBase::update
+#define SUBSCRIPTION_EVERY_TICK 1.0e9f // rate to subscribe to a command in every frame, whatever the tick rate
+
+    /**
+    * Chooses which subscribed GET commands go in each frame sent by @sa HapticAvatar_DriverBase::update.
+    * Commands subscribed at the tick rate or above are sent at every tick. The others accumulate credit (rate / tick rate) at each tick
+    * and are due once their credit reaches 1. Due commands are sent most overdue first, within a per-tick byte budget, so the
+    * low rate commands are spread over the ticks instead of lining up in the same frame and every frame has about the same size.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_SubscriptionScheduler
+    {
+    public:
+        /// Set the rate at which @sa schedule is called, in Hz.
+        void setTickRate(float tickRateHz);
+        float getTickRate() const { return m_tickRate; }
+
+        /** Set the max number of bytes per tick for the commands below the tick rate. The commands sent at every tick are always sent.
+        * At least one due command is sent per tick even if it exceeds the budget, so that none is starved.
+        * @param {uint} budget: in bytes, 0 to send a single due command per tick.
+        */
+        void setByteBudget(unsigned int budget) { m_byteBudget = budget; }
+        unsigned int getByteBudget() const { return m_byteBudget; }
+
+        /** Subscribe to a command.
+        * @param {int} cmd: command id, below SCHEDULER_MAX_CMDS.
+        * @param {float} rateHz: target rate, 0 to unsubscribe. Rates at or above the tick rate are sent at every tick.
+        * @param {uint} cost: number of bytes this command adds to a request and its reply.
+        */
+        void subscribe(int cmd, float rateHz, unsigned int cost);
+
+        bool isSubscribed(int cmd) const { return cmd >= 0 && cmd < SCHEDULER_MAX_CMDS && m_rate[cmd] > 0.0f; }
+        float getRate(int cmd) const { return m_rate[cmd]; }
+
+        /** Choose the commands of the next frame. Call once per tick.
+        * @param {int *} cmds: array receiving the command ids.
+        * @param {int} maxCmds: size of cmds.
+        * @returns {int} number of commands written to cmds.
+        */
+        int schedule(int* cmds, int maxCmds);
+
+    private:
+        float m_tickRate = DEFAULT_TICK_RATE_HZ;
+        unsigned int m_byteBudget = 0;
+        float m_rate[SCHEDULER_MAX_CMDS] = { 0.0f };
+        float m_credit[SCHEDULER_MAX_CMDS] = { 0.0f };
+        unsigned int m_cost[SCHEDULER_MAX_CMDS] = { 0 };
+    };
+
+} // namespace sofa::HapticAvatar
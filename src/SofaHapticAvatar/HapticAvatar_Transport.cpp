@@ -0,0 +1,151 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+#include <SofaHapticAvatar/HapticAvatar_Transport.h>
+#include <SofaHapticAvatar/HapticAvatar_SerialTransport.h>
+#include <SofaHapticAvatar/HapticAvatar_PtyTransport.h>
+#include <SofaHapticAvatar/HapticAvatar_LoopbackTransport.h>
+#include <SofaHapticAvatar/HapticAvatar_SocketTransport.h>
+#include <SofaHapticAvatar/HapticAvatar_ReplayTransport.h>
+#include <sofa/helper/logging/Messaging.h>
+
+#ifndef WIN32
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace sofa::HapticAvatar
+{
+
+    HapticAvatar_Transport::HapticAvatar_Transport(const std::string& portName)
+        : m_portName(portName)
+    {
+
+    }
+
+
+    HapticAvatar_Transport::~HapticAvatar_Transport()
+    {
+
+    }
+
+
+    HapticAvatar_Transport* HapticAvatar_Transport::create(const std::string& type, const std::string& portName)
+    {
+        if (type == "serial")
+            return new HapticAvatar_SerialTransport(portName);
+        else if (type == "pty")
+            return new HapticAvatar_PtyTransport(portName);
+        else if (type == "loopback")
+            return new HapticAvatar_LoopbackTransport(portName);
+        else if (type == "unix")
+            return new HapticAvatar_SocketTransport(portName);
+        else if (type == "replay")
+            return new HapticAvatar_ReplayTransport(portName, true);
+        else if (type == "replay-max")
+            return new HapticAvatar_ReplayTransport(portName, false);
+
+        msg_error("HapticAvatar_Transport") << "Unknown transport type: '" << type << "'. Valid types are: serial, pty, loopback, unix, replay, replay-max.";
+        return nullptr;
+    }
+
+
+    int HapticAvatar_Transport::readWait(char* buffer, unsigned int nbChar, int timeoutUs)
+    {
+        if (!waitReadable(timeoutUs))
+            return 0;
+
+        // readable but empty: end of file of a hung up link
+        int bytesRead = read(buffer, nbChar);
+        if (bytesRead == 0 && nbChar > 0)
+            return -1;
+
+        return bytesRead;
+    }
+
+
+#ifndef WIN32
+    int HapticAvatar_Transport::fdRead(int fd, char* buffer, unsigned int nbChar)
+    {
+        ssize_t bytesRead = ::read(fd, buffer, nbChar);
+        if (bytesRead > 0)
+            return int(bytesRead);
+
+        if (bytesRead < 0 && errno != EAGAIN && errno != EINTR)
+            return -1;
+
+        return 0;
+    }
+
+
+    bool HapticAvatar_Transport::fdWrite(int fd, const char* buffer, unsigned int nbChar)
+    {
+        unsigned int bytesSend = 0;
+        while (bytesSend < nbChar)
+        {
+            ssize_t n = ::write(fd, buffer + bytesSend, nbChar - bytesSend);
+            if (n > 0)
+            {
+                bytesSend += (unsigned int)n;
+            }
+            else if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            {
+                // output queue full, wait until the link can take more bytes
+                pollfd pfd = { fd, POLLOUT, 0 };
+                ::poll(&pfd, 1, 1);
+            }
+            else
+            {
+                msg_error("HapticAvatar_Transport") << "Failed to send " << nbChar << " bytes, " << bytesSend << " sent: " << strerror(errno);
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    int HapticAvatar_Transport::fdBytesAvailable(int fd)
+    {
+        int available = 0;
+        if (ioctl(fd, FIONREAD, &available) != 0)
+            return 0;
+        return available;
+    }
+
+
+    bool HapticAvatar_Transport::fdWaitReadable(int fd, int timeoutUs)
+    {
+        pollfd pfd = { fd, POLLIN, 0 };
+#ifdef __linux__
+        const timespec wait = { timeoutUs / 1000000, (timeoutUs % 1000000) * 1000 };
+        int res = ::ppoll(&pfd, 1, &wait, nullptr);
+#else
+        int res = ::poll(&pfd, 1, (timeoutUs + 999) / 1000);
+#endif
+        return res > 0 && (pfd.revents & (POLLIN | POLLHUP | POLLERR));
+    }
+#endif
+
+} // namespace sofa::HapticAvatar
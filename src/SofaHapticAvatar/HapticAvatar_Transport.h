@@ -0,0 +1,135 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+#pragma once
+
+#include <SofaHapticAvatar/config.h>
+#include <string>
+
+namespace sofa::HapticAvatar
+{
+
+    /// Parameters of a link. The serial ones are ignored by the transports which don't have a baud rate (pty, loopback, unix).
+    struct HapticAvatar_LinkSettings
+    {
+        int baudRate = 9600;
+        std::string flowControl = "none"; // none, hardware (RTS/CTS) or software (XON/XOFF)
+        bool dtrReset = true; // raise DTR when opening the port to reset the board
+        bool binaryProtocol = false; // negotiate the binary framing with the device at connection, used by @sa HapticAvatar_DriverBase
+        std::string captureFile; // record the traffic of the link in this file if not empty, see @sa HapticAvatar_CaptureTransport
+        bool ioThread = false; // drain the link continuously in a dedicated thread, the haptic thread only parses the received replies. Used by @sa HapticAvatar_DriverBase
+        bool autoReconnect = true; // reopen the link in a background thread when the device is unplugged or stops answering, see @sa HapticAvatar_DriverBase::LinkState
+    };
+
+    /**
+    * Byte link between a HapticAvatar driver and a device. The protocol code in @sa HapticAvatar_DriverBase
+    * only talks to this interface, so the same command path can run over a serial port, a pseudo-terminal,
+    * an in-memory loopback, a Unix-domain socket or the playback of a captured session.
+    */
+    class SOFA_HAPTICAVATAR_API HapticAvatar_Transport
+    {
+    public:
+        HapticAvatar_Transport(const std::string& portName);
+
+        virtual ~HapticAvatar_Transport();
+
+        /** Factory method to create a transport from its type name.
+        * @param {string} type: one of "serial", "pty", "loopback", "unix", "replay" (capture played at its original pace) or "replay-max" (as fast as possible).
+        * @param {string} portName: serial port, loopback channel name, socket path or capture file depending on the type.
+        * @returns {HapticAvatar_Transport*} a new, not yet opened, transport or nullptr if the type is unknown.
+        */
+        static HapticAvatar_Transport* create(const std::string& type, const std::string& portName);
+
+        /// Open the link. @returns true if the link is ready to exchange data.
+        virtual bool open() = 0;
+
+        /// Close the link. Safe to call on a closed link.
+        virtual void close() = 0;
+
+        bool isOpen() const { return m_open; }
+
+        const std::string& getPortName() const { return m_portName; }
+
+        /// Set the serial parameters used by @sa open.
+        void setLinkSettings(const HapticAvatar_LinkSettings& settings) { m_linkSettings = settings; }
+        const HapticAvatar_LinkSettings& getLinkSettings() const { return m_linkSettings; }
+
+        /** Change the baud rate of the opened link. Pending bytes are discarded.
+        * @returns {bool} false if the link has no baud rate or the rate is not supported.
+        */
+        virtual bool setBaudRate(int baudRate) { SOFA_UNUSED(baudRate); return false; }
+
+        /** Read bytes already received, never blocks.
+        * @param {char *} buffer: array to store the bytes.
+        * @param {uint} nbChar: max number of bytes to read.
+        * @returns {int} number of bytes read, 0 if nothing was available, -1 if the link is broken.
+        */
+        virtual int read(char* buffer, unsigned int nbChar) = 0;
+
+        /** Send bytes to the device. Blocks until all bytes are queued in the link.
+        * @returns {bool} false if the link is broken.
+        */
+        virtual bool write(const char* buffer, unsigned int nbChar) = 0;
+
+        /// Number of received bytes waiting to be read.
+        virtual int bytesAvailable() = 0;
+
+        /** Wait until bytes are available or the timeout expires.
+        * @param {int} timeoutUs: max time to wait in microseconds, 0 to only check.
+        * @returns {bool} true if bytes can be read.
+        */
+        virtual bool waitReadable(int timeoutUs) = 0;
+
+        /** Block until bytes are received or the timeout expires, then read them.
+        * Default implementation is @sa waitReadable followed by @sa read, transports with a native blocking read can override it.
+        * A link reported readable without any byte to read was hung up by the other side (unplugged cable, closed socket): it is reported as broken.
+        * @param {char *} buffer: array to store the bytes.
+        * @param {uint} nbChar: max number of bytes to read.
+        * @param {int} timeoutUs: max time to wait in microseconds.
+        * @returns {int} number of bytes read, 0 on timeout, -1 if the link is broken.
+        */
+        virtual int readWait(char* buffer, unsigned int nbChar, int timeoutUs);
+
+        /// Discard all bytes pending in both directions.
+        virtual void flush() {}
+
+    protected:
+#ifndef WIN32
+        /// Helpers shared by the file descriptor based transports (tty, pty, socket)
+        ///{
+        static int fdRead(int fd, char* buffer, unsigned int nbChar);
+        static bool fdWrite(int fd, const char* buffer, unsigned int nbChar);
+        static int fdBytesAvailable(int fd);
+        static bool fdWaitReadable(int fd, int timeoutUs);
+        ///}
+#endif
+
+        // String name of the port (ex: COM3, /dev/ttyACM0, channel name or socket path)
+        std::string m_portName;
+
+        // Serial parameters
+        HapticAvatar_LinkSettings m_linkSettings;
+
+        //Connection status
+        bool m_open = false;
+    };
+
+} // namespace sofa::HapticAvatar
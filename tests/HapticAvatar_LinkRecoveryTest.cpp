@@ -0,0 +1,143 @@
+/******************************************************************************
+*       SOFA, Simulation Open-Framework Architecture, development version     *
+*                (c) 2006-2019 INRIA, USTL, UJF, CNRS, MGH                    *
+*                                                                             *
+* This program is free software; you can redistribute it and/or modify it     *
+* under the terms of the GNU Lesser General Public License as published by    *
+* the Free Software Foundation; either version 2.1 of the License, or (at     *
+* your option) any later version.                                             *
+*                                                                             *
+* This program is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License *
+* for more details.                                                           *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program. If not, see <http://www.gnu.org/licenses/>.        *
+*******************************************************************************
+* Authors: The SOFA Team and external contributors (see Authors.txt)          *
+*                                                                             *
+* Contact information: contact@sofa-framework.org                             *
+******************************************************************************/
+
+/**
+* Regression tests of the recovery of the command/reply exchange on a lossy link. A driver talks to a simulated
+* Port over the loopback transport while the simulator drops bytes in both directions: a lost byte corrupts one
+* request or one reply, the device answers or not, and the driver must be back in step with the device at the next batch.
+* Checks that the haptic values never stay stale for more than a few ticks, that a lost byte costs at most a few timeouts,
+* and that the link is never reopened.
+*
+* Each case runs with the ASCII and binary framings. Returns 0 if all the cases pass.
+* Usage: SofaHapticAvatar_LinkRecoveryTest [nbTicks]
+*/
+
+#include <SofaHapticAvatar/HapticAvatar_DriverPort.h>
+#include <SofaHapticAvatar/HapticAvatar_LoopTimer.h>
+#include <SofaHapticAvatar/HapticAvatar_SimulatedDevice.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace sofa::HapticAvatar;
+
+#define TEST_DEFAULT_TICKS 4000
+#define TEST_TICK_RATE 1000.0f // Hz, rate of the simulated haptic loop
+#define TEST_MAX_STALE_TICKS_ASCII 5 // max number of ticks in a row without a complete reply
+#define TEST_MAX_STALE_TICKS_BINARY 40 // a lost byte in the length of a request makes the device read up to OUTGOING_DATA_LEN bytes before it resyncs
+#define TEST_TIMEOUTS_PER_LOST_BYTE 3 // a lost byte may cost the reply of its batch and of the one being drained
+
+namespace
+{
+    struct LossCase
+    {
+        const char* name;
+        bool binary;
+        bool ioThread;
+        float byteLoss;
+        unsigned int seed;
+        int maxStaleTicks;
+    };
+
+    bool runLossCase(const LossCase& test, int nbTicks)
+    {
+        HapticAvatar_SimulatorSettings simSettings;
+        simSettings.portName = std::string("linkRecoveryTest_") + test.name;
+        simSettings.byteLoss = test.byteLoss;
+        simSettings.seed = test.seed;
+        HapticAvatar_SimulatedDevice* device = HapticAvatar_SimulatedDevice::create("port", simSettings);
+        device->start();
+
+        HapticAvatar_LinkSettings linkSettings;
+        linkSettings.binaryProtocol = test.binary;
+        linkSettings.ioThread = test.ioThread;
+        HapticAvatar_DriverPort* driver = new HapticAvatar_DriverPort(simSettings.portName, "loopback", linkSettings);
+
+        bool success = false;
+        if (!driver->connect())
+        {
+            printf("[%s] FAILED: no connection to the simulated device\n", test.name);
+        }
+        else
+        {
+            driver->setTickRate(TEST_TICK_RATE);
+            const unsigned int timeoutsAtStart = driver->getReceiveTimeoutCounter();
+
+            HapticAvatar_LoopTimer loopTimer(int64_t(1.0e9f / TEST_TICK_RATE));
+            loopTimer.start();
+
+            // a new reply is counted in the round trip histogram
+            uint64_t nbReplies = driver->getBatchLatency().getCount();
+            int staleTicks = 0;
+            int maxStaleTicks = 0;
+            for (int tick = 0; tick < nbTicks; tick++)
+            {
+                driver->setMotorForceAndTorques(0.0f, 0.0f, 0.0f, 0.0f);
+                driver->update();
+
+                const uint64_t count = driver->getBatchLatency().getCount();
+                staleTicks = (count == nbReplies) ? staleTicks + 1 : 0;
+                nbReplies = count;
+                if (staleTicks > maxStaleTicks)
+                    maxStaleTicks = staleTicks;
+
+                loopTimer.wait();
+            }
+
+            const unsigned int timeouts = driver->getReceiveTimeoutCounter() - timeoutsAtStart;
+            const unsigned int lostBytes = device->getLostByteCount();
+            const unsigned int reconnects = driver->getReconnectCounter();
+            success = reconnects == 0 && maxStaleTicks <= test.maxStaleTicks && timeouts <= TEST_TIMEOUTS_PER_LOST_BYTE * lostBytes;
+
+            printf("[%s] %s: %d ticks, %u bytes lost, %u frames answered, %u timeouts, %u reconnects, max %d ticks without reply\n",
+                test.name, success ? "OK" : "FAILED", nbTicks, lostBytes, device->getFrameCount(), timeouts, reconnects, maxStaleTicks);
+        }
+
+        delete driver;
+        device->stop();
+        delete device;
+        return success;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    const int nbTicks = (argc > 1) ? std::max(atoi(argv[1]), 1) : TEST_DEFAULT_TICKS;
+
+    const LossCase cases[] = {
+        { "ascii", false, false, 0.001f, 7, TEST_MAX_STALE_TICKS_ASCII },
+        { "binary", true, false, 0.001f, 7, TEST_MAX_STALE_TICKS_BINARY },
+        { "ascii_io", false, true, 0.001f, 7, TEST_MAX_STALE_TICKS_ASCII },
+        { "binary_io", true, true, 0.001f, 7, TEST_MAX_STALE_TICKS_BINARY },
+        { "binary_high_loss", true, false, 0.01f, 11, TEST_MAX_STALE_TICKS_BINARY },
+    };
+
+    int nbFailed = 0;
+    for (const LossCase& test : cases)
+        nbFailed += runLossCase(test, nbTicks) ? 0 : 1;
+
+    printf("%s\n", nbFailed == 0 ? "All link recovery tests passed" : "Link recovery tests FAILED");
+    return nbFailed == 0 ? 0 : 1;
+}